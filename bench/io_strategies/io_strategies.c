@@ -0,0 +1,143 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#include "log4embedded.h"
+
+/*  Compare the LOG_IO_STRATEGY options of the asynchronous mode during a log storm: lines per second, and system calls
+    issued to write them per line.
+
+    System calls are counted by wrapping write(), writev() and syscall() (which drives io_uring) right here: the library
+    calls these wrappers instead of the ones of the C library.
+
+    Usage: log4embedded_io_bench [lines] [threads] [log file]
+*/
+
+#define DEFAULT_LINES       1000000
+#define DEFAULT_THREADS     1
+#define DEFAULT_LOG_FILE    "/tmp/log4embedded_io_bench.log"
+#define QUEUE_CAPACITY      65536
+
+static unsigned long write_calls = 0;
+static unsigned long uring_calls = 0;
+static unsigned long lines_per_thread = 0;
+
+ssize_t write(int fd, const void* buffer, size_t count)
+{
+    static ssize_t (*real_write)(int, const void*, size_t) = NULL;
+
+    if (!real_write)
+        *(void**)&real_write = dlsym(RTLD_NEXT, "write");
+
+    __atomic_add_fetch(&write_calls, 1, __ATOMIC_RELAXED);
+    return real_write(fd, buffer, count);
+}
+
+ssize_t writev(int fd, const struct iovec* parts, int count)
+{
+    static ssize_t (*real_writev)(int, const struct iovec*, int) = NULL;
+
+    if (!real_writev)
+        *(void**)&real_writev = dlsym(RTLD_NEXT, "writev");
+
+    __atomic_add_fetch(&write_calls, 1, __ATOMIC_RELAXED);
+    return real_writev(fd, parts, count);
+}
+
+long syscall(long number, ...)
+{
+    static long (*real_syscall)(long, ...) = NULL;
+    long args[6];
+    va_list list;
+
+    if (!real_syscall)
+        *(void**)&real_syscall = dlsym(RTLD_NEXT, "syscall");
+
+    va_start(list, number);
+    for (int i = 0; i < 6; ++i)
+        args[i] = va_arg(list, long);
+    va_end(list);
+
+#ifdef __NR_io_uring_enter
+    if (number == __NR_io_uring_enter)
+        __atomic_add_fetch(&uring_calls, 1, __ATOMIC_RELAXED);
+#endif
+    return real_syscall(number, args[0], args[1], args[2], args[3], args[4], args[5]);
+}
+
+static double elapsed_seconds(const struct timespec* start, const struct timespec* end)
+{
+    return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void* log_storm(void* arg)
+{
+    unsigned long thread = (unsigned long)(uintptr_t)arg;
+
+    for (unsigned long i = 0; i < lines_per_thread; ++i)
+        log_print_info("Thread [%lu] line [%lu]: sensor reading %d, status %s\n", thread, i, (int)(i % 100), "ok");
+
+    return NULL;
+}
+
+int main(int argc, char* argv[]) {
+
+    static const char* names[] = {"write", "writev", "io_uring"};
+    unsigned long lines = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_LINES;
+    unsigned long threads = argc > 2 ? strtoul(argv[2], NULL, 10) : DEFAULT_THREADS;
+    const char* log_file = argc > 3 ? argv[3] : DEFAULT_LOG_FILE;
+    pthread_t workers[64];
+
+    if (threads == 0 || threads > sizeof(workers) / sizeof(workers[0]) || lines < threads)
+    {
+        fprintf(stderr, "Usage: %s [lines] [threads, up to 64] [log file]\n", argv[0]);
+        return 1;
+    }
+    lines_per_thread = lines / threads;
+    lines = lines_per_thread * threads;
+
+    printf("%-10s %-10s %14s %14s %12s\n", "requested", "in use", "lines/sec", "syscalls", "syscalls/line");
+
+    for (int strategy = LOG_IO_WRITE; strategy <= LOG_IO_URING; ++strategy)
+    {
+        struct timespec start, end;
+        unsigned long syscalls;
+
+        unlink(log_file);
+        log_set_file(log_file, strlen(log_file) + 1);
+        if (log_async_start(QUEUE_CAPACITY, LOG_OVERFLOW_BLOCK) != 0)
+            return 1;
+        log_set_io_strategy((LOG_IO_STRATEGY)strategy);
+
+        __atomic_store_n(&write_calls, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&uring_calls, 0, __ATOMIC_RELAXED);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        for (unsigned long i = 0; i < threads; ++i)
+            pthread_create(&workers[i], NULL, log_storm, (void*)(uintptr_t)i);
+        for (unsigned long i = 0; i < threads; ++i)
+            pthread_join(workers[i], NULL);
+
+        // every log message has reached the log file once log_flush returns
+        log_flush();
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        syscalls = __atomic_load_n(&write_calls, __ATOMIC_RELAXED) + __atomic_load_n(&uring_calls, __ATOMIC_RELAXED);
+
+        printf("%-10s %-10s %14.0f %14lu %12.4f\n", names[strategy], names[log_get_io_strategy()],
+               lines / elapsed_seconds(&start, &end), syscalls, (double)syscalls / lines);
+
+        log_set_io_strategy(LOG_IO_WRITE);
+        log_close();
+    }
+
+    unlink(log_file);
+    return 0;
+}
@@ -0,0 +1,370 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/utsname.h>
+
+// measure the filtered print calls with the inline check too, see 'log_print_debug_call' for the library call
+#define LOG4EMBEDDED_INLINE_FILTER
+
+#include "log4embedded.h"
+
+/*  Benchmark suite of log4embedded. For every sink, it measures:
+        - per-call latency percentiles (p50, p99, p99.9 and max) of a single thread
+        - sustained throughput, in lines per second, from 1 up to N threads
+    and the cost of a print call filtered out by the log level, for log_print_* with and without its inline level check,
+    and for the LOG_* macros.
+
+    Results are printed as CSV (default) or JSON, one record per measure, along with the machine they were taken on
+    and the library they were linked against (shared, static or static+lto: log4embedded_bench_static), so that
+    they can be tracked across releases and compared between the builds of the build_linux-*.sh scripts.
+    The stdout sink writes to /dev/null; results go to the original stdout.
+
+    Usage: log4embedded_bench [-f csv|json] [-t max threads] [-n calls] [-d directory for log files]
+*/
+
+// Define the variant of the library the benchmark is linked against, as set by bench/CMakeLists.txt
+#ifndef LOG4EMBEDDED_BENCH_LIBRARY
+#define LOG4EMBEDDED_BENCH_LIBRARY  "shared"
+#endif
+
+#define DEFAULT_CALLS           200000
+#define DEFAULT_MAX_THREADS     8
+#define FILTERED_CALLS          10000000
+#define MAX_THREADS             64
+#define QUEUE_CAPACITY          65536
+#define MMAP_SEGMENT_SIZE       (64 * 1024 * 1024)
+
+// one sink to benchmark: how to select it, and how to release it
+typedef struct {
+    const char* name;
+    int (*open)(const char* directory);
+} bench_sink_t;
+
+// settings of the run
+typedef struct {
+    bool json;
+    unsigned long max_threads;
+    unsigned long calls;
+    const char* directory;
+    FILE* out;                      // the original stdout
+    struct utsname machine;
+    bool first_record;
+} bench_t;
+
+static bench_t bench = {.json = false,
+                        .max_threads = DEFAULT_MAX_THREADS,
+                        .calls = DEFAULT_CALLS,
+                        .directory = NULL,
+                        .out = NULL,
+                        .first_record = true};
+
+// shared by the threads of a throughput run
+static unsigned long lines_per_thread = 0;
+static pthread_barrier_t start_barrier;
+
+
+static uint64_t now_ns()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+static int compare_u64(const void* a, const void* b)
+{
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static void record(const char* benchmark, const char* sink, unsigned long threads, const char* metric, double value, const char* unit)
+{
+    if (bench.json)
+    {
+        fprintf(bench.out, "%s\n  {\"machine\": \"%s\", \"library\": \"%s\", \"benchmark\": \"%s\", \"sink\": \"%s\", "
+                "\"threads\": %lu, \"metric\": \"%s\", \"value\": %.1f, \"unit\": \"%s\"}",
+                bench.first_record ? "[" : ",", bench.machine.machine, LOG4EMBEDDED_BENCH_LIBRARY, benchmark, sink, threads,
+                metric, value, unit);
+    }
+    else
+    {
+        if (bench.first_record)
+            fprintf(bench.out, "machine,library,benchmark,sink,threads,metric,value,unit\n");
+        fprintf(bench.out, "%s,%s,%s,%s,%lu,%s,%.1f,%s\n", bench.machine.machine, LOG4EMBEDDED_BENCH_LIBRARY, benchmark, sink,
+                threads, metric, value, unit);
+    }
+
+    bench.first_record = false;
+    fflush(bench.out);
+}
+
+static void log_file_path(char* path, size_t size, const char* directory, const char* name)
+{
+    snprintf(path, size, "%s/%s", directory, name);
+}
+
+static int open_stdout(const char* directory)
+{
+    (void)directory;
+    return 0;
+}
+
+static int open_file(const char* directory)
+{
+    char path[256];
+
+    log_file_path(path, sizeof(path), directory, "bench.txt");
+    log_set_file(path, strlen(path) + 1);
+    return 0;
+}
+
+static int open_async_file(const char* directory)
+{
+    open_file(directory);
+    return log_async_start(QUEUE_CAPACITY, LOG_OVERFLOW_BLOCK);
+}
+
+static int open_binary(const char* directory)
+{
+    char path[256];
+
+    log_file_path(path, sizeof(path), directory, "bench.bin");
+    return log_set_binary_file(path, strlen(path) + 1);
+}
+
+static int open_mmap(const char* directory)
+{
+    char path[256];
+
+    log_file_path(path, sizeof(path), directory, "bench.mmap");
+    return log_set_mmap_file(path, strlen(path) + 1, MMAP_SEGMENT_SIZE, 0);
+}
+
+static const bench_sink_t sinks[] = {{.name = "stdout", .open = open_stdout},
+                                     {.name = "file", .open = open_file},
+                                     {.name = "async_file", .open = open_async_file},
+                                     {.name = "binary", .open = open_binary},
+                                     {.name = "mmap", .open = open_mmap}};
+
+/**
+ * @brief Remove the log files of the last run
+ *
+ */
+static void remove_log_files()
+{
+    DIR* dir = opendir(bench.directory);
+    struct dirent* entry;
+    char path[512];
+
+    if (!dir)
+        return;
+
+    while ((entry = readdir(dir)))
+    {
+        if (strncmp(entry->d_name, "bench", 5) == 0)
+        {
+            snprintf(path, sizeof(path), "%s/%s", bench.directory, entry->d_name);
+            unlink(path);
+        }
+    }
+    closedir(dir);
+}
+
+/**
+ * @brief Cost of print calls filtered out by the log level
+ *
+ */
+static void bench_filtered()
+{
+    uint64_t start;
+
+    log_set_level(LOG_MSG_WARN);
+
+    start = now_ns();
+    for (unsigned long i = 0; i < FILTERED_CALLS; ++i)
+        log_print_debug("Filtered out [%lu]\n", i);
+    record("filtered", "none", 1, "log_print_debug", (double)(now_ns() - start) / FILTERED_CALLS, "ns/call");
+
+    // between parentheses, the function is called with no inline level check: the library checks it
+    start = now_ns();
+    for (unsigned long i = 0; i < FILTERED_CALLS; ++i)
+        (log_print_debug)("Filtered out [%lu]\n", i);
+    record("filtered", "none", 1, "log_print_debug_call", (double)(now_ns() - start) / FILTERED_CALLS, "ns/call");
+
+    start = now_ns();
+    for (unsigned long i = 0; i < FILTERED_CALLS; ++i)
+        LOG_DEBUG("Filtered out [%lu]\n", i);
+    record("filtered", "none", 1, "LOG_DEBUG", (double)(now_ns() - start) / FILTERED_CALLS, "ns/call");
+
+    log_set_level(LOG_MSG_INFO);
+}
+
+/**
+ * @brief Per-call latency percentiles of a single thread
+ *
+ * @param sink
+ */
+static void bench_latency(const bench_sink_t* sink)
+{
+    uint64_t* samples = malloc(bench.calls * sizeof(uint64_t));
+
+    if (!samples || sink->open(bench.directory) != 0)
+    {
+        free(samples);
+        log_close();
+        return;
+    }
+
+    for (unsigned long i = 0; i < bench.calls; ++i)
+    {
+        uint64_t start = now_ns();
+        log_print_info("Sensor [%lu] reading: %d, status %s\n", i % 16, (int)(i % 100), "ok");
+        samples[i] = now_ns() - start;
+    }
+    log_close();
+
+    qsort(samples, bench.calls, sizeof(uint64_t), compare_u64);
+    record("latency", sink->name, 1, "p50", (double)samples[bench.calls / 2], "ns");
+    record("latency", sink->name, 1, "p99", (double)samples[bench.calls * 99 / 100], "ns");
+    record("latency", sink->name, 1, "p99.9", (double)samples[bench.calls * 999 / 1000], "ns");
+    record("latency", sink->name, 1, "max", (double)samples[bench.calls - 1], "ns");
+
+    free(samples);
+    remove_log_files();
+}
+
+static void* log_storm(void* arg)
+{
+    unsigned long thread = (unsigned long)(uintptr_t)arg;
+
+    pthread_barrier_wait(&start_barrier);
+    for (unsigned long i = 0; i < lines_per_thread; ++i)
+        log_print_info("Thread [%lu] sensor [%lu] reading: %d, status %s\n", thread, i % 16, (int)(i % 100), "ok");
+
+    return NULL;
+}
+
+/**
+ * @brief Sustained throughput of 'threads' threads, until every log message is written
+ *
+ * @param sink
+ * @param threads
+ */
+static void bench_throughput(const bench_sink_t* sink, unsigned long threads)
+{
+    pthread_t workers[MAX_THREADS];
+    uint64_t start;
+
+    if (sink->open(bench.directory) != 0)
+    {
+        log_close();
+        return;
+    }
+
+    lines_per_thread = bench.calls / threads;
+    pthread_barrier_init(&start_barrier, NULL, (unsigned int)threads + 1);
+    for (unsigned long i = 0; i < threads; ++i)
+        pthread_create(&workers[i], NULL, log_storm, (void*)(uintptr_t)i);
+
+    pthread_barrier_wait(&start_barrier);
+    start = now_ns();
+    for (unsigned long i = 0; i < threads; ++i)
+        pthread_join(workers[i], NULL);
+    log_flush();
+
+    record("throughput", sink->name, threads, "lines", lines_per_thread * threads * 1e9 / (double)(now_ns() - start), "lines/s");
+
+    pthread_barrier_destroy(&start_barrier);
+    log_close();
+    remove_log_files();
+}
+
+int main(int argc, char* argv[]) {
+
+    char directory[] = "/tmp/log4embedded_bench.XXXXXX";
+    int stdout_copy;
+    int devnull;
+    int option;
+
+    while ((option = getopt(argc, argv, "f:t:n:d:")) != -1)
+    {
+        switch (option)
+        {
+            case 'f':
+                bench.json = (strcmp(optarg, "json") == 0);
+            break;
+
+            case 't':
+                bench.max_threads = strtoul(optarg, NULL, 10);
+            break;
+
+            case 'n':
+                bench.calls = strtoul(optarg, NULL, 10);
+            break;
+
+            case 'd':
+                bench.directory = optarg;
+            break;
+
+            default:
+                fprintf(stderr, "Usage: %s [-f csv|json] [-t max threads] [-n calls] [-d directory for log files]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if (bench.max_threads == 0 || bench.max_threads > MAX_THREADS || bench.calls < bench.max_threads)
+    {
+        fprintf(stderr, "Threads must be between 1 and %d, and calls at least as many as threads\n", MAX_THREADS);
+        return 1;
+    }
+
+    if (!bench.directory && !(bench.directory = mkdtemp(directory)))
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    // the stdout sink writes to /dev/null, and results go to the original stdout
+    stdout_copy = dup(STDOUT_FILENO);
+    devnull = open("/dev/null", O_WRONLY);
+    if (stdout_copy < 0 || devnull < 0 || !(bench.out = fdopen(stdout_copy, "w")))
+    {
+        perror("stdout");
+        return 1;
+    }
+    fflush(stdout);
+    dup2(devnull, STDOUT_FILENO);
+    close(devnull);
+
+    uname(&bench.machine);
+    log_set_level(LOG_MSG_INFO);
+
+    bench_filtered();
+
+    for (size_t i = 0; i < sizeof(sinks) / sizeof(sinks[0]); ++i)
+        bench_latency(&sinks[i]);
+
+    for (size_t i = 0; i < sizeof(sinks) / sizeof(sinks[0]); ++i)
+    {
+        for (unsigned long threads = 1; threads <= bench.max_threads; threads *= 2)
+            bench_throughput(&sinks[i], threads);
+    }
+
+    if (bench.json)
+        fprintf(bench.out, "\n]\n");
+
+    if (bench.directory == directory)
+        rmdir(directory);
+
+    fclose(bench.out);
+    return 0;
+}
@@ -1,7 +1,7 @@
 #!/bin/bash
 
 rm -rf ./_build/*
-cmake -B_build/ -DCMAKE_BUILD_TYPE=Release -DCMAKE_INSTALL_PREFIX=./package/ -DCMAKE_TOOLCHAIN_FILE=cmake_build_utilities/toolchain-file-linux-arm.cmake
+cmake -B_build/ -DCMAKE_BUILD_TYPE=Release -DCMAKE_INSTALL_PREFIX=./package/ -DCMAKE_TOOLCHAIN_FILE=cmake_build_utilities/toolchain-file-linux-arm.cmake -DBUILD_BENCHMARKS=1
 cd ./_build/
 echo "Generating package..."
 make package
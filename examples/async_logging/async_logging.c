@@ -0,0 +1,33 @@
+#include <string.h>
+#include <stdlib.h>
+
+#include "log4embedded.h"
+
+/*  In asynchronous mode, print calls render their log message into a bounded queue and return straight away. A dedicated writer
+    thread drains that queue to the log output, so a slow serial console or a stalled disk never stalls the caller.
+
+    When the queue is full, the overflow policy decides what to do (see LOG_OVERFLOW_POLICY in log4embedded.h):
+        - LOG_OVERFLOW_BLOCK --> wait for the writer thread to make room
+        - LOG_OVERFLOW_DROP_NEWEST --> discard the new log message
+        - LOG_OVERFLOW_DROP_OLDEST --> discard the oldest queued log message
+*/
+int main() {
+
+    // Queue up to 1024 log messages, and drop the new ones if the log output cannot keep up
+    if (log_async_start(1024, LOG_OVERFLOW_DROP_NEWEST) != 0)
+        log_print_warning("Asynchronous mode cannot be started. Logging synchronously\n");
+
+    for(int i = 0; i < 10000; ++i)
+        log_print_info("Number: [%d]\n", i);
+
+    // Write every queued log message, then stop the writer thread
+    log_async_stop();
+
+    log_print_info("Dropped log messages: %llu\n", (unsigned long long)log_async_get_dropped());
+
+    //... Rest of your application's code
+
+    log_close();
+    
+    return 0;
+}
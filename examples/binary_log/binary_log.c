@@ -0,0 +1,30 @@
+#include <stdio.h>
+
+#include "log4embedded.h"
+
+/*  Binary log files skip text formatting: every log message is stored as its category, a timestamp delta, the ID of its format
+    string and its packed arguments. Format strings are written once per file, the first time they are used.
+
+    Turn the binary log file back into text with the log4embedded-decode tool:
+        log4embedded-decode log/binary.bin
+
+    Please, note if "log" folder does not exist beforehand, it shall not create the log file.
+*/
+int main() {
+
+    const char log_file_name[15] = "log/binary.bin";
+
+    if (log_set_binary_file(log_file_name, sizeof(log_file_name)) != 0)
+        return 1;
+
+    for (int i = 0; i < 1000; ++i)
+        log_print_info("Sensor [%d] reading [%d]: %.2f degrees, status %s\n", i % 4, i, 20.0 + (i % 50) / 10.0, i % 7 ? "ok" : "degraded");
+
+    log_print_error("Example finished!!\n");
+
+    // write the buffered records before exiting
+    log_close();
+
+    printf("Run \"log4embedded-decode log/binary.bin\" to read the log file\n");
+    return 0;
+}
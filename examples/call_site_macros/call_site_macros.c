@@ -0,0 +1,49 @@
+#include <stdio.h>
+
+#include "log4embedded.h"
+
+/*  The LOG_* macros print like their log_print_* counterparts, but critical, error and debug messages also carry the file,
+    line and function they were called from:
+        [Err] [call_site_macros.c:31 read_sensor()] [date] Sensor 3 not responding
+
+    Arguments of a macro call are not evaluated if its log level is disabled at runtime. Besides, building with
+    -DLOG4EMBEDDED_MIN_LEVEL=<level> removes every call above <level> from the binary, e.g.: LOG4EMBEDDED_MIN_LEVEL=LOG_MSG_INFO
+    strips all LOG_DEBUG calls.
+
+    'log_set_layout' changes the layout of every log message, e.g.: "%t %l %f:%n %m" gives
+        date Err call_site_macros.c:31 Sensor 3 not responding
+*/
+
+static int expensive_calls = 0;
+
+static int expensive_value()
+{
+    return ++expensive_calls;
+}
+
+static void read_sensor(int id)
+{
+    LOG_ERR("Sensor %d not responding\n", id);
+}
+
+int main() {
+
+    LOG_INFO("Hello World!\n");
+
+    read_sensor(3);
+
+    // debug is disabled by default, so expensive_value() is never called here
+    LOG_DEBUG("Expensive value: %d\n", expensive_value());
+
+    log_set_level(LOG_MSG_DBG);
+    LOG_DEBUG("Expensive value: %d\n", expensive_value());
+
+    log_set_layout("%t %l %f:%n %m");
+    read_sensor(4);
+    LOG_INFO("Same layout for every category, %s\n", "with the source location");
+    log_set_layout(NULL);
+
+    LOG_CRIT("Example finished!! expensive_value() was called %d time(s)\n", expensive_calls);
+
+    return 0;
+}
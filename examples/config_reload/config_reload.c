@@ -0,0 +1,52 @@
+#include <stdio.h>
+#include <unistd.h>
+
+#include "log4embedded.h"
+
+#define CONFIG_FILE "config_reload.conf"
+
+/*  The configuration lives in a file, watched with inotify: editing it changes the level, routing, rotation or flush
+    policy of the running application, with no restart and no print call ever waiting. Here the file is rewritten
+    the way editors do, through a temporary file renamed over it.
+*/
+static void write_config(const char* content)
+{
+    FILE* file = fopen(CONFIG_FILE ".tmp", "w");
+
+    if (file)
+    {
+        fputs(content, file);
+        fclose(file);
+        rename(CONFIG_FILE ".tmp", CONFIG_FILE);
+    }
+}
+
+int main() {
+
+    write_config("# errors and warnings only\n"
+                 "level = warn\n");
+
+    if (log_watch_config_file(CONFIG_FILE, sizeof(CONFIG_FILE)) != 0)
+        return 1;
+
+    log_print_info("Info message: not printed\n");
+    log_print_warning("Warning message: printed\n");
+
+    write_config("level = debug\n"
+                 "flush = threshold 4K 100\n");
+    usleep(200 * 1000);
+
+    log_print_debug("Debug message: printed once the file changed, level %d\n", (int)log_get_level());
+
+    // a file which is not valid is reported, and the current configuration is kept
+    write_config("level = loud\n");
+    usleep(200 * 1000);
+
+    log_print_debug("Debug message: still printed\n");
+
+    log_print_critical("Example finished!!\n");
+
+    log_close();
+    remove(CONFIG_FILE);
+    return 0;
+}
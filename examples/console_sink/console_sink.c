@@ -0,0 +1,78 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "log4embedded.h"
+
+/*  A console sink never makes print calls wait for a slow console, e.g.: a serial terminal at 115200 bauds, which
+    takes about 11 KiB per second. Log messages are queued, and written by a thread of the sink. When the console
+    does not keep up, debug messages are dropped first, then info ones, but never critical ones.
+
+    Here, the console is a small pipe drained at the pace of such a serial line, and copied into the stdout.
+*/
+
+// Define how many bytes the simulated serial line takes every 10 ms: 115200 bauds, 10 bits per byte
+#define SERIAL_BYTES_PER_TICK   115
+
+static void* serial_line(void* arg)
+{
+    int fd = *(int*)arg;
+    char chunk[SERIAL_BYTES_PER_TICK];
+    struct timespec tick = {.tv_sec = 0, .tv_nsec = 10000000L};
+    ssize_t len;
+
+    while ((len = read(fd, chunk, sizeof(chunk))) > 0)
+    {
+        fwrite(chunk, 1, (size_t)len, stdout);
+        fflush(stdout);
+        nanosleep(&tick, NULL);
+    }
+
+    return NULL;
+}
+
+int main() {
+
+    int serial[2];
+    pthread_t reader;
+    struct timespec start, end;
+
+    if (pipe(serial) != 0 || pthread_create(&reader, NULL, serial_line, &serial[0]) != 0)
+        return 1;
+
+    // as little room as a UART FIFO and its driver would give
+    fcntl(serial[1], F_SETPIPE_SZ, 4096);
+
+    // the console sink is the only one writing into the console
+    log_set_level(LOG_MSG_NONE);
+
+    log_sink_config_t console = {.level = LOG_MSG_DBG, .colors = true, .format = LOG_SINK_FORMAT_FULL};
+    int sink = log_add_console_sink(serial[1], 4096, &console);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < 200; i++)
+    {
+        if (i % 50 == 0)
+            log_print_critical("Burst %d: critical messages are never dropped\n", i / 50);
+        else if (i % 2 == 0)
+            log_print_info("Burst %d: info message %d\n", i / 50, i);
+        else
+            log_print_debug("Burst %d: debug message %d\n", i / 50, i);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    log_print_critical("Example finished!! 200 print calls took %ld us\n",
+                       (long)((end.tv_sec - start.tv_sec) * 1000000 + (end.tv_nsec - start.tv_nsec) / 1000));
+
+    // flushes the sink, waiting a while for the serial line
+    log_remove_sink(sink);
+
+    close(serial[1]);
+    pthread_join(reader, NULL);
+
+    log_close();
+    return 0;
+}
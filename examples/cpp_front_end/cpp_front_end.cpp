@@ -0,0 +1,41 @@
+#include <string>
+#include <string_view>
+
+#include "log4embedded.hpp"
+
+/*  log4embedded.hpp turns the LOG_* macros into type-safe ones for C++17 and later: format strings are checked at
+    compile time, and arguments are captured by templates, with no va_list. These lines would not compile:
+        LOG_INFO("Sensor %d\n", "three");           // a string for "%d"
+        LOG_INFO("Sensor %d, %s\n", 3);             // missing argument
+        LOG_INFO("Sensor %lld\n", 3.0);             // a double for "%lld"
+
+    Arguments are converted to the width of their conversion specification, and "%s" takes std::string and
+    std::string_view as well.
+*/
+
+static void read_sensor(const std::string& name, int id)
+{
+    LOG_ERR("Sensor %s (%d) not responding\n", name, id);
+}
+
+int main() {
+
+    std::string device = "modem";
+    std::string_view port = std::string_view("/dev/ttyUSB0 and more").substr(0, 12);
+
+    LOG_INFO("Hello World!\n");
+    LOG_INFO("Device %s on %s, %zu bytes queued, %.2f%% busy\n", device, port, sizeof(device), 12.5);
+
+    read_sensor("temperature", 3);
+
+    // in asynchronous mode, captured arguments are queued as they are and rendered by the writer thread
+    log_async_start(64, LOG_OVERFLOW_BLOCK);
+    for (int i = 0; i < 3; i++)
+        LOG_WARN("Retry %d of %d on %s\n", i + 1, 3, device);
+    log_async_stop();
+
+    LOG_CRIT("Example finished!! [%-8s] [%08x] [%p]\n", "padded", 0xbeefu, nullptr);
+
+    log_close();
+    return 0;
+}
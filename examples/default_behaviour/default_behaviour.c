@@ -37,7 +37,7 @@ int main() {
         }            
     }
 
-    // Enable debug messages. Please, call configuration functions PRIOR TO creating threads, if your app is multi-threaded
+    // Enable debug messages. Configuration functions can be called at any time, from any thread
     log_set_level(LOG_MSG_DBG);
     log_print_debug("Example done\n");  // Now, it will be printed
 
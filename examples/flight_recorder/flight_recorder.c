@@ -0,0 +1,33 @@
+#include <stdlib.h>
+
+#include "log4embedded.h"
+
+/*  The flight recorder keeps every log message, debug ones included, in an in-memory ring, while only warnings and
+    above reach the log output. When something goes wrong, the ring shows what happened right before.
+
+    Run it with no argument: the critical message dumps the ring to the stdout.
+    Run it with any argument: the application aborts, and the SIGABRT handler dumps the ring before it dies.
+*/
+int main(int argc, char* argv[]) {
+
+    (void)argv;
+
+    log_set_level(LOG_MSG_WARN);
+
+    if (log_flight_recorder_start(64 * 1024) != 0)
+        return 1;
+
+    for (int i = 0; i < 10; ++i)
+        log_print_debug("Step [%d]: buffer at %d%%\n", i, i * 10);
+
+    log_print_info("Buffer full, not written to the log output\n");
+    log_print_warning("Buffer full, written to the log output and kept in the ring\n");
+
+    if (argc > 1)
+        abort();
+
+    log_print_critical("Example finished!!\n");
+
+    log_close();
+    return 0;
+}
@@ -0,0 +1,31 @@
+#include <stdio.h>
+
+#include "log4embedded.h"
+
+/*  Rotation keeps the log file from growing without bound: once "log/rotated.txt" reaches the maximum size, it is renamed to
+    "log/rotated.1.txt", the previous "log/rotated.1.txt" becomes "log/rotated.2.txt", and so on, up to the maximum number of files.
+    Older files are removed.
+
+    With LOG_COMPRESS_GZIP, rotated files are compressed by a background thread ("log/rotated.1.txt.gz"...), so print calls never
+    wait for the compression. LOG_ROTATE_DAILY also rotates the log file at local midnight.
+
+    Please, note if "log" folder does not exist beforehand, it shall not create the log file.
+*/
+int main() {
+
+    const char log_file_name[16] = "log/rotated.txt";
+    log_set_file(log_file_name, sizeof(log_file_name));
+
+    // rotate every 4 KiB, keep 3 rotated files, compressed if log4embedded was built with zlib
+    if (log_set_rotation(4096, 3, LOG_ROTATE_DAILY, LOG_COMPRESS_GZIP) != 0)
+        log_set_rotation(4096, 3, LOG_ROTATE_DAILY, LOG_COMPRESS_NONE);
+
+    for (int i = 0; i < 500; ++i)
+        log_print_info("Line number [%d]: enough lines to rotate the log file a few times\n", i);
+
+    // wait for the background thread to finish with the rotated files
+    log_close();
+
+    printf("Check log/rotated.txt and its rotated files\n");
+    return 0;
+}
@@ -0,0 +1,31 @@
+#include <stdio.h>
+
+#include "log4embedded.h"
+
+/*  The memory-mapped sink preallocates a segment of the log file and maps it into memory. Print calls then copy their log message
+    straight into the mapping: no lock, no system call. Log messages survive a crash of the application, as the kernel owns the
+    mapped pages, and they are synced to the storage every 'sync_interval_ms' milliseconds in case of power loss.
+
+    Full segments are rotated as set by "log_set_rotation": "log/mmap.txt" --> "log/mmap.1.txt" --> "log/mmap.2.txt"...
+    Please, note if "log" folder does not exist beforehand, it shall not create the log file.
+*/
+int main() {
+
+    const char log_file_name[13] = "log/mmap.txt";
+
+    // keep 2 full segments, besides the one in use
+    log_set_rotation(0, 2, LOG_ROTATE_NEVER, LOG_COMPRESS_NONE);
+
+    // 64 KiB segments, synced to the storage every 100 ms
+    if (log_set_mmap_file(log_file_name, sizeof(log_file_name), 64 * 1024, 100) != 0)
+        return 1;
+
+    for (int i = 0; i < 2000; ++i)
+        log_print_info("Line number [%d]: copied straight into the mapped log file\n", i);
+
+    // sync the last segment and cut the log file down to its log messages
+    log_close();
+
+    printf("Check log/mmap.txt and its rotated segments\n");
+    return 0;
+}
@@ -0,0 +1,29 @@
+#define LOG4EMBEDDED_MODULE "app"
+#include "log4embedded.h"
+
+/*  Every source file may name its module by defining LOG4EMBEDDED_MODULE before including log4embedded.h.
+    Here, debug messages are only wanted from the network stack ("net.*"), while the rest of the application
+    stays at LOG_MSG_INFO. Levels can be changed at any time, from any thread.
+*/
+void net_poll(int round);
+
+int main() {
+
+    for (int round = 0; round < 2; ++round)
+    {
+        LOG_DEBUG("Application debug message, round %d: never printed\n", round);
+        net_poll(round);
+
+        // only the network stack goes to debug from the second round on
+        log_set_module_level("net.*", LOG_MSG_DBG);
+    }
+
+    // and back to the level set via log_set_level
+    log_remove_module_level("net.*");
+    net_poll(2);
+
+    LOG_CRIT("Example finished!! net.tcp level: %d\n", (int)log_get_module_level("net.tcp"));
+
+    log_close();
+    return 0;
+}
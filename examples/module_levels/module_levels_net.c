@@ -0,0 +1,8 @@
+#define LOG4EMBEDDED_MODULE "net.tcp"
+#include "log4embedded.h"
+
+void net_poll(int round)
+{
+    LOG_DEBUG("Polling socket, round %d\n", round);
+    LOG_INFO("Socket ready\n");
+}
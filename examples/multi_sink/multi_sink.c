@@ -0,0 +1,60 @@
+#include <stdio.h>
+#include <unistd.h>
+
+#include "log4embedded.h"
+
+/*  Several sinks at once, each one with its own level, colors and format:
+        - the log output (default sink): plain log file, info messages and above
+        - the console: colored, warnings and above
+        - syslog: errors and above, with no label nor date, since syslog adds its own
+        - a sink of our own, counting every log message, debug ones included
+
+    Every log message is rendered once, and the same buffer is handed over to every sink.
+
+    Please, note if "log" folder does not exist beforehand, it shall not create the log file.
+*/
+
+// our own sink: count the log messages of every category
+static void count_message(void* context, const log_sink_message_t* message)
+{
+    unsigned int* counters = context;
+    counters[message->category]++;
+}
+
+int main() {
+
+    const char log_file_name[19] = "log/multi_sink.txt";
+    unsigned int counters[LOG_MSG_DBG + 1] = {0};
+
+    log_set_file(log_file_name, sizeof(log_file_name));
+
+    log_sink_config_t console = {.level = LOG_MSG_WARN, .colors = true, .format = LOG_SINK_FORMAT_FULL};
+    log_add_fd_sink(STDOUT_FILENO, &console);
+
+    log_sink_config_t syslog = {.level = LOG_MSG_ERR, .colors = false, .format = LOG_SINK_FORMAT_MESSAGE};
+    log_add_syslog_sink("multi_sink", &syslog);
+
+    log_sink_config_t counter = {.level = LOG_MSG_DBG, .colors = false, .format = LOG_SINK_FORMAT_FULL};
+    log_sink_ops_t counter_ops = {.write = count_message, .flush = NULL, .close = NULL};
+    int counter_sink = log_add_sink(&counter_ops, counters, &counter);
+
+    for (int i = 0; i < 5; ++i)
+    {
+        log_print_debug("Polling sensor [%d]\n", i);
+        log_print_info("Sensor [%d] reading: %d\n", i, 20 + i);
+        if (i == 3)
+            log_print_warning("Sensor [%d] reading is getting high\n", i);
+    }
+
+    log_print_error("Sensor [4] disconnected\n");
+
+    // the counting sink only wants errors from now on
+    log_set_sink_level(counter_sink, LOG_MSG_ERR);
+    log_print_info("Not counted anymore\n");
+
+    log_close();
+
+    printf("Counted: %u critical, %u error, %u warning, %u info, %u debug messages\n",
+           counters[LOG_MSG_CRIT], counters[LOG_MSG_ERR], counters[LOG_MSG_WARN], counters[LOG_MSG_INFO], counters[LOG_MSG_DBG]);
+    return 0;
+}
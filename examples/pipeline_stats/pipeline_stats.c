@@ -0,0 +1,48 @@
+#include <stdio.h>
+#include <unistd.h>
+
+#include "log4embedded.h"
+
+/*  The statistics tell where log messages go: how many of each category were printed, filtered, rate limited or
+    suppressed as duplicates, how many bytes were written, and how long each write into the log output and the
+    sinks took. Here they are printed every 100 ms as an info message, and read once at the end.
+*/
+int main() {
+
+    log_stats_t stats;
+
+    log_set_level(LOG_MSG_INFO);
+    log_enable_stats(100);
+    log_enable_duplicate_suppression(1000);
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        log_print_info("Reading %d\n", i);
+        log_print_debug("Raw value %d: filtered out\n", i);
+        if (i % 250 == 0)
+            usleep(50 * 1000);
+    }
+
+    for (int i = 0; i < 1000; ++i)
+        log_print_warning("Sensor [%d] slow\n", 3);
+
+    log_get_stats(&stats);
+    log_disable_stats();
+
+    printf("info %llu, warn %llu, filtered %llu, duplicates %llu, bytes %llu\n",
+           (unsigned long long)stats.messages[LOG_MSG_INFO], (unsigned long long)stats.messages[LOG_MSG_WARN],
+           (unsigned long long)stats.filtered, (unsigned long long)stats.duplicates,
+           (unsigned long long)stats.bytes_written);
+
+    printf("Log output write latency:\n");
+    for (int bucket = 0; bucket < LOG_STATS_LATENCY_BUCKETS; ++bucket)
+    {
+        if (stats.write_latency[LOG_SINK_DEFAULT][bucket] > 0)
+            printf("  < %6u us: %llu\n", 1u << bucket, (unsigned long long)stats.write_latency[LOG_SINK_DEFAULT][bucket]);
+    }
+
+    log_print_critical("Example finished!!\n");
+
+    log_close();
+    return 0;
+}
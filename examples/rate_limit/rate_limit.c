@@ -0,0 +1,31 @@
+#include <unistd.h>
+
+#include "log4embedded.h"
+
+/*  A failing sensor polled in a tight loop would print the very same error hundreds of thousands of times a second.
+    The rate limiter lets each call site print 5 log messages at once, then 2 per second, and tells how many it
+    dropped. The duplicate suppression collapses identical log messages into "Last message repeated N times".
+*/
+int main() {
+
+    log_set_rate_limit(2, 5);
+
+    for (int i = 0; i < 200000; ++i)
+    {
+        LOG_ERR("Sensor [%d] not responding\n", 3);
+        if (i % 50000 == 0)
+            usleep(500 * 1000);
+    }
+
+    log_set_rate_limit(0, 0);
+    log_enable_duplicate_suppression(1000);
+
+    for (int i = 0; i < 100000; ++i)
+        log_print_warning("Temperature above threshold\n");
+    log_print_info("Temperature back to normal\n");
+
+    log_print_critical("Example finished!!\n");
+
+    log_close();
+    return 0;
+}
@@ -40,6 +40,9 @@ int main() {
     //... Rest of your application's code
 
     log_print_debug("Exiting application!\n"); 
+
+    // Flush any buffered log message and close the log file
+    log_close();
     
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,22 @@
+#include "log4embedded.h"
+
+/*  Structured log messages are written as one JSON object per line (or logfmt), so that log shippers read them
+    with no regular expression. Values are encoded with no printf call at all.
+*/
+int main() {
+
+    log_disable_colors();
+
+    log_info_kv("Sensor read", "id", LOG_INT(3), "temp", LOG_DOUBLE(21.5), "unit", LOG_STR("C"), "ok", LOG_BOOL(true));
+    log_warning_kv("Sensor out of range", "id", LOG_INT(7), "value", LOG_DOUBLE(-0.125), "limit", LOG_UINT(100));
+    log_error_kv("Device \"modem\" not responding", "retries", LOG_INT(-1), "path", LOG_STR("/dev/tty USB0"));
+
+    log_set_kv_format(LOG_KV_LOGFMT);
+
+    log_info_kv("Sensor read", "id", LOG_INT(3), "temp", LOG_DOUBLE(21.5), "unit", LOG_STR("C"), "ok", LOG_BOOL(true));
+    log_error_kv("Device \"modem\" not responding", "retries", LOG_INT(-1), "path", LOG_STR("/dev/tty USB0"));
+    log_critical_kv("Example finished!!");
+
+    log_close();
+    return 0;
+}
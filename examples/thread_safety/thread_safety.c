@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "log4embedded.h"
+
+/*  Every print call renders its whole log message first, and then writes it at once. Therefore, log messages coming from
+    different threads never interleave, and configuration functions can be called at any time, from any thread.
+
+    This example doubles as a stress test: NUM_THREADS threads log at full speed into a log file whilst another thread keeps
+    changing the configuration. Then, the log file is read back to check that every single line is intact and that no line
+    is missing. Run it with any argument to stress the asynchronous mode instead. It returns a non-zero value on failure.
+*/
+
+#define NUM_THREADS         8
+#define LINES_PER_THREAD    20000
+#define PAYLOAD_SIZE        100
+
+static const char log_file_name[] = "thread_safety.txt";
+static volatile int writers_done = 0;
+
+static void* writer(void* arg)
+{
+    int id = (int)(long)arg;
+    char payload[PAYLOAD_SIZE + 1];
+
+    // each thread writes its own character, so that interleaved lines are easy to spot
+    memset(payload, 'a' + id, PAYLOAD_SIZE);
+    payload[PAYLOAD_SIZE] = '\0';
+
+    for (int i = 0; i < LINES_PER_THREAD; ++i)
+        log_print_info("thread %d line %d %s\n", id, i, payload);
+
+    return NULL;
+}
+
+static void* reconfigure(void* arg)
+{
+    (void)arg;
+
+    // Change the configuration at runtime, whilst the other threads keep on logging
+    while (!__atomic_load_n(&writers_done, __ATOMIC_RELAXED))
+    {
+        log_set_level(LOG_MSG_DBG);
+        log_set_flush_policy(LOG_FLUSH_ON_THRESHOLD, 8192, 10);
+        log_set_level(LOG_MSG_INFO);
+        log_set_flush_policy(LOG_FLUSH_EVERY_LINE, 0, 0);
+        log_flush();
+    }
+
+    return NULL;
+}
+
+static int check_log_file()
+{
+    int next_line[NUM_THREADS] = {0};
+    char line[2 * PAYLOAD_SIZE + 128];
+    int errors = 0;
+    FILE* file = fopen(log_file_name, "r");
+
+    if (!file)
+    {
+        printf("Log file cannot be opened\n");
+        return 1;
+    }
+
+    while (fgets(line, sizeof(line), file))
+    {
+        char payload[2 * PAYLOAD_SIZE];
+        int id = -1, number = -1;
+        const char* message = strstr(line, "] thread ");
+
+        if (!message || sscanf(message, "] thread %d line %d %199s", &id, &number, payload) != 3 ||
+            id < 0 || id >= NUM_THREADS || number != next_line[id] || strlen(payload) != PAYLOAD_SIZE ||
+            strspn(payload, (char[]){(char)('a' + id), '\0'}) != PAYLOAD_SIZE)
+        {
+            if (errors++ < 10)
+                printf("Broken line: %s", line);
+            continue;
+        }
+
+        next_line[id]++;
+    }
+
+    fclose(file);
+
+    for (int id = 0; id < NUM_THREADS; ++id)
+        if (next_line[id] != LINES_PER_THREAD)
+        {
+            printf("Thread %d: %d lines out of %d\n", id, next_line[id], LINES_PER_THREAD);
+            errors++;
+        }
+
+    return errors;
+}
+
+int main(int argc, char** argv) {
+
+    pthread_t writers[NUM_THREADS];
+    pthread_t reconfigurer;
+
+    (void)argv;
+
+    // Start from an empty log file
+    remove(log_file_name);
+    log_set_file(log_file_name, sizeof(log_file_name));
+    log_set_buffer_size(4096);
+
+    if (argc > 1 && log_async_start(1024, LOG_OVERFLOW_BLOCK) != 0)
+        return 1;
+
+    pthread_create(&reconfigurer, NULL, reconfigure, NULL);
+    for (long i = 0; i < NUM_THREADS; ++i)
+        pthread_create(&writers[i], NULL, writer, (void*)i);
+
+    for (int i = 0; i < NUM_THREADS; ++i)
+        pthread_join(writers[i], NULL);
+    __atomic_store_n(&writers_done, 1, __ATOMIC_RELAXED);
+    pthread_join(reconfigurer, NULL);
+
+    // Flush any buffered log message and close the log file before reading it back
+    log_close();
+
+    int errors = check_log_file();
+    printf("%s: %d threads x %d lines, %d errors\n", errors ? "FAILED" : "PASSED", NUM_THREADS, LINES_PER_THREAD, errors);
+
+    return errors ? 1 : 0;
+}
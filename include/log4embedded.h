@@ -26,6 +26,16 @@
  *              - It's possible to select a text file where log messages shall be written. If nothing is stated, stdout
  *                is assumed as the log output.
  * 
+ *              - Several sinks at once: besides the log output, log messages can go to other files, the console,
+ *                syslog, a UDP socket or user-defined sinks, each one with its own level, colors and format.
+ * 
+ *              - Call-site macros LOG_CRIT, LOG_ERR, LOG_WARN, LOG_INFO and LOG_DEBUG, which also log the caller's
+ *                file, line and function, skip argument evaluation when the level is disabled, and compile out
+ *                completely below LOG4EMBEDDED_MIN_LEVEL.
+ * 
+ *              - Thread safe: every log message is rendered first and then written at once, so messages from
+ *                different threads never interleave. Configuration functions can be called at runtime from any thread.
+ * 
  * @version 1.0
  * @date    2023-09-02
  * 
@@ -33,6 +43,17 @@
  * 
  */
 
+#ifndef LOG4EMBEDDED_H
+#define LOG4EMBEDDED_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /*  
     Enum LOG_MSG_CATEGORY: Define log categories from level 0 to level 6. 
     LOG_MSG_NONE (0) = most restrictive. No log message shall make it to the log output.
@@ -47,6 +68,251 @@ typedef enum {
     LOG_MSG_DBG         // log every print call made out of this API.
 } LOG_MSG_CATEGORY;
 
+/*
+    Enum LOG_FLUSH_POLICY: Define when buffered log messages are pushed to the log output.
+    LOG_FLUSH_EVERY_LINE   = every log message is flushed right after being written. This is the default value.
+    LOG_FLUSH_ON_ERROR     = buffered messages are flushed only when a critical or error message is written.
+    LOG_FLUSH_ON_THRESHOLD = buffered messages are flushed once a size (bytes) or time (milliseconds) threshold is exceeded.
+*/
+typedef enum {
+    LOG_FLUSH_EVERY_LINE = 0,
+    LOG_FLUSH_ON_ERROR,
+    LOG_FLUSH_ON_THRESHOLD
+} LOG_FLUSH_POLICY;
+
+/*
+    Enum LOG_TIMESTAMP_FORMAT: Define how the date and time of every log message are printed.
+    LOG_TIMESTAMP_LOCAL         = local time, as "YYYY/MM/DD - hh:mm:ss". This is the default value.
+    LOG_TIMESTAMP_UTC           = UTC time, as "YYYY/MM/DD - hh:mm:ss".
+    LOG_TIMESTAMP_ISO8601_LOCAL = local time, as ISO-8601 "YYYY-MM-DDThh:mm:ss+hh:mm".
+    LOG_TIMESTAMP_ISO8601_UTC   = UTC time, as ISO-8601 "YYYY-MM-DDThh:mm:ssZ".
+*/
+typedef enum {
+    LOG_TIMESTAMP_LOCAL = 0,
+    LOG_TIMESTAMP_UTC,
+    LOG_TIMESTAMP_ISO8601_LOCAL,
+    LOG_TIMESTAMP_ISO8601_UTC
+} LOG_TIMESTAMP_FORMAT;
+
+/*
+    Enum LOG_TIMESTAMP_PRECISION: Define the fraction of a second printed after the time of every log message.
+    LOG_TIMESTAMP_SEC  = no fraction of a second. This is the default value.
+    LOG_TIMESTAMP_MSEC = milliseconds, e.g.: "10:00:00.123".
+    LOG_TIMESTAMP_USEC = microseconds, e.g.: "10:00:00.123456".
+*/
+typedef enum {
+    LOG_TIMESTAMP_SEC = 0,
+    LOG_TIMESTAMP_MSEC,
+    LOG_TIMESTAMP_USEC
+} LOG_TIMESTAMP_PRECISION;
+
+/*
+    Enum LOG_OVERFLOW_POLICY: Define what a print call does when the asynchronous queue is full.
+    LOG_OVERFLOW_BLOCK       = wait until the writer thread makes room for the new log message. This is the default value.
+    LOG_OVERFLOW_DROP_NEWEST = discard the new log message.
+    LOG_OVERFLOW_DROP_OLDEST = discard the oldest queued log message to make room for the new one.
+*/
+typedef enum {
+    LOG_OVERFLOW_BLOCK = 0,
+    LOG_OVERFLOW_DROP_NEWEST,
+    LOG_OVERFLOW_DROP_OLDEST
+} LOG_OVERFLOW_POLICY;
+
+/*
+    Enum LOG_ROTATION_INTERVAL: Define whether the log file is also rotated on a time basis, besides its size.
+    LOG_ROTATE_NEVER = the log file is only rotated when it exceeds its maximum size. This is the default value.
+    LOG_ROTATE_DAILY = the log file is also rotated at local midnight.
+*/
+typedef enum {
+    LOG_ROTATE_NEVER = 0,
+    LOG_ROTATE_DAILY
+} LOG_ROTATION_INTERVAL;
+
+/*
+    Enum LOG_COMPRESSION: Define how rotated log files are stored.
+    LOG_COMPRESS_NONE = rotated log files are kept as they are, e.g.: "log.1.txt". This is the default value.
+    LOG_COMPRESS_GZIP = rotated log files are gzip-compressed in the background, e.g.: "log.1.txt.gz". 
+                        Only available if log4embedded was built with zlib.
+*/
+typedef enum {
+    LOG_COMPRESS_NONE = 0,
+    LOG_COMPRESS_GZIP
+} LOG_COMPRESSION;
+
+/*
+    Enum LOG_IO_STRATEGY: Define how the writer thread of the asynchronous mode writes bursts of log messages to the log output.
+    LOG_IO_WRITE  = one write() call per flush, as set by LOG_FLUSH_POLICY. This is the default value.
+    LOG_IO_WRITEV = the log messages of a burst are gathered, and written with a single writev() call.
+    LOG_IO_URING  = same as LOG_IO_WRITEV, but submitted to io_uring, so the writer thread does not wait for the write
+                    to complete before rendering the next burst. Falls back to LOG_IO_WRITEV where io_uring is not available.
+*/
+typedef enum {
+    LOG_IO_WRITE = 0,
+    LOG_IO_WRITEV,
+    LOG_IO_URING
+} LOG_IO_STRATEGY;
+
+/*
+    Enum LOG_SINK_FORMAT: Define which part of every log message a sink gets.
+    LOG_SINK_FORMAT_FULL    = label, date and message, e.g.: "[Info] [2023/09/02 - 10:00:00] message\n". This is the default value.
+    LOG_SINK_FORMAT_MESSAGE = the message only, e.g.: "message\n". For sinks adding their own label and date, such as syslog.
+*/
+typedef enum {
+    LOG_SINK_FORMAT_FULL = 0,
+    LOG_SINK_FORMAT_MESSAGE
+} LOG_SINK_FORMAT;
+
+/*
+    Enum LOG_KV_FORMAT: Define how structured log messages (see 'log_print_kv') are written.
+    LOG_KV_JSON   = one JSON object per line, e.g.: {"ts":"2023-09-02T10:00:00.000Z","level":"info","msg":"message","key":1}
+                    This is the default value.
+    LOG_KV_LOGFMT = logfmt, e.g.: ts=2023-09-02T10:00:00.000Z level=info msg=message key=1
+*/
+typedef enum {
+    LOG_KV_JSON = 0,
+    LOG_KV_LOGFMT
+} LOG_KV_FORMAT;
+
+/*
+    Enum LOG_KV_TYPE: Define the type of the value of a field of a structured log message. See the LOG_INT macro and the like.
+*/
+typedef enum {
+    LOG_KV_INT = 0,
+    LOG_KV_UINT,
+    LOG_KV_DOUBLE,
+    LOG_KV_STRING,
+    LOG_KV_BOOL
+} LOG_KV_TYPE;
+
+// ID of the default sink: the log output set via 'log_set_file', 'log_set_mmap_file' or 'log_set_binary_file', or the stdout
+#define LOG_SINK_DEFAULT    0
+
+// Maximum number of sinks added via 'log_add_sink' and the like, besides the default one
+#define LOG_MAX_SINKS       8
+
+// Maximum number of module patterns set via 'log_set_module_level'
+#define LOG_MAX_MODULE_LEVELS   32
+
+// Maximum size of a module name or pattern, including the NULL character
+#define LOG_MAX_MODULE_NAME     64
+
+// Settings of a sink
+typedef struct {
+    LOG_MSG_CATEGORY level;     // most verbose category the sink takes, as in 'log_set_level'
+    bool colors;                // whether log messages are wrapped in the ANSI colors of their category
+    LOG_SINK_FORMAT format;
+} log_sink_config_t;
+
+// A log message, as handed over to a sink. It is rendered once, and shared by every sink
+typedef struct {
+    LOG_MSG_CATEGORY category;
+    const char* text;           // according to the LOG_SINK_FORMAT of the sink, with no colors. Ends with a new line,
+                                // but it is not necessarily NULL-terminated
+    size_t length;
+    const char* color;          // ANSI escape sequence to write before 'text', "" if the sink has no colors
+    const char* color_reset;    // ANSI escape sequence to write after 'text', "" if the sink has no colors
+} log_sink_message_t;
+
+// Operations of a sink. Calls to the same sink never overlap, so they need no lock of their own
+typedef struct {
+    void (*write)(void* context, const log_sink_message_t* message);
+    void (*flush)(void* context);       // optional, called by 'log_flush'
+    void (*close)(void* context);       // optional, called when the sink is removed
+} log_sink_ops_t;
+
+// Number of buckets of the write latency histograms of 'log_stats_t'
+#define LOG_STATS_LATENCY_BUCKETS   16
+
+// Statistics of the logging pipeline, see 'log_get_stats'
+typedef struct {
+    uint64_t messages[LOG_MSG_DBG + 1];     // log messages past the log levels, per LOG_MSG_CATEGORY
+    uint64_t filtered;                      // print calls filtered out by the log levels (LOG_* macros and, with
+                                            // LOG4EMBEDDED_INLINE_FILTER, log_print_* filter theirs before
+                                            // calling the library, so those are not counted)
+    uint64_t rate_limited;                  // print calls dropped by the rate limit
+    uint64_t duplicates;                    // log messages suppressed as duplicates
+    uint64_t dropped;                       // log messages dropped by the asynchronous queue
+    uint64_t bytes_written;                 // bytes of log messages written into the log output
+    uint64_t flushes;                       // writes of the write buffer, or of a batch (see LOG_IO_STRATEGY),
+                                            // into the log output
+    size_t queue_high_water;                // most log messages ever waiting in the asynchronous queue
+    uint64_t write_latency[LOG_MAX_SINKS + 1][LOG_STATS_LATENCY_BUCKETS];   // per sink ID, writes which took less
+                                            // than 2^i microseconds in bucket i (the last one takes any longer one).
+                                            // Only while enabled by 'log_enable_stats'
+} log_stats_t;
+
+// Value of a field of a structured log message, built with the LOG_INT macro and the like
+typedef struct {
+    LOG_KV_TYPE type;
+    union {
+        int64_t i;
+        uint64_t u;
+        double d;
+        const char* s;          // NULL-terminated, NULL for a null value
+        bool b;
+    } value;
+} log_kv_value_t;
+
+#ifndef __cplusplus
+#define LOG_INT(v)      ((log_kv_value_t){.type = LOG_KV_INT, .value.i = (int64_t)(v)})
+#define LOG_UINT(v)     ((log_kv_value_t){.type = LOG_KV_UINT, .value.u = (uint64_t)(v)})
+#define LOG_DOUBLE(v)   ((log_kv_value_t){.type = LOG_KV_DOUBLE, .value.d = (double)(v)})
+#define LOG_STR(v)      ((log_kv_value_t){.type = LOG_KV_STRING, .value.s = (v)})
+#define LOG_BOOL(v)     ((log_kv_value_t){.type = LOG_KV_BOOL, .value.b = (v) ? true : false})
+#else
+// C++ has no compound literals
+static inline log_kv_value_t log4embedded_kv_value(LOG_KV_TYPE type)
+{
+    log_kv_value_t kv;
+    kv.type = type;
+    return kv;
+}
+
+static inline log_kv_value_t log4embedded_kv_int(int64_t v)         { log_kv_value_t kv = log4embedded_kv_value(LOG_KV_INT); kv.value.i = v; return kv; }
+static inline log_kv_value_t log4embedded_kv_uint(uint64_t v)       { log_kv_value_t kv = log4embedded_kv_value(LOG_KV_UINT); kv.value.u = v; return kv; }
+static inline log_kv_value_t log4embedded_kv_double(double v)       { log_kv_value_t kv = log4embedded_kv_value(LOG_KV_DOUBLE); kv.value.d = v; return kv; }
+static inline log_kv_value_t log4embedded_kv_string(const char* v)  { log_kv_value_t kv = log4embedded_kv_value(LOG_KV_STRING); kv.value.s = v; return kv; }
+static inline log_kv_value_t log4embedded_kv_bool(bool v)           { log_kv_value_t kv = log4embedded_kv_value(LOG_KV_BOOL); kv.value.b = v; return kv; }
+
+#define LOG_INT(v)      log4embedded_kv_int((int64_t)(v))
+#define LOG_UINT(v)     log4embedded_kv_uint((uint64_t)(v))
+#define LOG_DOUBLE(v)   log4embedded_kv_double((double)(v))
+#define LOG_STR(v)      log4embedded_kv_string(v)
+#define LOG_BOOL(v)     log4embedded_kv_bool((v) ? true : false)
+#endif
+
+/*
+    Enum LOG_ARG_TAG: Define the tags of the arguments of a format string, as captured for 'log_print_captured'.
+    Each tag is followed by its value, in the byte order of the host:
+    LOG_ARG_INT32       = int32_t: int and smaller integers, '*' widths and precisions, and characters
+    LOG_ARG_INT64       = int64_t: long, long long, intmax_t, size_t and ptrdiff_t
+    LOG_ARG_DOUBLE      = double
+    LOG_ARG_LONG_DOUBLE = long double
+    LOG_ARG_POINTER     = uint64_t, whatever the size of a pointer
+    LOG_ARG_STRING      = uint16_t length, then the characters of the string, with no NULL character
+*/
+typedef enum {
+    LOG_ARG_END = 0,
+    LOG_ARG_INT32,
+    LOG_ARG_INT64,
+    LOG_ARG_DOUBLE,
+    LOG_ARG_LONG_DOUBLE,
+    LOG_ARG_POINTER,
+    LOG_ARG_STRING
+} LOG_ARG_TAG;
+
+// Maximum size of the arguments captured for 'log_print_captured'. Longer strings are cut to fit
+#define LOG_MAX_CAPTURED_SIZE   256
+
+// Static description of a print call, for 'log_print_captured'. Every string must outlive the program, as literals do
+typedef struct {
+    LOG_MSG_CATEGORY category;
+    const char* file;           // source file of the print call, or NULL
+    int line;
+    const char* func;           // function of the print call, or NULL
+    const char* fmt;
+} log_call_site_t;
+
 
 /***********    Configuration operations    ************/
 
@@ -57,7 +323,7 @@ typedef enum {
  *          In case this function is not called, LOG_MSG_INFO level shall be assumed.
  * 
  *          it's strongly recommended to call this function on start up (e.g.: in the main funtion)
- *          if a different log level must apply.
+ *          if a different log level must apply. It's safe to call it at runtime from any thread, though.
  * 
  * @param log_level 
  */
@@ -70,6 +336,43 @@ void log_set_level(LOG_MSG_CATEGORY log_level);
  */
 LOG_MSG_CATEGORY log_get_level();
 
+/**
+ * @brief   Set the Log Level of a module, which overrides the one set via 'log_set_level' for the log output.
+ *          A module is named by defining LOG4EMBEDDED_MODULE before including this header, e.g.:
+ * 
+ *              #define LOG4EMBEDDED_MODULE "net.tcp"
+ *              #include "log4embedded.h"
+ * 
+ *          and only applies to the LOG_* macros of that source file. 'pattern' is either the name of a module, or
+ *          a prefix ending in '*', e.g.: "net.*" for "net.tcp" and "net.udp", or "*" for every module. The exact
+ *          name takes precedence over wildcards, and longer wildcards over shorter ones.
+ * 
+ *          Every call site caches the level of its module, and only looks it up again after a change of levels,
+ *          so the check stays a couple of loads and a comparison. Safe to call at runtime from any thread.
+ * 
+ * @param pattern   up to LOG_MAX_MODULE_NAME - 1 characters
+ * @param log_level 
+ * @return int      0 on success, -1 if an argument is not valid or LOG_MAX_MODULE_LEVELS patterns are already set
+ */
+int log_set_module_level(const char* pattern, LOG_MSG_CATEGORY log_level);
+
+/**
+ * @brief   Remove a pattern set via 'log_set_module_level': the modules matching it go back to the level of
+ *          another pattern, or the one set via 'log_set_level'.
+ * 
+ * @param pattern 
+ * @return int      0 on success, -1 if the pattern was not set
+ */
+int log_remove_module_level(const char* pattern);
+
+/**
+ * @brief   Get the Log Level a module is printed with, according to the patterns set via 'log_set_module_level'.
+ * 
+ * @param module 
+ * @return  LOG_MSG_CATEGORY the one set via 'log_set_level' if no pattern matches
+ */
+LOG_MSG_CATEGORY log_get_module_level(const char* module);
+
 /**
  * @brief   Set the log file where logs shall be written. Filepath size must not exceed 256 bytes.
  *          If the log file does not exist yet, then it will be created, AS LONG AS the directories
@@ -125,6 +428,481 @@ void log_enable_colors();
  */
 void log_disable_colors();
 
+/**
+ * @brief   Set how the date and time of every log message are printed, according to LOG_TIMESTAMP_FORMAT
+ *          and LOG_TIMESTAMP_PRECISION enums. By default, local time with no fraction of a second.
+ * 
+ *          Dates are cached per thread, and only rendered again when the second changes. Seconds and
+ *          milliseconds are read from a coarse clock (CLOCK_REALTIME_COARSE, where available), whose resolution
+ *          is a few milliseconds; microseconds are read from CLOCK_REALTIME.
+ * 
+ * @param format 
+ * @param precision 
+ */
+void log_set_timestamp_format(LOG_TIMESTAMP_FORMAT format, LOG_TIMESTAMP_PRECISION precision);
+
+/**
+ * @brief   Set the layout of every log message, as a pattern of literal text and conversions:
+ *              %t  date and time, as set by 'log_set_timestamp_format'
+ *              %l  category: Crit, Err, Warn, Info or Debug
+ *              %f  source file of the print call, as given by the LOG_* macros, "?" if unknown
+ *              %n  source line of the print call, "?" if unknown
+ *              %F  function of the print call, "?" if unknown
+ *              %%  a literal '%'
+ *              %m  the message with its arguments, which must come last
+ *          E.g.: "%t %l %f:%n %m" gives "2023/09/02 - 10:00:00 Err main.c:31 message\n".
+ * 
+ *          The pattern is compiled once into a list of operations, so print calls do not parse it. By default,
+ *          log messages are written as "[label] [file:line function()] [date] message", where the source location
+ *          is only written for critical, error and debug messages.
+ * 
+ * @param pattern   up to 32 conversions and runs of literal text, and 128 literal characters. NULL for the default layout
+ * @return int      0 on success, -1 if 'pattern' is not valid
+ */
+int log_set_layout(const char* pattern);
+
+/**
+ * @brief   Set the size, in bytes, of the write buffer used for the log output. By default, BUFSIZ bytes.
+ *          A size of 0 makes the log output unbuffered.
+ * 
+ *          The log file is opened once, when calling 'log_set_file' or 'log_set_file_with_color_text',
+ *          and kept open until 'log_close' is called. If a log file is already open when calling this
+ *          function, it is flushed and re-opened with the new buffer size.
+ * 
+ * @param buffer_size 
+ */
+void log_set_buffer_size(size_t buffer_size);
+
+/**
+ * @brief   Set the size, in bytes, of the buffer every thread renders its log messages into. 
+ *          By default, LOG4EMBEDDED_LINE_SIZE bytes (1024), which can also be changed at compile time.
+ * 
+ *          Each thread allocates its own buffer on its first print call, so print calls need no lock nor
+ *          heap allocation to render a log message. Longer log messages take a slower path which allocates
+ *          a temporary buffer, up to LOG4EMBEDDED_MAX_LINE_SIZE bytes (16384); beyond that, they are truncated.
+ * 
+ *          Lower it on memory-constrained targets, as it takes that much memory per logging thread.
+ *          Sizes are clamped between 128 and LOG4EMBEDDED_MAX_LINE_SIZE bytes.
+ * 
+ * @param line_size 
+ */
+void log_set_line_buffer_size(size_t line_size);
+
+/**
+ * @brief   Set when buffered log messages shall be flushed to the log output, according to LOG_FLUSH_POLICY enum.
+ * 
+ *          In case this function is not called, LOG_FLUSH_EVERY_LINE shall be assumed.
+ * 
+ *          Thresholds only apply to LOG_FLUSH_ON_THRESHOLD, and they are checked every time a log message is written:
+ *          the output is flushed once 'size_threshold' bytes have been buffered, or once 'time_threshold_ms'
+ *          milliseconds have elapsed since the last flush. A threshold set to 0 is ignored.
+ * 
+ * @param policy 
+ * @param size_threshold 
+ * @param time_threshold_ms 
+ */
+void log_set_flush_policy(LOG_FLUSH_POLICY policy, size_t size_threshold, unsigned int time_threshold_ms);
+
+/**
+ * @brief   Write log messages into a memory-mapped log file, instead of the log file set via 'log_set_file'.
+ *          Filepath size must not exceed 256 bytes. Colors are disabled.
+ * 
+ *          A segment of 'segment_size' bytes is preallocated and mapped, and print calls just copy their log
+ *          message into it, with no lock nor system call. Log messages survive a crash of the application,
+ *          since the kernel owns the mapped pages; 'sync_interval_ms' sets how often they are also synced to
+ *          the storage, in case of power loss.
+ * 
+ *          Once a segment is full, it is rotated as set by 'log_set_rotation' (its size and interval are 
+ *          ignored), or renamed to "log.1.txt" if rotation is not set, and a new segment is started.
+ *          Call 'log_close' to cut the log file down to its log messages.
+ * 
+ * @param filepath 
+ * @param filepath_size 
+ * @param segment_size      size of every segment, in bytes. At least 64 KiB
+ * @param sync_interval_ms  how often segments are synced to the storage, in milliseconds. 0 to leave it to the kernel
+ * @return int              0 on success, -1 if the file cannot be created, preallocated or mapped. 
+ *                          On failure, log messages are printed to the stdout.
+ */
+int log_set_mmap_file(const char* filepath, size_t filepath_size, size_t segment_size, unsigned int sync_interval_ms);
+
+/**
+ * @brief   Write log messages into a compact binary log file, instead of the log file set via 'log_set_file'.
+ *          Filepath size must not exceed 256 bytes.
+ * 
+ *          Print calls do no text formatting at all: every log message is stored as its category, a timestamp delta,
+ *          an ID of its format string and its packed arguments. Format strings are written once per file, the first
+ *          time they are used, and again with a new ID whenever the contents at their address change (e.g.: a buffer
+ *          rewritten by snprintf), which costs a hash of the format string per print call. Source locations of the
+ *          LOG_* macros are not stored. Long doubles are stored as doubles.
+ * 
+ *          Use the log4embedded-decode tool to turn a binary log file back into text.
+ * 
+ *          Records are buffered, and written once the buffer is full, on critical and error messages, or when calling
+ *          'log_flush' or 'log_close'. Binary log files are rotated as set by 'log_set_rotation' (its interval is 
+ *          ignored). Print calls write into the binary log file directly, even in asynchronous mode.
+ * 
+ * @param filepath 
+ * @param filepath_size 
+ * @return int  0 on success, -1 if the file cannot be opened. On failure, log messages are printed to the stdout.
+ */
+int log_set_binary_file(const char* filepath, size_t filepath_size);
+
+/**
+ * @brief   Rotate the log file set via 'log_set_file', 'log_set_file_with_color_text' or 'log_set_binary_file' once it reaches
+ *          'max_file_size' bytes and/or at local midnight, according to LOG_ROTATION_INTERVAL enum.
+ *          Rotation is disabled by default.
+ * 
+ *          Rotated log files are renamed after the log file with an index before its extension, the most recent
+ *          one first: "log.txt" --> "log.1.txt" --> "log.2.txt" ... up to 'max_files' files. Older ones are removed.
+ * 
+ *          Renaming older files and compressing the rotated one are done by a background thread, so print
+ *          calls only pay for closing and re-opening the log file. Call 'log_close' before exiting the
+ *          application to let that thread finish its work.
+ * 
+ * @param max_file_size maximum size of the log file, in bytes. 0 to rotate on a time basis only
+ * @param max_files     number of rotated log files to keep, at least 1
+ * @param interval      according to LOG_ROTATION_INTERVAL enum
+ * @param compression   according to LOG_COMPRESSION enum
+ * @return int          0 on success, -1 if any argument is not valid or the compression is not available.
+ *                      Rotation is disabled if both 'max_file_size' is 0 and 'interval' is LOG_ROTATE_NEVER.
+ */
+int log_set_rotation(size_t max_file_size, unsigned int max_files, LOG_ROTATION_INTERVAL interval, LOG_COMPRESSION compression);
+
+/**
+ * @brief   Add a sink: from now on, every log message allowed by its level is also handed over to 'ops->write',
+ *          along with 'context'. The log output (LOG_SINK_DEFAULT) keeps working as usual.
+ * 
+ *          Log messages are rendered once, whatever the number of sinks, and every sink gets the same buffer.
+ *          Print calls go through if any sink takes their category, so the most verbose sink sets the cost of
+ *          disabled print calls. In asynchronous mode, sinks are called by the writer thread.
+ * 
+ * @param ops       'write' is mandatory
+ * @param context   passed back to every operation of the sink
+ * @param config    level, colors and format of the sink
+ * @return int      ID of the sink, -1 if any argument is not valid or LOG_MAX_SINKS sinks were already added
+ */
+int log_add_sink(const log_sink_ops_t* ops, void* context, const log_sink_config_t* config);
+
+/**
+ * @brief   Add a sink writing into an already open file descriptor, e.g.: STDERR_FILENO. Every log message is written
+ *          with a single writev() call. The file descriptor is not closed when the sink is removed.
+ * 
+ * @param fd 
+ * @param config 
+ * @return int  ID of the sink, -1 on failure
+ */
+int log_add_fd_sink(int fd, const log_sink_config_t* config);
+
+/**
+ * @brief   Add a sink appending to a text file, created if it does not exist. Filepath size must not exceed 256 bytes.
+ *          Unlike the log output, it is neither buffered nor rotated.
+ * 
+ * @param filepath 
+ * @param filepath_size 
+ * @param config 
+ * @return int  ID of the sink, -1 if the file cannot be opened
+ */
+int log_add_file_sink(const char* filepath, size_t filepath_size, const log_sink_config_t* config);
+
+/**
+ * @brief   Add a sink sending log messages to syslog, with the priority matching their category. Syslog adds
+ *          its own date, so LOG_SINK_FORMAT_MESSAGE is the usual format. Colors are ignored.
+ * 
+ *          The connection and ident of syslog are process-wide: there is one syslog sink at most, and while it is
+ *          added, its openlog() call replaces any of the application. Removing it calls closelog().
+ * 
+ * @param ident     prepended to every syslog message, as in openlog(). It must outlive the sink. NULL for the program name
+ * @param config 
+ * @return int  ID of the sink, -1 on failure, or if a syslog sink is added already
+ */
+int log_add_syslog_sink(const char* ident, const log_sink_config_t* config);
+
+/**
+ * @brief   Add a sink sending every log message as a UDP datagram to 'host':'port'. Datagrams are sent with no
+ *          blocking: if the socket buffer is full, the log message is discarded for this sink.
+ * 
+ * @param host      host name or IP address
+ * @param port 
+ * @param config 
+ * @return int  ID of the sink, -1 if the host cannot be resolved or the socket cannot be created
+ */
+int log_add_udp_sink(const char* host, unsigned short port, const log_sink_config_t* config);
+
+/**
+ * @brief   Add a sink writing into a slow console, e.g.: a serial terminal on the stdout, with no print call ever
+ *          waiting for it. Log messages are queued into a ring of 'buffer_size' bytes, and a thread of its own writes
+ *          them into a non-blocking copy of 'fd', waiting with poll() while the console is busy. If 'fd' is neither a
+ *          terminal nor a pipe, e.g.: the stdout redirected to a file, the thread writes into 'fd' itself, appending
+ *          to what the application writes.
+ * 
+ *          When the console does not keep up, debug messages are dropped first (ring half full), then info ones
+ *          (three quarters full), then any other one which does not fit. Critical messages are never dropped: they
+ *          wait for room instead. How many were dropped is written as soon as the console keeps up again.
+ *          Colors are only written if 'fd' is a terminal, whatever 'config' says.
+ * 
+ *          Print calls to the log output set via 'log_set_file' (the stdout by default) still block: keep the console
+ *          out of it, e.g.: 'log_set_level(LOG_MSG_NONE)', or a log file.
+ * 
+ * @param fd            e.g.: STDOUT_FILENO. It stays open, and in blocking mode, for the application
+ * @param buffer_size   size of the ring, in bytes. 0 for 16 KiB
+ * @param config 
+ * @return int  ID of the sink, -1 on failure
+ */
+int log_add_console_sink(int fd, size_t buffer_size, const log_sink_config_t* config);
+
+/**
+ * @brief   Set the level of a sink. For LOG_SINK_DEFAULT, it's the same as 'log_set_level'.
+ * 
+ * @param sink      ID returned when adding the sink, or LOG_SINK_DEFAULT
+ * @param log_level 
+ * @return int  0 on success, -1 if there is no such sink
+ */
+int log_set_sink_level(int sink, LOG_MSG_CATEGORY log_level);
+
+/**
+ * @brief   Remove a sink, calling its 'close' operation once no print call uses it any longer.
+ *          The default sink cannot be removed: see 'log_close' instead. 'log_close' removes every other sink.
+ * 
+ * @param sink  ID returned when adding the sink
+ * @return int  0 on success, -1 if there is no such sink
+ */
+int log_remove_sink(int sink);
+
+/**
+ * @brief   Load the configuration from a text file of "key = value" lines. Filepath size must not exceed 256 bytes.
+ *          Lines starting with '#' are comments. Levels are none, crit, err, warn, info or debug:
+ * 
+ *              level = info                                # as in 'log_set_level'
+ *              file = /var/log/app.log                     # as in 'log_set_file'
+ *              flush = threshold 4K 500                    # every_line, on_error or threshold <bytes> <ms>
+ *              rotation = 1M 5 daily gzip                  # off, or <max_bytes> <max_files> [daily] [gzip]
+ *              module net.* = debug                        # as in 'log_set_module_level'
+ *              sink 2 = warn                               # level of a sink added by the application
+ *              sink file /var/log/err.log = err            # sinks added by the file: file, udp <host>:<port>
+ *              sink udp 10.0.0.1:5140 = warn               # or syslog <ident>
+ * 
+ *          The file is parsed as a whole into a snapshot: one which is not valid is reported as a warning, and the
+ *          current configuration is kept. Only settings which changed since the last snapshot are applied, through
+ *          the configuration functions above. Settings missing from the file are left as they are, but the module
+ *          patterns and sinks the file added are removed once they are gone from it.
+ * 
+ * @param filepath 
+ * @param filepath_size 
+ * @return int  0 on success, -1 if the file cannot be read or is not valid
+ */
+int log_load_config_file(const char* filepath, size_t filepath_size);
+
+/**
+ * @brief   Load the configuration from a text file, as 'log_load_config_file' does, and load it again every time
+ *          it is written or replaced. A thread of its own waits for inotify events on the directory of the file,
+ *          so editors saving through a temporary file are caught as well.
+ * 
+ *          Print calls are never blocked by a reload: every setting is published with a single atomic store,
+ *          or under the lock they already take to write, so the level check stays a single load.
+ * 
+ * @param filepath 
+ * @param filepath_size 
+ * @return int  0 on success, -1 if the file cannot be loaded or watched
+ */
+int log_watch_config_file(const char* filepath, size_t filepath_size);
+
+/**
+ * @brief   Stop watching the configuration file. The configuration it set is kept. Called by 'log_close'.
+ * 
+ */
+void log_unwatch_config_file();
+
+/**
+ * @brief   Flush every buffered log message to the log output and the other sinks.
+ * 
+ */
+void log_flush();
+
+/**
+ * @brief   Flush and close the log file, if any, and release its write buffer. Further log messages
+ *          shall be printed to the stdout.
+ * 
+ *          It's strongly recommended to call this function before exiting the application, so that
+ *          no buffered log message is lost.
+ * 
+ */
+void log_close();
+
+/**
+ * @brief   Switch to asynchronous mode: print calls render their log message into a bounded, lock-free queue
+ *          and return, and a dedicated writer thread drains that queue to the log output. Print calls therefore
+ *          never wait for the stdout or the log file, unless LOG_OVERFLOW_BLOCK is selected and the queue is full.
+ * 
+ *          Every queued log message takes LOG4EMBEDDED_ASYNC_RECORD_SIZE bytes (256 by default), and longer
+ *          messages are truncated. 'queue_capacity' is rounded up to the next power of two.
+ * 
+ * @param queue_capacity    maximum number of queued log messages
+ * @param policy            what to do when the queue is full, according to LOG_OVERFLOW_POLICY enum
+ * @return int              0 on success, -1 if the queue or the writer thread cannot be created
+ */
+int log_async_start(size_t queue_capacity, LOG_OVERFLOW_POLICY policy);
+
+/**
+ * @brief   Set how the writer thread of the asynchronous mode writes to the log output, according to LOG_IO_STRATEGY enum.
+ *          By default, LOG_IO_WRITE.
+ * 
+ *          With LOG_IO_WRITEV and LOG_IO_URING, the writer thread gathers the log messages it takes out of the queue in
+ *          a row, up to 64 KiB, and writes them with a single system call once the queue is empty or the batch is full,
+ *          whatever the LOG_FLUSH_POLICY. During log storms, this takes hundreds of log messages per system call instead
+ *          of one. Each batch counts as one flush in 'log_get_stats'. Synchronous print calls, memory-mapped and binary
+ *          log files, and the other sinks are not affected.
+ * 
+ *          io_uring is driven with raw system calls, with no liburing dependency, and needs Linux 5.6 or newer.
+ *          Use 'log_get_io_strategy' to know whether it was available.
+ * 
+ * @param strategy 
+ * @return int  0 on success, -1 if the strategy is not valid
+ */
+int log_set_io_strategy(LOG_IO_STRATEGY strategy);
+
+/**
+ * @brief   Get the LOG_IO_STRATEGY in use: LOG_IO_WRITEV if LOG_IO_URING was requested but io_uring is not available.
+ * 
+ * @return  LOG_IO_STRATEGY 
+ */
+LOG_IO_STRATEGY log_get_io_strategy();
+
+/**
+ * @brief   Write every queued log message, stop the writer thread and go back to synchronous mode.
+ *          'log_close' calls this function too.
+ * 
+ */
+void log_async_stop();
+
+/**
+ * @brief   Get the number of log messages discarded because the asynchronous queue was full, since 
+ *          'log_async_start' was called.
+ * 
+ * @return  uint64_t 
+ */
+uint64_t log_async_get_dropped();
+
+/**
+ * @brief   Start the flight recorder: every log message, whatever its category and the log level, is also kept in an
+ *          in-memory ring of 'ring_size' bytes (rounded up to the next power of two), overwriting the oldest ones.
+ *          Only log messages allowed by 'log_set_level' still make it to the log output.
+ * 
+ *          The content of the ring is dumped to the log output on 'log_print_critical' (or LOG_CRIT), when calling
+ *          'log_flight_recorder_dump', and on fatal signals (SIGSEGV, SIGABRT, SIGBUS, SIGFPE, SIGILL) with
+ *          async-signal-safe calls only, before the previous signal handler runs. Every log message is dumped once.
+ *          Binary and memory-mapped log files are dumped to the stderr instead.
+ * 
+ *          Debug messages are rendered, but not written, so they cost no I/O. Print calls write into the ring
+ *          with no lock: messages written at the very moment of a crash may show up incomplete.
+ * 
+ * @param ring_size size of the ring, in bytes. At least 4096
+ * @return int      0 on success, -1 if the ring cannot be allocated
+ */
+int log_flight_recorder_start(size_t ring_size);
+
+/**
+ * @brief   Dump the log messages kept by the flight recorder since the last dump to the log output.
+ * 
+ */
+void log_flight_recorder_dump();
+
+/**
+ * @brief   Stop the flight recorder, release its ring, and restore the previous fatal signal handlers.
+ * 
+ */
+void log_flight_recorder_stop();
+
+/**
+ * @brief   Enable deferred formatting for asynchronous mode: print calls only capture the format string and
+ *          the binary value of its arguments, and the writer thread renders the log message later on. Strings
+ *          passed as "%s" are copied, so they may be released right after the print call.
+ * 
+ *          Format strings themselves are NOT copied: they must outlive the print call, as string literals do.
+ *          The date of the log message is taken by the print call, not by the writer thread.
+ * 
+ *          Log messages whose arguments do not fit in a queued log message, or use an unknown conversion,
+ *          are rendered by the print call as usual. This option has no effect in synchronous mode.
+ * 
+ */
+void log_enable_deferred_formatting();
+
+/**
+ * @brief   Disable deferred formatting: print calls render the whole log message. This is the option by default.
+ * 
+ */
+void log_disable_deferred_formatting();
+
+/**
+ * @brief   Select how structured log messages are written, according to LOG_KV_FORMAT enum. LOG_KV_JSON by default.
+ *
+ * @param format
+ * @return int      0 on success, -1 if 'format' is not valid
+ */
+int log_set_kv_format(LOG_KV_FORMAT format);
+
+/**
+ * @brief   Get the statistics of the logging pipeline since the start, or the last 'log_reset_stats'. Counters are
+ *          kept per group of threads, in their own cache lines, so print calls do not contend on them.
+ * 
+ * @param stats 
+ * @return int      0 on success, -1 if 'stats' is NULL
+ */
+int log_get_stats(log_stats_t* stats);
+
+/**
+ * @brief   Set every statistic of the logging pipeline back to 0.
+ * 
+ */
+void log_reset_stats();
+
+/**
+ * @brief   Time every write into the log output and the sinks, for the latency histograms of 'log_get_stats'. 
+ *          Counters are kept anyway: timing costs two clock reads per write, so it is disabled by default.
+ *          If 'report_interval_ms' is not 0, the statistics are also printed as an info message that often,
+ *          e.g.: "Stats: 0 crit, 2 err, ... queue high water 17". The report is due on the next print call.
+ * 
+ * @param report_interval_ms 
+ */
+void log_enable_stats(unsigned int report_interval_ms);
+
+/**
+ * @brief   Stop timing writes, and printing the statistics. Counters are still kept.
+ * 
+ */
+void log_disable_stats();
+
+/**
+ * @brief   Limit how often each call site may print: a call site is a format string, along with the file and line
+ *          given by the LOG_* macros, and each one gets a token bucket of 'burst' log messages, refilled at
+ *          'messages_per_second'. Print calls beyond that are dropped before any formatting or I/O, and counted:
+ *          when the call site is let through again, "Rate limit: N ... suppressed" is printed first.
+ *
+ *          Critical messages are never limited. Up to 256 call sites are tracked; further ones are not limited.
+ *          Pending counts are also reported by 'log_flush' and 'log_close'.
+ *
+ * @param messages_per_second   log messages per second each call site may print in the long run, 0 for no limit
+ * @param burst                 log messages a call site may print at once. At least 1, unless there is no limit
+ * @return int                  0 on success, -1 if 'burst' is not valid
+ */
+int log_set_rate_limit(unsigned int messages_per_second, unsigned int burst);
+
+/**
+ * @brief   Collapse repeated log messages, as syslog does: a log message whose text and category are the same as the
+ *          last one written is only counted, and "Last message repeated N times" is printed when a different one
+ *          comes, every 'report_interval_ms' while it keeps coming, and on 'log_flush' or 'log_close'.
+ *
+ *          Log messages are compared once rendered, without their date. It does not apply to binary log files.
+ *
+ * @param report_interval_ms    how often the count of a log message which keeps repeating is printed
+ */
+void log_enable_duplicate_suppression(unsigned int report_interval_ms);
+
+/**
+ * @brief   Disable the duplicate suppression. This is the option by default.
+ *
+ */
+void log_disable_duplicate_suppression();
+
 
 /***********    Log generation operations    ************/
 
@@ -167,4 +945,193 @@ void log_print_info(const char* fmt, ...);
  * 
  * @param fmt 
  */
-void log_print_debug(const char* fmt, ...);
\ No newline at end of file
+void log_print_debug(const char* fmt, ...);
+
+/**
+ * @brief   Print a message of the given category, along with where it was printed from. 
+ *          The source location is shown for critical, error and debug messages.
+ *          It is normally called through the LOG_* macros below, rather than directly.
+ * 
+ * @param category  LOG_MSG_CRIT to LOG_MSG_DBG
+ * @param file      source file of the print call
+ * @param line      source line of the print call
+ * @param func      function of the print call, or NULL
+ * @param fmt 
+ */
+void log_print_at(LOG_MSG_CATEGORY category, const char* file, int line, const char* func, const char* fmt, ...)
+#if defined(__GNUC__)
+    __attribute__((format(printf, 5, 6)))
+#endif
+    ;
+
+/**
+ * @brief   Print a structured log message: the date, the category, 'msg' and a list of fields, written as one line
+ *          according to LOG_KV_FORMAT, with no printf-style formatting at all. Fields are pairs of a key and a value
+ *          built with the LOG_INT macro and the like, and the list ends with a NULL key.
+ *          It is normally called through the log_*_kv macros below, which add the NULL key, e.g.:
+ * 
+ *              log_info_kv("sensor read", "id", LOG_INT(3), "temp", LOG_DOUBLE(21.5), "unit", LOG_STR("C"));
+ * 
+ *          Fields which do not fit in LOG4EMBEDDED_MAX_LINE_SIZE bytes are left out, so that the line stays valid.
+ *          Structured log messages are not written into binary log files.
+ * 
+ * @param category  LOG_MSG_CRIT to LOG_MSG_DBG
+ * @param msg       message, written as a string field
+ * @param ...       key (const char*), value (log_kv_value_t), key, value..., NULL
+ */
+void log_print_kv(LOG_MSG_CATEGORY category, const char* msg, ...);
+
+#define log_critical_kv(...)    log_print_kv(LOG_MSG_CRIT, __VA_ARGS__, (const char*)NULL)
+#define log_error_kv(...)       log_print_kv(LOG_MSG_ERR, __VA_ARGS__, (const char*)NULL)
+#define log_warning_kv(...)     log_print_kv(LOG_MSG_WARN, __VA_ARGS__, (const char*)NULL)
+#define log_info_kv(...)        log_print_kv(LOG_MSG_INFO, __VA_ARGS__, (const char*)NULL)
+#define log_debug_kv(...)       log_print_kv(LOG_MSG_DBG, __VA_ARGS__, (const char*)NULL)
+
+
+/**
+ * @brief   Same as 'log_print_at', for a module whose level is 'module_level'. It is called by the LOG_* macros when
+ *          LOG4EMBEDDED_MODULE is defined, rather than directly.
+ * 
+ */
+void log_print_module_at(LOG_MSG_CATEGORY category, LOG_MSG_CATEGORY module_level, const char* file, int line,
+                         const char* func, const char* fmt, ...)
+#if defined(__GNUC__)
+    __attribute__((format(printf, 6, 7)))
+#endif
+    ;
+
+/**
+ * @brief   Print a message whose arguments are already captured, as tagged values of its format string (see
+ *          LOG_ARG_TAG), along with the source location of 'site'. It takes the same way as 'log_print_at', except
+ *          that arguments are never read through a va_list: in asynchronous mode they are queued as they are, and
+ *          rendered by the writer thread.
+ *          It is normally called through the LOG_* macros of log4embedded.hpp, which capture the arguments of each
+ *          call site with no format string parsing at runtime.
+ * 
+ * @param site      category, source location and format string of the print call
+ * @param args      captured arguments of 'site->fmt'
+ * @param args_size up to LOG_MAX_CAPTURED_SIZE bytes
+ */
+void log_print_captured(const log_call_site_t* site, const uint8_t* args, size_t args_size);
+
+/**
+ * @brief   Same as 'log_print_captured', for a module whose level is 'module_level'. It is called by the LOG_* macros of
+ *          log4embedded.hpp when LOG4EMBEDDED_MODULE is defined, rather than directly.
+ * 
+ */
+void log_print_module_captured(const log_call_site_t* site, LOG_MSG_CATEGORY module_level, const uint8_t* args,
+                               size_t args_size);
+
+/**
+ * @brief   Look up the level of a module, and cache it into the state of a call site of the LOG_* macros.
+ *          Only meant for the macros below.
+ * 
+ * @return  uint32_t the new state: generation << 8 | most verbose category to print << 4 | level of the module
+ */
+uint32_t log_module_resolve(const char* module, uint32_t* site);
+
+
+/***********    Call-site macros    ************/
+
+/**
+ * @brief   Most verbose level compiled in. Any LOG_* call above it is removed at compile time, arguments included.
+ *          E.g.: build with -DLOG4EMBEDDED_MIN_LEVEL=LOG_MSG_INFO to strip every LOG_DEBUG call from a release build.
+ * 
+ */
+#ifndef LOG4EMBEDDED_MIN_LEVEL
+#define LOG4EMBEDDED_MIN_LEVEL  LOG_MSG_DBG
+#endif
+
+// current log level, only meant for the inline check of the macros below. Use log_get_level/log_set_level instead.
+extern LOG_MSG_CATEGORY log4embedded_level;
+
+/**
+ * @brief   Whether print calls of this category go through, to the log output, a sink or the flight recorder.
+ *          Inlined into the caller, it is a single load and compare-and-branch, with no call into the library.
+ * 
+ */
+static inline bool log4embedded_enabled(LOG_MSG_CATEGORY level)
+{
+#if defined(__GNUC__)
+    return __builtin_expect((int)level <= (int)__atomic_load_n(&log4embedded_level, __ATOMIC_RELAXED), 0);
+#else
+    return (int)level <= (int)log_get_level();
+#endif
+}
+
+#define LOG4EMBEDDED_ENABLED(level) \
+    ((int)(level) <= (int)(LOG4EMBEDDED_MIN_LEVEL) && log4embedded_enabled(level))
+
+// generation of the module levels, only meant for the inline check of the macros below
+extern uint32_t log4embedded_generation;
+
+/**
+ * @brief   State of a call site of the LOG_* macros in a module, looked up again only if the module levels changed
+ *          since it was cached.
+ * 
+ */
+static inline uint32_t log4embedded_module_state(const char* module, uint32_t* site)
+{
+#if defined(__GNUC__)
+    uint32_t state = __atomic_load_n(site, __ATOMIC_RELAXED);
+    if (__builtin_expect((state >> 8) != __atomic_load_n(&log4embedded_generation, __ATOMIC_RELAXED), 0))
+        state = log_module_resolve(module, site);
+    return state;
+#else
+    return log_module_resolve(module, site);
+#endif
+}
+
+/**
+ * @brief   Print a message of the given category with the caller's file, line and function.
+ *          Arguments are only evaluated if the message is going to be printed.
+ *          If LOG4EMBEDDED_MODULE is defined, the level of the module applies, as set via 'log_set_module_level'.
+ * 
+ */
+#ifdef LOG4EMBEDDED_MODULE
+#define LOG_PRINT_AT(level, ...) \
+    do { \
+        static uint32_t log4embedded_site_ = 0; \
+        if ((int)(level) <= (int)(LOG4EMBEDDED_MIN_LEVEL)) \
+        { \
+            uint32_t log4embedded_state_ = log4embedded_module_state(LOG4EMBEDDED_MODULE, &log4embedded_site_); \
+            if ((int)(level) <= (int)((log4embedded_state_ >> 4) & 0xf)) \
+                log_print_module_at((level), (LOG_MSG_CATEGORY)(log4embedded_state_ & 0xf), \
+                                    __FILE__, __LINE__, __func__, __VA_ARGS__); \
+        } \
+    } while (0)
+#else
+#define LOG_PRINT_AT(level, ...) \
+    do { \
+        if (LOG4EMBEDDED_ENABLED(level)) \
+            log_print_at((level), __FILE__, __LINE__, __func__, __VA_ARGS__); \
+    } while (0)
+#endif
+
+#define LOG_CRIT(...)   LOG_PRINT_AT(LOG_MSG_CRIT, __VA_ARGS__)
+#define LOG_ERR(...)    LOG_PRINT_AT(LOG_MSG_ERR, __VA_ARGS__)
+#define LOG_WARN(...)   LOG_PRINT_AT(LOG_MSG_WARN, __VA_ARGS__)
+#define LOG_INFO(...)   LOG_PRINT_AT(LOG_MSG_INFO, __VA_ARGS__)
+#define LOG_DEBUG(...)  LOG_PRINT_AT(LOG_MSG_DBG, __VA_ARGS__)
+
+/**
+ * @brief   Optional inline level check of the log_print_* functions, so that a filtered call costs a compare-and-branch
+ *          in the caller rather than a call into the library (through the PLT, when linked dynamically). Define
+ *          LOG4EMBEDDED_INLINE_FILTER before including this header to turn it on. As with the LOG_* macros, arguments
+ *          are then not evaluated if the message is filtered out, and the function names can no longer be taken as
+ *          function pointers unless written between parentheses, e.g.: (log_print_debug)("...").
+ * 
+ */
+#ifdef LOG4EMBEDDED_INLINE_FILTER
+#define log_print_critical(...) (log4embedded_enabled(LOG_MSG_CRIT) ? log_print_critical(__VA_ARGS__) : (void)0)
+#define log_print_error(...)    (log4embedded_enabled(LOG_MSG_ERR) ? log_print_error(__VA_ARGS__) : (void)0)
+#define log_print_warning(...)  (log4embedded_enabled(LOG_MSG_WARN) ? log_print_warning(__VA_ARGS__) : (void)0)
+#define log_print_info(...)     (log4embedded_enabled(LOG_MSG_INFO) ? log_print_info(__VA_ARGS__) : (void)0)
+#define log_print_debug(...)    (log4embedded_enabled(LOG_MSG_DBG) ? log_print_debug(__VA_ARGS__) : (void)0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LOG4EMBEDDED_H
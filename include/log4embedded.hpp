@@ -0,0 +1,412 @@
+/**
+ * @file    log4embedded.hpp
+ * @brief   Optional C++17 front end of log4embedded. Including it instead of log4embedded.h turns the LOG_* call-site
+ *          macros into type-safe ones:
+ *              - the format string is parsed at compile time, and its conversion specifications are checked against
+ *                the number and types of the arguments. A mismatch is a compile error, not undefined behaviour.
+ *              - the category, file, line, function and format string of every call site are a constexpr object,
+ *                built once by the compiler.
+ *              - arguments are serialized by templates as tagged values (see LOG_ARG_TAG), with no va_list nor
+ *                format string parsing at runtime, and handed over to 'log_print_captured'. In asynchronous mode,
+ *                the writer thread renders them.
+ *
+ *          Arguments are converted to the width of their conversion specification, e.g.: "%lld" takes any integer.
+ *          Besides C strings, "%s" also takes std::string and std::string_view, which need no NULL character.
+ *          Format strings must be string literals; "%n", "%ls" and "%lc" are not supported.
+ *
+ *          With C++20, the format string is parsed by a consteval function.
+ *
+ */
+
+#ifndef LOG4EMBEDDED_HPP
+#define LOG4EMBEDDED_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "log4embedded.h"
+
+#if __cplusplus >= 202002L
+#define LOG4EMBEDDED_CONSTEVAL  consteval
+#else
+#define LOG4EMBEDDED_CONSTEVAL  constexpr
+#endif
+
+namespace log4embedded
+{
+namespace detail
+{
+
+// Maximum number of arguments of a format string, '*' widths and precisions included
+inline constexpr std::size_t max_args = 32;
+
+// What a conversion specification takes from the argument list
+enum class arg_kind : std::uint8_t
+{
+    int32,          // int and smaller integers, '*' widths and precisions, characters
+    int64,          // integers with a "l", "ll", "j", "z" or "t" length modifier
+    floating,
+    long_floating,  // "L" length modifier
+    string,
+    pointer
+};
+
+// Argument layout of a format string, as parsed at compile time
+struct format_layout
+{
+    bool valid = true;                      // false if there is an unsupported conversion specification
+    std::size_t count = 0;
+    arg_kind kinds[max_args] = {};
+    std::size_t reserved[max_args] = {};    // bytes the arguments after each one take at least, so that strings leave room for them
+    bool has_strings = false;
+    std::size_t min_size = 0;               // bytes all arguments take at least, strings being empty
+};
+
+/**
+ * @brief Bytes an argument takes at least, tag included
+ *
+ */
+constexpr std::size_t min_arg_size(arg_kind kind)
+{
+    switch (kind)
+    {
+        case arg_kind::int32:           return 1 + sizeof(std::int32_t);
+        case arg_kind::int64:           return 1 + sizeof(std::int64_t);
+        case arg_kind::floating:        return 1 + sizeof(double);
+        case arg_kind::long_floating:   return 1 + sizeof(long double);
+        case arg_kind::pointer:         return 1 + sizeof(std::uint64_t);
+        case arg_kind::string:          return 1 + sizeof(std::uint16_t);
+    }
+    return 0;
+}
+
+constexpr bool is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+constexpr void push_arg(format_layout& layout, arg_kind kind)
+{
+    if (layout.count >= max_args)
+        layout.valid = false;
+    else
+        layout.kinds[layout.count++] = kind;
+}
+
+/**
+ * @brief Parse a format string as log_internal_capture_args does, and work out the layout of its captured arguments
+ *
+ * @param fmt
+ * @return format_layout
+ */
+LOG4EMBEDDED_CONSTEVAL format_layout parse_format(const char* fmt)
+{
+    format_layout layout{};
+
+    for (const char* p = fmt; *p != '\0'; ++p)
+    {
+        if (*p != '%')
+            continue;
+
+        if (*++p == '%')
+            continue;
+
+        // flags
+        while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0' || *p == '\'')
+            ++p;
+
+        // width
+        if (*p == '*')
+        {
+            push_arg(layout, arg_kind::int32);
+            ++p;
+        }
+        else
+            while (is_digit(*p))
+                ++p;
+
+        // precision
+        if (*p == '.')
+        {
+            if (*++p == '*')
+            {
+                push_arg(layout, arg_kind::int32);
+                ++p;
+            }
+            else
+                while (is_digit(*p))
+                    ++p;
+        }
+
+        // length modifier
+        char mod = '\0';
+        if (*p == 'h' || *p == 'l' || *p == 'j' || *p == 'z' || *p == 't' || *p == 'L')
+        {
+            mod = *p++;
+            if ((mod == 'h' || mod == 'l') && *p == mod)
+                ++p;
+        }
+
+        switch (*p)
+        {
+            case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+                push_arg(layout, mod == 'l' || mod == 'j' || mod == 'z' || mod == 't' ? arg_kind::int64 : arg_kind::int32);
+            break;
+
+            case 'c':
+                layout.valid = layout.valid && mod == '\0';
+                push_arg(layout, arg_kind::int32);
+            break;
+
+            case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+                push_arg(layout, mod == 'L' ? arg_kind::long_floating : arg_kind::floating);
+            break;
+
+            case 's':
+                layout.valid = layout.valid && mod == '\0';
+                layout.has_strings = true;
+                push_arg(layout, arg_kind::string);
+            break;
+
+            case 'p':
+                push_arg(layout, arg_kind::pointer);
+            break;
+
+            default:
+                layout.valid = false;
+            break;
+        }
+
+        if (!layout.valid)
+            return layout;
+    }
+
+    for (std::size_t i = layout.count; i-- > 0;)
+    {
+        layout.reserved[i] = layout.min_size;
+        layout.min_size += min_arg_size(layout.kinds[i]);
+    }
+
+    return layout;
+}
+
+template <typename Fmt>
+inline constexpr format_layout layout_of = parse_format(Fmt::value());
+
+template <typename T>
+inline constexpr bool is_string_v = std::is_same_v<T, char*> || std::is_same_v<T, const char*> ||
+                                    std::is_same_v<T, std::string> || std::is_same_v<T, std::string_view>;
+
+/**
+ * @brief Whether an argument of type T is valid for a conversion specification
+ *
+ */
+template <typename T>
+constexpr bool accepts(arg_kind kind)
+{
+    using U = std::decay_t<T>;
+    constexpr bool integer = std::is_integral_v<U> || std::is_enum_v<U>;
+
+    switch (kind)
+    {
+        case arg_kind::int32:           return integer && sizeof(U) <= sizeof(std::int32_t);
+        case arg_kind::int64:           return integer;
+        case arg_kind::floating:        return std::is_floating_point_v<U>;
+        case arg_kind::long_floating:   return std::is_floating_point_v<U>;
+        case arg_kind::string:          return is_string_v<U>;
+        case arg_kind::pointer:         return std::is_pointer_v<U> || std::is_null_pointer_v<U>;
+    }
+    return false;
+}
+
+template <typename Fmt, typename... Args, std::size_t... I>
+constexpr bool accepts_all(std::index_sequence<I...>)
+{
+    return (accepts<Args>(layout_of<Fmt>.kinds[I]) && ...);
+}
+
+/**
+ * @brief Check the arguments of a call site against its format string, at compile time
+ *
+ * @return true if they can be captured
+ */
+template <typename Fmt, typename... Args>
+constexpr bool check()
+{
+    constexpr format_layout layout = layout_of<Fmt>;
+
+    static_assert(layout.valid, "log4embedded: unsupported conversion specification in the format string");
+    static_assert(!layout.valid || layout.count == sizeof...(Args),
+                  "log4embedded: the number of arguments does not match the format string");
+    static_assert(!layout.valid || layout.count != sizeof...(Args) || layout.min_size <= LOG_MAX_CAPTURED_SIZE,
+                  "log4embedded: the arguments do not fit in LOG_MAX_CAPTURED_SIZE bytes");
+
+    if constexpr (layout.valid && layout.count == sizeof...(Args) && layout.min_size <= LOG_MAX_CAPTURED_SIZE)
+    {
+        constexpr bool types = accepts_all<Fmt, Args...>(std::index_sequence_for<Args...>{});
+        static_assert(types, "log4embedded: an argument does not match its conversion specification");
+        return types;
+    }
+    else
+        return false;
+}
+
+template <typename T>
+inline void put_value(std::uint8_t* out, std::size_t& pos, LOG_ARG_TAG tag, T value)
+{
+    out[pos++] = static_cast<std::uint8_t>(tag);
+    std::memcpy(out + pos, &value, sizeof(value));
+    pos += sizeof(value);
+}
+
+inline std::string_view string_of(const char* value)
+{
+    return value ? std::string_view(value) : std::string_view("(null)");
+}
+
+inline std::string_view string_of(std::string_view value)
+{
+    return value;
+}
+
+/**
+ * @brief Append one argument to the capture buffer, as the tagged value its conversion specification takes.
+ *        Strings are cut so that the arguments after them still fit
+ *
+ */
+template <arg_kind Kind, std::size_t Reserved, typename T>
+inline void put_arg(std::uint8_t* out, std::size_t& pos, const T& value)
+{
+    if constexpr (Kind == arg_kind::int32)
+        put_value(out, pos, LOG_ARG_INT32, static_cast<std::int32_t>(value));
+    else if constexpr (Kind == arg_kind::int64)
+        put_value(out, pos, LOG_ARG_INT64, static_cast<std::int64_t>(value));
+    else if constexpr (Kind == arg_kind::floating)
+        put_value(out, pos, LOG_ARG_DOUBLE, static_cast<double>(value));
+    else if constexpr (Kind == arg_kind::long_floating)
+        put_value(out, pos, LOG_ARG_LONG_DOUBLE, static_cast<long double>(value));
+    else if constexpr (Kind == arg_kind::pointer)
+    {
+        if constexpr (std::is_null_pointer_v<T>)
+            put_value(out, pos, LOG_ARG_POINTER, std::uint64_t{0});
+        else
+            put_value(out, pos, LOG_ARG_POINTER, static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(value)));
+    }
+    else
+    {
+        std::string_view str = string_of(value);
+        std::size_t room = LOG_MAX_CAPTURED_SIZE - pos - min_arg_size(arg_kind::string) - Reserved;
+        std::uint16_t length = static_cast<std::uint16_t>(str.size() < room ? str.size() : room);
+
+        put_value(out, pos, LOG_ARG_STRING, length);
+        std::memcpy(out + pos, str.data(), length);
+        pos += length;
+    }
+}
+
+template <typename Fmt, typename... Args, std::size_t... I>
+inline std::size_t capture(std::uint8_t* out, std::index_sequence<I...>, const Args&... args)
+{
+    std::size_t pos = 0;
+    (void)out;
+    (put_arg<layout_of<Fmt>.kinds[I], layout_of<Fmt>.reserved[I]>(out, pos, args), ...);
+    return pos;
+}
+
+// size of the capture buffer of a call site: the exact one, unless there are strings
+template <typename Fmt>
+inline constexpr std::size_t capacity_of = layout_of<Fmt>.has_strings ? LOG_MAX_CAPTURED_SIZE :
+                                           layout_of<Fmt>.min_size > 0 ? layout_of<Fmt>.min_size : 1;
+
+/**
+ * @brief Capture the arguments of a call site and print them. Only meant for the LOG_* macros below
+ *
+ * @param site
+ * @param fmt the format string again, as given to the macro
+ * @param args
+ */
+template <typename Fmt, typename... Args>
+inline void print(const log_call_site_t* site, const char* fmt, const Args&... args)
+{
+    (void)fmt;
+    if constexpr (check<Fmt, Args...>())
+    {
+        std::uint8_t buffer[capacity_of<Fmt>];
+        log_print_captured(site, buffer, capture<Fmt>(buffer, std::index_sequence_for<Args...>{}, args...));
+    }
+}
+
+/**
+ * @brief Same as print, for a module whose level is 'module_level'. Only meant for the LOG_* macros below
+ *
+ */
+template <typename Fmt, typename... Args>
+inline void print_module(const log_call_site_t* site, LOG_MSG_CATEGORY module_level, const char* fmt, const Args&... args)
+{
+    (void)fmt;
+    if constexpr (check<Fmt, Args...>())
+    {
+        std::uint8_t buffer[capacity_of<Fmt>];
+        log_print_module_captured(site, module_level, buffer,
+                                  capture<Fmt>(buffer, std::index_sequence_for<Args...>{}, args...));
+    }
+}
+
+} // namespace detail
+} // namespace log4embedded
+
+
+/***********    Call-site macros    ************/
+
+// format string of a macro call: its first argument
+#define LOG4EMBEDDED_FMT_(fmt, ...)     fmt
+#define LOG4EMBEDDED_FIRST_(...)        LOG4EMBEDDED_FMT_(__VA_ARGS__, 0)
+
+// the format string, as a type the templates of log4embedded::detail can parse at compile time
+#define LOG4EMBEDDED_FMT_TYPE_(...) \
+    struct log4embedded_fmt_ { static constexpr const char* value() { return LOG4EMBEDDED_FIRST_(__VA_ARGS__); } }
+
+// static description of the call site, built by the compiler
+#define LOG4EMBEDDED_SITE_(level) \
+    static constexpr log_call_site_t log4embedded_site_ = {(level), __FILE__, __LINE__, __func__, log4embedded_fmt_::value()}
+
+/**
+ * @brief   Same as the LOG_PRINT_AT macro of log4embedded.h, with the format string checked at compile time and
+ *          the arguments captured by templates.
+ *
+ */
+#undef LOG_PRINT_AT
+#ifdef LOG4EMBEDDED_MODULE
+#define LOG_PRINT_AT(level, ...) \
+    do { \
+        LOG4EMBEDDED_FMT_TYPE_(__VA_ARGS__); \
+        static uint32_t log4embedded_state_site_ = 0; \
+        if ((int)(level) <= (int)(LOG4EMBEDDED_MIN_LEVEL)) \
+        { \
+            uint32_t log4embedded_state_ = log4embedded_module_state(LOG4EMBEDDED_MODULE, &log4embedded_state_site_); \
+            if ((int)(level) <= (int)((log4embedded_state_ >> 4) & 0xf)) \
+            { \
+                LOG4EMBEDDED_SITE_(level); \
+                log4embedded::detail::print_module<log4embedded_fmt_>(&log4embedded_site_, \
+                    (LOG_MSG_CATEGORY)(log4embedded_state_ & 0xf), __VA_ARGS__); \
+            } \
+        } \
+    } while (0)
+#else
+#define LOG_PRINT_AT(level, ...) \
+    do { \
+        LOG4EMBEDDED_FMT_TYPE_(__VA_ARGS__); \
+        if (LOG4EMBEDDED_ENABLED(level)) \
+        { \
+            LOG4EMBEDDED_SITE_(level); \
+            log4embedded::detail::print<log4embedded_fmt_>(&log4embedded_site_, __VA_ARGS__); \
+        } \
+    } while (0)
+#endif
+
+#endif // LOG4EMBEDDED_HPP
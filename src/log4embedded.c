@@ -1,9 +1,21 @@
+// the log_print_* functions are defined here: no inline check wrapping their names, even if enabled project-wide
+#undef LOG4EMBEDDED_INLINE_FILTER
+
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdarg.h>
 #include <time.h>
 #include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 
 #include "log4embedded.h"
+#include "log4embedded_internal.h"
 
 // Define ANSI colors for the serial console
 #define ANSI_COLOR_RED              "\x1b[31m"
@@ -24,232 +36,1749 @@
 
 #define ANSI_COLOR_RESET            "\x1b[0m"
 
-// Define the abbreviation for the message category
-#define CRIT_ABBREV     "[Crit]"
-#define ERR_ABBREV      "[Err]"
-#define WARN_ABBREV     "[Warn]"
-#define INFO_ABBREV     "[Info]"
-#define DBG_ABBREV      "[Debug]"
+// Define the name of the message category, and its abbreviation as printed at the start of every log message
+#define CRIT_NAME       "Crit"
+#define ERR_NAME        "Err"
+#define WARN_NAME       "Warn"
+#define INFO_NAME       "Info"
+#define DBG_NAME        "Debug"
+
+#define CRIT_ABBREV     "[" CRIT_NAME "]"
+#define ERR_ABBREV      "[" ERR_NAME "]"
+#define WARN_ABBREV     "[" WARN_NAME "]"
+#define INFO_ABBREV     "[" INFO_NAME "]"
+#define DBG_ABBREV      "[" DBG_NAME "]"
+
+// Define the maximum number of operations and literal characters of a layout set via log_set_layout
+#define MAX_LAYOUT_OPS  32
+#define MAX_LAYOUT_TEXT 128
 
 // Define maximum path size for a log file
-#define MAX_PATH_SIZE   256
+#define MAX_PATH_SIZE   LOG4EMBEDDED_MAX_PATH_SIZE
+
+// Define maximum size for the label, location and date of a log message
+#define MAX_HEADER_SIZE 512
+
+// Define the default size of the per-thread buffer a log message is rendered into. Longer messages take a slower path
+#ifndef LOG4EMBEDDED_LINE_SIZE
+#define LOG4EMBEDDED_LINE_SIZE  1024
+#endif
+
+// Define the maximum size of a log message rendered by the slow path. Longer messages are truncated
+#ifndef LOG4EMBEDDED_MAX_LINE_SIZE
+#define LOG4EMBEDDED_MAX_LINE_SIZE  16384
+#endif
+
+// Define the minimum size of the per-thread buffer, enough for the label, location and date
+#define MIN_LINE_SIZE   128
+
+// Define maximum size for the date and time of a log message, e.g.: "2023-09-02T10:00:00.000000+02:00"
+#define MAX_TIMESTAMP_SIZE  40
 
 // Define the NULL character
 #define NULL_CHAR  '\0'
 
-// attributes of the log library
+// operations a layout set via log_set_layout is compiled into
+typedef enum {
+    LOG_LAYOUT_TEXT = 0,                // literal text
+    LOG_LAYOUT_TIMESTAMP,               // %t
+    LOG_LAYOUT_LEVEL,                   // %l
+    LOG_LAYOUT_FILE,                    // %f
+    LOG_LAYOUT_LINE,                    // %n
+    LOG_LAYOUT_FUNC                     // %F
+} LOG_LAYOUT_OP;
+
+typedef struct {
+    LOG_LAYOUT_OP op;
+    size_t offset;                      // LOG_LAYOUT_TEXT only: where the literal text starts in 'text'
+    size_t length;
+} log_layout_op_t;
+
+// a compiled layout: everything before %m, the message itself being always last
+typedef struct log_layout {
+    size_t count;
+    log_layout_op_t ops[MAX_LAYOUT_OPS];
+    char text[MAX_LAYOUT_TEXT];
+    struct log_layout* retired;         // next one in the list of retired layouts, released by log_close
+} log_layout_t;
+
+// constant text, along with its length, so that it is copied with no strlen nor printf
 typedef struct {
-    LOG_MSG_CATEGORY log_level;
+    const char* text;
+    size_t length;
+} log_label_t;
+
+#define LOG_LABEL(text)     {text, sizeof(text) - 1}
+
+// attributes of the log library, which are also the configuration of the default sink (LOG_SINK_DEFAULT)
+typedef struct {
+    LOG_MSG_CATEGORY log_level;         // level of the log output, read atomically on every print call
     char log_file_name[MAX_PATH_SIZE];
     size_t log_file_size;
-    bool log_colors_enabled;
+    bool log_colors_enabled;            // read atomically on every print call
+    int log_fd;                         // log file descriptor, kept open from log_set_file* until log_close. -1 for stdout
+    char* log_buffer;                   // user-sized write buffer for the log output
+    size_t log_buffer_size;
+    size_t log_buffer_used;
+    LOG_FLUSH_POLICY flush_policy;
+    size_t flush_size_threshold;
+    unsigned int flush_time_threshold_ms;
+    size_t bytes_since_flush;
+    struct timespec last_flush;
+    pthread_mutex_t lock;               // serializes the log output: file, write buffer and flush counters
+    size_t line_buffer_size;            // size of the per-thread buffers log messages are rendered into
+    int timestamp_setting;              // LOG_TIMESTAMP_FORMAT | (LOG_TIMESTAMP_PRECISION << 8), read atomically
+    size_t rotation_max_size;           // 0 if the log file is not rotated by size
+    unsigned int rotation_max_files;
+    LOG_ROTATION_INTERVAL rotation_interval;
+    LOG_COMPRESSION rotation_compression;
+    size_t file_bytes;                  // bytes written into the log file so far, buffered ones included
+    time_t next_rollover;               // when the log file is rotated on a time basis, 0 if never
+    unsigned long rotation_count;       // gives every rotated log file a unique name until the rotation thread takes it
+    log_layout_t* layout;               // NULL for the default layout. Swapped atomically
+    log_layout_t* retired_layouts;      // previous layouts, which print calls may still be using
 } log_attributes_t;
 
-// setup the initial value of log level, LOG_MSG_INFO by default. No log file, stdout logs, colors enabled.
-static log_attributes_t log_atts = {.log_level = LOG_MSG_INFO, 
+// per-thread cache of the last rendered date and time, so that it is only rendered again when the second changes
+typedef struct {
+    time_t second;
+    LOG_TIMESTAMP_FORMAT format;
+    size_t length;
+    char text[MAX_TIMESTAMP_SIZE];      // date and time, up to the seconds
+    size_t suffix_length;
+    char suffix[8];                     // ISO-8601 time zone designator, if any
+} log_timestamp_cache_t;
+
+// per-thread buffer a log message is rendered into, allocated on the first print call of every thread
+typedef struct {
+    char* buffer;
+    size_t size;
+} log_line_buffer_t;
+
+// most verbose level print calls must go through: the most verbose of the log level and the levels of the other sinks,
+// or LOG_MSG_DBG while the flight recorder runs.
+// Exported for the inline level check of the LOG_* macros, read atomically
+LOG_MSG_CATEGORY log4embedded_level = LOG_MSG_INFO;
+
+// setup the initial value of the attributes. No log file, stdout logs, colors enabled.
+static log_attributes_t log_atts = {.log_level = LOG_MSG_INFO,
                                     .log_file_name[0] = NULL_CHAR, 
                                     .log_file_size = 0,
-                                    .log_colors_enabled = true};
+                                    .log_colors_enabled = true,
+                                    .log_fd = -1,
+                                    .log_buffer = NULL,
+                                    .log_buffer_size = BUFSIZ,
+                                    .log_buffer_used = 0,
+                                    .flush_policy = LOG_FLUSH_EVERY_LINE,
+                                    .flush_size_threshold = 0,
+                                    .flush_time_threshold_ms = 0,
+                                    .bytes_since_flush = 0,
+                                    .lock = PTHREAD_MUTEX_INITIALIZER,
+                                    .line_buffer_size = LOG4EMBEDDED_LINE_SIZE,
+                                    .timestamp_setting = LOG_TIMESTAMP_LOCAL | (LOG_TIMESTAMP_SEC << 8),
+                                    .rotation_max_size = 0,
+                                    .rotation_max_files = 0,
+                                    .rotation_interval = LOG_ROTATE_NEVER,
+                                    .rotation_compression = LOG_COMPRESS_NONE,
+                                    .file_bytes = 0,
+                                    .next_rollover = 0,
+                                    .rotation_count = 0,
+                                    .layout = NULL,
+                                    .retired_layouts = NULL};
+
+// label of every LOG_MSG_CATEGORY in the default layout, along with the space which follows it
+static const log_label_t level_labels[] = {[LOG_MSG_NONE] = LOG_LABEL(""),
+                                           [LOG_MSG_CRIT] = LOG_LABEL(CRIT_ABBREV " "),
+                                           [LOG_MSG_ERR] = LOG_LABEL(ERR_ABBREV " "),
+                                           [LOG_MSG_WARN] = LOG_LABEL(WARN_ABBREV " "),
+                                           [LOG_MSG_INFO] = LOG_LABEL(INFO_ABBREV " "),
+                                           [LOG_MSG_DBG] = LOG_LABEL(DBG_ABBREV " ")};
+
+// name of every LOG_MSG_CATEGORY, as written by the %l of a layout
+static const log_label_t level_names[] = {[LOG_MSG_NONE] = LOG_LABEL(""),
+                                          [LOG_MSG_CRIT] = LOG_LABEL(CRIT_NAME),
+                                          [LOG_MSG_ERR] = LOG_LABEL(ERR_NAME),
+                                          [LOG_MSG_WARN] = LOG_LABEL(WARN_NAME),
+                                          [LOG_MSG_INFO] = LOG_LABEL(INFO_NAME),
+                                          [LOG_MSG_DBG] = LOG_LABEL(DBG_NAME)};
+
+static __thread log_timestamp_cache_t timestamp_cache = {.second = -1};
+
+static __thread log_line_buffer_t line_buffer = {.buffer = NULL, .size = 0};
+static pthread_key_t line_buffer_key;
+static pthread_once_t line_buffer_once = PTHREAD_ONCE_INIT;
+
+
+/**
+ * @brief Whether log messages are written into a log file, rather than the stdout
+ * 
+ * @return true 
+ */
+static bool log_to_file()
+{
+    return __atomic_load_n(&log_atts.log_fd, __ATOMIC_RELAXED) >= 0 || log_internal_mmap_enabled();
+}
+
+/**
+ * @brief Whether print calls of this category must go through: to the log output, to the flight recorder, or both
+ * 
+ * @param category 
+ * @return true 
+ */
+static bool level_enabled(LOG_MSG_CATEGORY category)
+{
+    if ((int)category <= (int)__atomic_load_n(&log4embedded_level, __ATOMIC_RELAXED))
+        return true;
+
+    log_internal_stats_add(LOG_STAT_FILTERED, 1);
+    return false;
+}
+
+/**
+ * @brief Most verbose category written to the log output, as set by log_set_level
+ * 
+ * @return LOG_MSG_CATEGORY 
+ */
+static LOG_MSG_CATEGORY output_level()
+{
+    return __atomic_load_n(&log_atts.log_level, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Whether colors are enabled for the log messages
+ * 
+ * @return true 
+ */
+static bool colors_enabled()
+{
+    return __atomic_load_n(&log_atts.log_colors_enabled, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Release the per-thread buffer when its thread exits
+ * 
+ * @param buffer 
+ */
+static void free_line_buffer(void* buffer)
+{
+    free(buffer);
+}
 
+/**
+ * @brief Create the key whose destructor releases the per-thread buffers
+ * 
+ */
+static void create_line_buffer_key()
+{
+    pthread_key_create(&line_buffer_key, free_line_buffer);
+}
 
 /**
- * @brief Get the Local Date and Time in a fixed string format "YYYY-MM-DD - hh:mm:ss"
+ * @brief Get the buffer of the calling thread, allocating it on its first print call, or if the size
+ *        selected with log_set_line_buffer_size changed since then.
  * 
- * @param time_string 
- * @return size_t 
+ * @return log_line_buffer_t* NULL if it cannot be allocated
  */
-static size_t get_local_date_and_time(char* time_string)
+static log_line_buffer_t* get_line_buffer()
 {
-    size_t ret = -1;
+    size_t size = __atomic_load_n(&log_atts.line_buffer_size, __ATOMIC_RELAXED);
 
-    if (time_string) 
+    if (__builtin_expect(line_buffer.size != size, 0))
     {
-        time_t     now;
-        struct tm *tm;
+        pthread_once(&line_buffer_once, create_line_buffer_key);
 
-        /* get local time */
-        now = time(NULL);
+        char* buffer = realloc(line_buffer.buffer, size);
+        if (!buffer)
+            return NULL;
 
-        /* format local time */
-        tm = localtime(&now);
-        ret = sprintf(time_string,"%04d/%02d/%02d - %02d:%02d:%02d", tm->tm_year+1900, tm->tm_mon+1, 
-                tm->tm_mday, tm->tm_hour, tm->tm_min, tm->tm_sec);
+        line_buffer.buffer = buffer;
+        line_buffer.size = size;
+        pthread_setspecific(line_buffer_key, buffer);
     }
 
-    return ret;
+    return &line_buffer;
 }
 
 /**
- * @brief This is the actual printf wrapper. Depending on LOG_MSG_CATEGORY, it will print
- *        a different message format (labels, colors...) along with the current date and time.
+ * @brief Write the whole 'buffer' into 'fd', retrying on partial writes and signal interruptions
  * 
- * @param category 
- * @param fmt 
- * @param args 
+ * @param fd 
+ * @param buffer 
+ * @param length 
  */
-static void print_internal_va(LOG_MSG_CATEGORY category, const char* fmt, va_list args)
+static void write_all(int fd, const char* buffer, size_t length)
 {
-    FILE* log_file;
-    bool log_file_flg = false;
-
-    // Check if logs shall be written into a log file
-    if (log_atts.log_file_name[0] != NULL_CHAR && log_atts.log_file_size > 0)
+    while (length > 0)
     {
-        log_file = fopen(log_atts.log_file_name, "a");
-        if (!log_file)
+        ssize_t ret = write(fd, buffer, length);
+        if (ret < 0)
         {
-            // error at opening/creating the log file. Log messages will be redirected to stdout
-            log_enable_colors();
-            log_atts.log_file_name[0] = NULL_CHAR;
-            log_atts.log_file_size = 0;
-
-            // get local time and date for this log message
-            char time[80];
-            get_local_date_and_time(time);
-            printf("%s[%s] [%s] Log file cannot be opened. Printing logs to the stdout... %s\n", ANSI_COLOR_BRIGHT_YELLOW, WARN_ABBREV, time, ANSI_COLOR_RESET);
-        }     
-        else
-            log_file_flg = true;
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+
+        buffer += ret;
+        length -= (size_t)ret;
+    }
+}
+
+/**
+ * @brief Write the pieces of a log message into 'fd' with a single writev() call, finishing partial writes
+ *        piece by piece
+ * 
+ * @param fd 
+ * @param parts 
+ * @param count 
+ */
+static void write_parts(int fd, const struct iovec* parts, int count)
+{
+    ssize_t ret;
+
+    do
+        ret = writev(fd, parts, count);
+    while (ret < 0 && errno == EINTR);
+
+    if (ret < 0)
+        return;
+
+    for (int i = 0; i < count; ++i)
+    {
+        size_t done = (size_t)ret < parts[i].iov_len ? (size_t)ret : parts[i].iov_len;
+        write_all(fd, (const char*)parts[i].iov_base + done, parts[i].iov_len - done);
+        ret -= (ssize_t)done;
+    }
+}
+
+/**
+ * @brief Write 'value' as 'digits' decimal digits, zero padded
+ * 
+ * @param out 
+ * @param value 
+ * @param digits 
+ * @return char* right after the last digit
+ */
+static char* put_digits(char* out, unsigned long value, int digits)
+{
+    for (int i = digits - 1; i >= 0; i--)
+    {
+        out[i] = (char)('0' + value % 10);
+        value /= 10;
+    }
+
+    return out + digits;
+}
+
+/**
+ * @brief Render the date and time of 'second' (up to the seconds) into the cache of the calling thread,
+ *        in the given LOG_TIMESTAMP_FORMAT.
+ * 
+ * @param cache 
+ * @param second 
+ * @param format 
+ */
+static void render_timestamp_cache(log_timestamp_cache_t* cache, time_t second, LOG_TIMESTAMP_FORMAT format)
+{
+    struct tm tm;
+    bool utc = (format == LOG_TIMESTAMP_UTC || format == LOG_TIMESTAMP_ISO8601_UTC);
+    bool iso = (format == LOG_TIMESTAMP_ISO8601_LOCAL || format == LOG_TIMESTAMP_ISO8601_UTC);
+    char* p = cache->text;
+
+    // localtime_r/gmtime_r are thread safe, and only called once per second and thread
+    if (utc)
+        gmtime_r(&second, &tm);
+    else
+        localtime_r(&second, &tm);
+
+    // "YYYY/MM/DD - hh:mm:ss" or ISO-8601 "YYYY-MM-DDThh:mm:ss"
+    p = put_digits(p, (unsigned long)(tm.tm_year + 1900), 4);
+    *p++ = iso ? '-' : '/';
+    p = put_digits(p, (unsigned long)(tm.tm_mon + 1), 2);
+    *p++ = iso ? '-' : '/';
+    p = put_digits(p, (unsigned long)tm.tm_mday, 2);
+    if (iso)
+        *p++ = 'T';
+    else
+    {
+        memcpy(p, " - ", 3);
+        p += 3;
+    }
+    p = put_digits(p, (unsigned long)tm.tm_hour, 2);
+    *p++ = ':';
+    p = put_digits(p, (unsigned long)tm.tm_min, 2);
+    *p++ = ':';
+    p = put_digits(p, (unsigned long)tm.tm_sec, 2);
+    cache->length = (size_t)(p - cache->text);
+
+    // ISO-8601 time zone designator, written after the fraction of a second
+    p = cache->suffix;
+    if (iso && utc)
+        *p++ = 'Z';
+    else if (iso)
+    {
+        long offset = tm.tm_gmtoff / 60;
+        *p++ = offset < 0 ? '-' : '+';
+        offset = offset < 0 ? -offset : offset;
+        p = put_digits(p, (unsigned long)(offset / 60), 2);
+        *p++ = ':';
+        p = put_digits(p, (unsigned long)(offset % 60), 2);
+    }
+    cache->suffix_length = (size_t)(p - cache->suffix);
+
+    cache->second = second;
+    cache->format = format;
+}
+
+/**
+ * @brief Render 'timestamp' into 'out', according to the timestamp format and precision in use.
+ *        The date and time are only rendered again when the second changes: otherwise, the cached ones are copied.
+ * 
+ * @param out at least MAX_TIMESTAMP_SIZE bytes
+ * @param timestamp 
+ * @return size_t length of the rendered timestamp, without the NULL character
+ */
+static size_t format_timestamp(char* out, const struct timespec* timestamp)
+{
+    int setting = __atomic_load_n(&log_atts.timestamp_setting, __ATOMIC_RELAXED);
+    LOG_TIMESTAMP_FORMAT format = (LOG_TIMESTAMP_FORMAT)(setting & 0xff);
+    LOG_TIMESTAMP_PRECISION precision = (LOG_TIMESTAMP_PRECISION)(setting >> 8);
+    char* p = out;
+
+    if (__builtin_expect(timestamp_cache.second != timestamp->tv_sec || timestamp_cache.format != format, 0))
+        render_timestamp_cache(&timestamp_cache, timestamp->tv_sec, format);
+
+    memcpy(p, timestamp_cache.text, timestamp_cache.length);
+    p += timestamp_cache.length;
+
+    if (precision == LOG_TIMESTAMP_MSEC)
+    {
+        *p++ = '.';
+        p = put_digits(p, (unsigned long)timestamp->tv_nsec / 1000000UL, 3);
+    }
+    else if (precision == LOG_TIMESTAMP_USEC)
+    {
+        *p++ = '.';
+        p = put_digits(p, (unsigned long)timestamp->tv_nsec / 1000UL, 6);
+    }
+
+    memcpy(p, timestamp_cache.suffix, timestamp_cache.suffix_length);
+    p += timestamp_cache.suffix_length;
+    *p = NULL_CHAR;
+
+    return (size_t)(p - out);
+}
+
+void log_internal_now(struct timespec* timestamp)
+{
+    // coarse clocks are read from the vDSO with no syscall, and are precise enough unless microseconds are wanted
+#ifdef CLOCK_REALTIME_COARSE
+    if ((__atomic_load_n(&log_atts.timestamp_setting, __ATOMIC_RELAXED) >> 8) != LOG_TIMESTAMP_USEC)
+    {
+        clock_gettime(CLOCK_REALTIME_COARSE, timestamp);
+        return;
     }
+#endif
+    clock_gettime(CLOCK_REALTIME, timestamp);
+}
 
-    // Print the log message either in a log file or in the stdout, depending on log_file_flg. Also check colors enabled or not
+/**
+ * @brief Color of the log messages of a category on the console
+ * 
+ * @param category 
+ * @return const char* 
+ */
+static const char* console_color(LOG_MSG_CATEGORY category)
+{
     switch(category)
     {
         case LOG_MSG_CRIT:
-            if (log_atts.log_colors_enabled) {
-                log_file_flg ? fprintf(log_file,"%s[%s] [%s:%d] ", ANSI_COLOR_RED, CRIT_ABBREV, __FILE__, __LINE__) : 
-                printf("%s[%s] [%s:%d] ", ANSI_COLOR_RED, CRIT_ABBREV, __FILE__, __LINE__);
-            } else {
-                log_file_flg ? fprintf(log_file,"[%s] [%s:%d] ", CRIT_ABBREV, __FILE__, __LINE__) : 
-                printf("[%s] [%s:%d] ", CRIT_ABBREV, __FILE__, __LINE__);
-            }
-        break;
+            return ANSI_COLOR_RED;
 
         case LOG_MSG_ERR:
-            if (log_atts.log_colors_enabled) {
-                log_file_flg ? fprintf(log_file, "%s[%s] [%s:%d] ", ANSI_COLOR_BRIGHT_RED, ERR_ABBREV, __FILE__, __LINE__) :
-                printf("%s[%s] [%s:%d] ", ANSI_COLOR_BRIGHT_RED, ERR_ABBREV, __FILE__, __LINE__);
-            } else {
-                log_file_flg ? fprintf(log_file, "[%s] [%s:%d] ", ERR_ABBREV, __FILE__, __LINE__) :
-                printf("[%s] [%s:%d] ", ERR_ABBREV, __FILE__, __LINE__);
-            }
-        break;
+            return ANSI_COLOR_BRIGHT_RED;
 
         case LOG_MSG_WARN:
-            if (log_atts.log_colors_enabled) {
-                log_file_flg ? fprintf(log_file, "%s[%s] ", ANSI_COLOR_BRIGHT_YELLOW, WARN_ABBREV) :
-                printf("%s[%s] ", ANSI_COLOR_BRIGHT_YELLOW, WARN_ABBREV);
-            } else {
-                log_file_flg ? fprintf(log_file, "[%s] ", WARN_ABBREV) :
-                printf("[%s] ", WARN_ABBREV);
-            }
-        break;
+            return ANSI_COLOR_BRIGHT_YELLOW;
 
         case LOG_MSG_INFO:
-            if (log_atts.log_colors_enabled) {
-                log_file_flg ? fprintf(log_file, "%s[%s] ", ANSI_COLOR_BRIGHT_GREEN, INFO_ABBREV) :
-                printf("%s[%s] ", ANSI_COLOR_BRIGHT_GREEN, INFO_ABBREV);
-            } else {
-                log_file_flg ? fprintf(log_file, "[%s] ", INFO_ABBREV) :
-                printf("[%s] ", INFO_ABBREV);
-            }
-        break;
+            return ANSI_COLOR_BRIGHT_GREEN;
 
         case LOG_MSG_DBG:
         default:
-            if (log_atts.log_colors_enabled) {
-                log_file_flg ? fprintf(log_file, "%s[%s] [%s:%d] ", ANSI_COLOR_RESET, DBG_ABBREV, __FILE__, __LINE__) :
-                printf("%s[%s] [%s:%d] ", ANSI_COLOR_BRIGHT_WHITE, DBG_ABBREV, __FILE__, __LINE__);
-            } else {
-                log_file_flg ? fprintf(log_file, "[%s] [%s:%d] ", DBG_ABBREV, __FILE__, __LINE__) :
-                printf("[%s] [%s:%d] ", DBG_ABBREV, __FILE__, __LINE__);
-            }
-        break;
+            return ANSI_COLOR_BRIGHT_WHITE;
     }
+}
+
+/**
+ * @brief Leading escape sequence of a log message written to the log output, if colors are enabled
+ * 
+ * @param category 
+ * @return const char* 
+ */
+static const char* category_color(LOG_MSG_CATEGORY category)
+{
+    // debug messages keep the default color of colored log files
+    if (category == LOG_MSG_DBG && log_to_file())
+        return ANSI_COLOR_RESET;
 
-    // get local time and date
-    char time[80];
-    get_local_date_and_time(time);
+    return console_color(category);
+}
 
-    if (log_file_flg)
-    {
-        fprintf(log_file, "[%s] ", time);
-        vfprintf(log_file, fmt, args); 
-        if (log_atts.log_colors_enabled)
-            fprintf(log_file ,"%s", ANSI_COLOR_RESET);
-        fclose(log_file);
-    }
-    else
+/**
+ * @brief Trailing escape sequence of a log message written to the log output, if colors are in use
+ * 
+ * @return const char* 
+ */
+static const char* format_trailer()
+{
+    return (colors_enabled() || !log_to_file()) ? ANSI_COLOR_RESET : "";
+}
+
+/**
+ * @brief Milliseconds elapsed since the last flush of the log output
+ * 
+ * @return unsigned long 
+ */
+static unsigned long ms_since_last_flush()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - log_atts.last_flush.tv_sec) * 1000UL + 
+           (now.tv_nsec - log_atts.last_flush.tv_nsec) / 1000000L;
+}
+
+/**
+ * @brief Write the content of the write buffer to the log output and reset the flush threshold counters.
+ *        'log_atts.lock' must be held.
+ * 
+ */
+static void flush_output()
+{
+    // log messages gathered by the writer thread go first
+    log_internal_batch_flush();
+
+    if (log_atts.log_buffer_used > 0)
     {
-        printf("[%s] ", time);
-        vprintf(fmt, args);    
-        printf("%s", ANSI_COLOR_RESET);
+        log_internal_stats_add(LOG_STAT_FLUSHES, 1);
+        write_all(log_atts.log_fd >= 0 ? log_atts.log_fd : STDOUT_FILENO, log_atts.log_buffer, log_atts.log_buffer_used);
+        log_atts.log_buffer_used = 0;
     }
 
-    va_end(args);
-    return;
+    log_atts.bytes_since_flush = 0;
+    clock_gettime(CLOCK_MONOTONIC, &log_atts.last_flush);
 }
 
-
-// Functions about library attributes
-void log_set_level(LOG_MSG_CATEGORY log_level)
+/**
+ * @brief Apply the selected LOG_FLUSH_POLICY once a log message has been written. 'log_atts.lock' must be held.
+ * 
+ * @param category 
+ * @param written bytes written for the last log message
+ */
+static void apply_flush_policy(LOG_MSG_CATEGORY category, size_t written)
 {
-    if (log_level >= LOG_MSG_NONE && log_level <= LOG_MSG_DBG)
-        log_atts.log_level = log_level;
+    log_atts.bytes_since_flush += written;
+
+    switch(log_atts.flush_policy)
+    {
+        case LOG_FLUSH_ON_ERROR:
+            if (category == LOG_MSG_CRIT || category == LOG_MSG_ERR)
+                flush_output();
+        break;
+
+        case LOG_FLUSH_ON_THRESHOLD:
+            if ((log_atts.flush_size_threshold > 0 && log_atts.bytes_since_flush >= log_atts.flush_size_threshold) ||
+                (log_atts.flush_time_threshold_ms > 0 && ms_since_last_flush() >= log_atts.flush_time_threshold_ms))
+                flush_output();
+        break;
+
+        case LOG_FLUSH_EVERY_LINE:
+        default:
+            flush_output();
+        break;
+    }
 }
 
-LOG_MSG_CATEGORY log_get_level()
+/**
+ * @brief When the log file must be rotated next on a time basis, according to LOG_ROTATION_INTERVAL
+ * 
+ * @param interval 
+ * @return time_t next local midnight for LOG_ROTATE_DAILY, 0 for LOG_ROTATE_NEVER
+ */
+static time_t next_rollover(LOG_ROTATION_INTERVAL interval)
 {
-    return log_atts.log_level;
+    time_t now = time(NULL);
+    struct tm midnight;
+
+    if (interval != LOG_ROTATE_DAILY || !localtime_r(&now, &midnight))
+        return 0;
+
+    midnight.tm_mday += 1;
+    midnight.tm_hour = 0;
+    midnight.tm_min = 0;
+    midnight.tm_sec = 0;
+    midnight.tm_isdst = -1;
+    return mktime(&midnight);
 }
 
-void log_set_file(const char* filepath, size_t filepath_size)
+/**
+ * @brief Open the log file set in log_atts. On failure, log messages are redirected to stdout.
+ *        'log_atts.lock' must be held.
+ * 
+ * @return true if the log file is ready to be written
+ */
+static bool open_log_file()
 {
-    // Checks if the file name is valid and if the file exists in the filesystem
-    if (filepath && filepath_size <= MAX_PATH_SIZE)
+    int fd = open(log_atts.log_file_name, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0)
     {
+        // error at opening/creating the log file. Log messages will be redirected to stdout
+        log_enable_colors();
         log_atts.log_file_name[0] = NULL_CHAR;
-        snprintf(log_atts.log_file_name, filepath_size, "%s", filepath);
-        log_atts.log_file_size = filepath_size;
-        log_disable_colors();  
+        log_atts.log_file_size = 0;
+
+        // get local time and date for this log message
+        struct timespec timestamp;
+        char time[MAX_TIMESTAMP_SIZE];
+        char warning[MAX_HEADER_SIZE];
+        log_internal_now(&timestamp);
+        format_timestamp(time, &timestamp);
+        int len = snprintf(warning, sizeof(warning), "%s%s [%s] Log file cannot be opened. Printing logs to the stdout... %s\n", 
+                           ANSI_COLOR_BRIGHT_YELLOW, WARN_ABBREV, time, ANSI_COLOR_RESET);
+        if (len > 0)
+            write_all(STDOUT_FILENO, warning, (size_t)len < sizeof(warning) ? (size_t)len : sizeof(warning) - 1);
+        return false;
     }
-    else
-        log_print_warning("Given log file name is not valid. Logs shall be printed to the stdout.\n");
+
+    // the size of the log file is only taken here, print calls just add up what they write
+    struct stat file_stat;
+    log_atts.file_bytes = (fstat(fd, &file_stat) == 0) ? (size_t)file_stat.st_size : 0;
+    log_atts.next_rollover = next_rollover(log_atts.rotation_interval);
+
+    __atomic_store_n(&log_atts.log_fd, fd, __ATOMIC_RELAXED);
+    log_atts.bytes_since_flush = 0;
+    clock_gettime(CLOCK_MONOTONIC, &log_atts.last_flush);
+    return true;
 }
 
-void log_set_file_with_color_text(const char* filepath, size_t filepath_size)
+/**
+ * @brief Flush and close the log file in use, if any. 'log_atts.lock' must be held.
+ * 
+ */
+static void close_log_file()
 {
-    // Checks if the file name is valid and if the file exists in the filesystem
-    if (filepath && filepath_size <= MAX_PATH_SIZE)
+    flush_output();
+
+    if (log_atts.log_fd >= 0)
     {
-        log_atts.log_file_name[0] = NULL_CHAR;
-        snprintf(log_atts.log_file_name, filepath_size, "%s", filepath);
-        log_atts.log_file_size = filepath_size;
-        log_enable_colors();
+        close(log_atts.log_fd);
+        __atomic_store_n(&log_atts.log_fd, -1, __ATOMIC_RELAXED);
     }
-    else
-        log_print_warning("Given log file name is not valid. Logs shall be printed to the stdout.\n");
 }
 
-void log_enable_colors()
+/**
+ * @brief Whether the log file must be rotated before writing 'length' more bytes into it: a counter comparison,
+ *        plus a look at the clock only if it is rotated on a time basis. 'log_atts.lock' must be held.
+ * 
+ * @param length 
+ * @return true 
+ * @return false 
+ */
+static bool rotation_due(size_t length)
 {
-    log_atts.log_colors_enabled = true;
+    if (log_atts.rotation_max_size > 0 && log_atts.file_bytes > 0 && 
+        log_atts.file_bytes + length > log_atts.rotation_max_size)
+        return true;
+
+    return log_atts.next_rollover > 0 && time(NULL) >= log_atts.next_rollover;
 }
 
-void log_disable_colors()
+/**
+ * @brief Close the log file, rename it so that it is out of the way, and start a new one. The rotation thread
+ *        takes care of the rotated log file afterwards. 'log_atts.lock' must be held.
+ * 
+ */
+static void rotate_log_file()
 {
-    log_atts.log_colors_enabled = false;
-    printf("%s", ANSI_COLOR_RESET);
+    char segment_name[MAX_PATH_SIZE + 32];
+
+    close_log_file();
+
+    snprintf(segment_name, sizeof(segment_name), "%s.%lu.rotating", log_atts.log_file_name, log_atts.rotation_count++);
+    if (rename(log_atts.log_file_name, segment_name) == 0)
+        log_internal_rotate_submit(log_atts.log_file_name, segment_name, log_atts.rotation_max_files, log_atts.rotation_compression);
+
+    // on failure, keep appending to the same log file until the next rotation is due
+    open_log_file();
 }
 
-// print function definitions
+/**
+ * @brief Append a whole log message, wrapped in the colors of its category, to the write buffer, so that it reaches
+ *        the log output with a single write() call and never interleaves with other threads' messages.
+ *        'log_atts.lock' must be held.
+ * 
+ * @param category 
+ * @param line rendered with no colors
+ * @param length 
+ * @param plain written as is, with no colors nor trailer: for structured log messages
+ */
+static void write_line(LOG_MSG_CATEGORY category, const char* line, size_t length, bool plain)
+{
+    const char* color = !plain && colors_enabled() ? category_color(category) : "";
+    const char* trailer = plain ? "" : format_trailer();
+    struct iovec parts[3] = {{.iov_base = (void*)color, .iov_len = strlen(color)},
+                             {.iov_base = (void*)line, .iov_len = length},
+                             {.iov_base = (void*)trailer, .iov_len = strlen(trailer)}};
+    size_t total = parts[0].iov_len + length + parts[2].iov_len;
+
+    if (log_atts.log_fd >= 0)
+    {
+        if (rotation_due(total))
+            rotate_log_file();
+        log_atts.file_bytes += total;
+    }
+
+    // the writer thread gathers the log messages of a burst, and submits them at once, with no flush policy: the
+    // batch is flushed at the end of the burst. Whatever is still in the write buffer was written earlier: it goes first
+    if (log_internal_batch_gathering())
+    {
+        if (log_atts.log_buffer_used > 0)
+            flush_output();
+        if (log_internal_batch_add(log_atts.log_fd >= 0 ? log_atts.log_fd : STDOUT_FILENO, color, line, length, trailer))
+            return;
+    }
+
+    // anything gathered or still in flight is written first, to keep log messages in order
+    log_internal_batch_flush();
+
+    if (!log_atts.log_buffer && log_atts.log_buffer_size > 0)
+        log_atts.log_buffer = malloc(log_atts.log_buffer_size);
+
+    if (!log_atts.log_buffer || log_atts.log_buffer_used + total > log_atts.log_buffer_size)
+    {
+        flush_output();
+
+        // lines longer than the write buffer go straight to the log output
+        if (!log_atts.log_buffer || total > log_atts.log_buffer_size)
+        {
+            write_parts(log_atts.log_fd >= 0 ? log_atts.log_fd : STDOUT_FILENO, parts, 3);
+            apply_flush_policy(category, 0);
+            return;
+        }
+    }
+
+    for (int i = 0; i < 3; ++i)
+    {
+        memcpy(log_atts.log_buffer + log_atts.log_buffer_used, parts[i].iov_base, parts[i].iov_len);
+        log_atts.log_buffer_used += parts[i].iov_len;
+    }
+    apply_flush_policy(category, total);
+}
+
+/**
+ * @brief Set a new log file, closing the previous one. Colors are enabled or disabled according to 'colors'
+ * 
+ * @param filepath 
+ * @param filepath_size 
+ * @param colors 
+ */
+static void set_log_file(const char* filepath, size_t filepath_size, bool colors)
+{
+    // log messages already buffered for the previous log output are written there
+    log_internal_async_drain();
+    log_internal_mmap_close();
+    log_internal_binary_close();
+
+    pthread_mutex_lock(&log_atts.lock);
+    close_log_file();
+    log_atts.log_file_name[0] = NULL_CHAR;
+    snprintf(log_atts.log_file_name, filepath_size, "%s", filepath);
+    log_atts.log_file_size = filepath_size;
+    if (colors)
+        log_enable_colors();
+    else
+        log_disable_colors();
+    open_log_file();
+    pthread_mutex_unlock(&log_atts.lock);
+}
+
+/**
+ * @brief Append 'length' bytes to 'out', as far as they fit in 'size' bytes. 'len' keeps counting past the end,
+ *        as snprintf does, so that the caller knows how big the buffer should have been
+ * 
+ * @param out 
+ * @param size 
+ * @param len 
+ * @param text 
+ * @param length 
+ */
+static void append(char* out, size_t size, size_t* len, const char* text, size_t length)
+{
+    if (*len < size)
+        memcpy(out + *len, text, length < size - *len ? length : size - *len);
+    *len += length;
+}
+
+/**
+ * @brief Append a decimal number to 'out', as 'append' does
+ * 
+ * @param out 
+ * @param size 
+ * @param len 
+ * @param value 
+ */
+static void append_number(char* out, size_t size, size_t* len, unsigned long value)
+{
+    char digits[20];
+    char* p = digits + sizeof(digits);
+
+    do
+    {
+        *--p = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+
+    append(out, size, len, p, (size_t)(digits + sizeof(digits) - p));
+}
+
+/**
+ * @brief Append the date of a log message to 'out', as 'append' does
+ * 
+ * @param out 
+ * @param size 
+ * @param len 
+ * @param timestamp 
+ */
+static void append_timestamp(char* out, size_t size, size_t* len, const struct timespec* timestamp)
+{
+    char time[MAX_TIMESTAMP_SIZE];
+    size_t time_len = format_timestamp(time, timestamp);
+
+    append(out, size, len, time, time_len);
+}
+
+/**
+ * @brief Render the header of a log message as set by log_set_layout: the compiled operations are run one after
+ *        the other, and literal text is copied as it is. Unknown source locations are written as "?"
+ * 
+ * @param layout 
+ * @param header 
+ * @param header_size 
+ * @param category 
+ * @param location where the print call was made, or NULL
+ * @param timestamp when the log message was generated
+ * @return size_t length of the rendered header, as snprintf
+ */
+static size_t format_layout(const log_layout_t* layout, char* header, size_t header_size, LOG_MSG_CATEGORY category,
+                            const log_location_t* location, const struct timespec* timestamp)
+{
+    bool known = location && location->file;
+    size_t len = 0;
+
+    for (size_t i = 0; i < layout->count; ++i)
+    {
+        const log_layout_op_t* op = &layout->ops[i];
+
+        switch (op->op)
+        {
+            case LOG_LAYOUT_TEXT:
+                append(header, header_size, &len, layout->text + op->offset, op->length);
+            break;
+
+            case LOG_LAYOUT_TIMESTAMP:
+                append_timestamp(header, header_size, &len, timestamp);
+            break;
+
+            case LOG_LAYOUT_LEVEL:
+                append(header, header_size, &len, level_names[category].text, level_names[category].length);
+            break;
+
+            case LOG_LAYOUT_FILE:
+                if (known)
+                    append(header, header_size, &len, location->file, strlen(location->file));
+                else
+                    append(header, header_size, &len, "?", 1);
+            break;
+
+            case LOG_LAYOUT_LINE:
+                if (known)
+                    append_number(header, header_size, &len, (unsigned long)location->line);
+                else
+                    append(header, header_size, &len, "?", 1);
+            break;
+
+            case LOG_LAYOUT_FUNC:
+            default:
+                if (known && location->func)
+                    append(header, header_size, &len, location->func, strlen(location->func));
+                else
+                    append(header, header_size, &len, "?", 1);
+            break;
+        }
+    }
+
+    return len;
+}
+
+/**
+ * @brief Render the label, source location and date of a log message into 'header', with no colors: every sink
+ *        adds its own. Depending on LOG_MSG_CATEGORY, a different label is used.
+ *        The source location is only printed for critical, error and debug messages, if known.
+ *        Labels are constant, and everything is copied with no printf, unless a layout was set via log_set_layout.
+ * 
+ * @param header 
+ * @param header_size 
+ * @param category 
+ * @param location where the print call was made, or NULL
+ * @param timestamp when the log message was generated
+ * @return size_t length of the rendered header, as snprintf
+ */
+static size_t format_header(char* header, size_t header_size, LOG_MSG_CATEGORY category, const log_location_t* location,
+                            const struct timespec* timestamp)
+{
+    const log_layout_t* layout = __atomic_load_n(&log_atts.layout, __ATOMIC_ACQUIRE);
+    size_t len = 0;
+
+    if (layout)
+        return format_layout(layout, header, header_size, category, location, timestamp);
+
+    append(header, header_size, &len, level_labels[category].text, level_labels[category].length);
+
+    if (category != LOG_MSG_WARN && category != LOG_MSG_INFO && location && location->file)
+    {
+        append(header, header_size, &len, "[", 1);
+        append(header, header_size, &len, location->file, strlen(location->file));
+        append(header, header_size, &len, ":", 1);
+        append_number(header, header_size, &len, (unsigned long)location->line);
+        if (location->func)
+        {
+            append(header, header_size, &len, " ", 1);
+            append(header, header_size, &len, location->func, strlen(location->func));
+            append(header, header_size, &len, "()", 2);
+        }
+        append(header, header_size, &len, "] ", 2);
+    }
+
+    append(header, header_size, &len, "[", 1);
+    append_timestamp(header, header_size, &len, timestamp);
+    append(header, header_size, &len, "] ", 2);
+
+    return len;
+}
+
+/**
+ * @brief Compile a layout pattern into a list of operations, run by format_layout on every print call.
+ *        Literal text is gathered in runs, and "%%" is turned into a literal '%'
+ * 
+ * @param layout 
+ * @param pattern 
+ * @return true if the pattern is valid: known conversions only, and %m at the very end
+ */
+static bool compile_layout(log_layout_t* layout, const char* pattern)
+{
+    size_t text_len = 0;
+
+    layout->count = 0;
+
+    for (const char* p = pattern; *p != NULL_CHAR; ++p)
+    {
+        LOG_LAYOUT_OP op = LOG_LAYOUT_TEXT;
+
+        if (*p == '%')
+        {
+            switch (*++p)
+            {
+                case 't':   op = LOG_LAYOUT_TIMESTAMP;  break;
+                case 'l':   op = LOG_LAYOUT_LEVEL;      break;
+                case 'f':   op = LOG_LAYOUT_FILE;       break;
+                case 'n':   op = LOG_LAYOUT_LINE;       break;
+                case 'F':   op = LOG_LAYOUT_FUNC;       break;
+                case '%':                               break;
+                case 'm':   return p[1] == NULL_CHAR;
+                default:    return false;
+            }
+        }
+
+        if (op == LOG_LAYOUT_TEXT)
+        {
+            log_layout_op_t* last = layout->count > 0 ? &layout->ops[layout->count - 1] : NULL;
+
+            if (text_len >= MAX_LAYOUT_TEXT)
+                return false;
+            layout->text[text_len] = *p;
+
+            // consecutive characters make a single copy
+            if (last && last->op == LOG_LAYOUT_TEXT && last->offset + last->length == text_len)
+            {
+                last->length++;
+                text_len++;
+                continue;
+            }
+            text_len++;
+        }
+
+        if (layout->count >= MAX_LAYOUT_OPS)
+            return false;
+        layout->ops[layout->count++] = (log_layout_op_t){.op = op,
+                                                         .offset = op == LOG_LAYOUT_TEXT ? text_len - 1 : 0,
+                                                         .length = op == LOG_LAYOUT_TEXT ? 1 : 0};
+    }
+
+    // no %m
+    return false;
+}
+
+/**
+ * @brief Render a whole log message into 'line': header, then message with arguments. No colors.
+ *        Arguments come either from 'args' or, if not NULL, from the 'captured' ones.
+ * 
+ * @param needed if not NULL, length the whole line would take without truncation (known for 'args' only)
+ * @param message_offset if not NULL, where the message starts in 'line', right after the header
+ * @return size_t length of the rendered line, truncated to 'line_size'
+ */
+static size_t compose_line(char* line, size_t line_size, LOG_MSG_CATEGORY category, const log_location_t* location,
+                           const struct timespec* timestamp, const char* fmt, va_list* args, 
+                           const uint8_t* captured, size_t captured_size, size_t* needed, size_t* message_offset)
+{
+    size_t len = 0;
+    int ret;
+
+    if (needed)
+        *needed = 0;
+    if (message_offset)
+        *message_offset = 0;
+    if (line_size == 0)
+        return 0;
+
+    len = format_header(line, line_size, category, location, timestamp);
+
+    if (message_offset)
+        *message_offset = len < line_size - 1 ? len : line_size - 1;
+
+    if (len < line_size - 1)
+    {
+        if (captured)
+            len += log_internal_render_args(line + len, line_size - len, fmt, captured, captured_size);
+        else
+        {
+            ret = vsnprintf(line + len, line_size - len, fmt, *args);
+            len += ret < 0 ? 0 : (size_t)ret;
+        }
+    }
+
+    if (needed)
+        *needed = len;
+
+    // truncated lines still end with a new line, so that the next log message starts on its own line.
+    // Captured arguments are rendered up to the end of 'line' at most, so a full one is taken as truncated
+    if (len > line_size - 1 || (captured && len == line_size - 1))
+    {
+        len = line_size - 1;
+        if (len > 0)
+            line[len - 1] = '\n';
+    }
+
+    line[len] = NULL_CHAR;
+    return len;
+}
+
+size_t log_internal_format_line(char* line, size_t line_size, LOG_MSG_CATEGORY category, const log_location_t* location,
+                                const char* fmt, va_list args, size_t* message_offset)
+{
+    struct timespec timestamp;
+    va_list line_args;
+    size_t len;
+
+    log_internal_now(&timestamp);
+
+    // va_list may be an array type, so it cannot be passed by address as a parameter
+    va_copy(line_args, args);
+    len = compose_line(line, line_size, category, location, &timestamp, fmt, &line_args, NULL, 0, NULL, message_offset);
+    va_end(line_args);
+    return len;
+}
+
+size_t log_internal_format_captured(char* line, size_t line_size, LOG_MSG_CATEGORY category, const log_location_t* location,
+                                    const struct timespec* timestamp, const char* fmt, const uint8_t* args, size_t args_size,
+                                    size_t* message_offset)
+{
+    return compose_line(line, line_size, category, location, timestamp, fmt, NULL, args, args_size, NULL, message_offset);
+}
+
+const char* log_internal_console_color(LOG_MSG_CATEGORY category)
+{
+    return console_color(category);
+}
+
+void log_internal_update_level()
+{
+    LOG_MSG_CATEGORY level = __atomic_load_n(&log_atts.log_level, __ATOMIC_RELAXED);
+    LOG_MSG_CATEGORY sinks_level = log_internal_sinks_level();
+
+    if (sinks_level > level)
+        level = sinks_level;
+    if (log_internal_recorder_enabled())
+        level = LOG_MSG_DBG;
+
+    __atomic_store_n(&log4embedded_level, level, __ATOMIC_RELAXED);
+    log_internal_modules_invalidate();
+}
+
+int log_internal_output_fd()
+{
+    int fd = __atomic_load_n(&log_atts.log_fd, __ATOMIC_RELAXED);
+
+    // binary and memory-mapped log files cannot take plain text: use the stderr instead
+    if (log_internal_binary_enabled() || log_internal_mmap_enabled())
+        return STDERR_FILENO;
+
+    return fd >= 0 ? fd : STDOUT_FILENO;
+}
+
+void log_internal_burst_begin()
+{
+    log_internal_batch_begin();
+}
+
+void log_internal_burst_end()
+{
+    pthread_mutex_lock(&log_atts.lock);
+    log_internal_batch_end();
+    pthread_mutex_unlock(&log_atts.lock);
+}
+
+void log_internal_rotation_settings(size_t* max_file_size, unsigned int* max_files, LOG_COMPRESSION* compression)
+{
+    // read atomically, with no lock, as the binary sink checks them on every print call
+    *max_file_size = __atomic_load_n(&log_atts.rotation_max_size, __ATOMIC_RELAXED);
+    *max_files = __atomic_load_n(&log_atts.rotation_max_files, __ATOMIC_RELAXED);
+    *compression = __atomic_load_n(&log_atts.rotation_compression, __ATOMIC_RELAXED);
+}
+
+void log_internal_write(LOG_MSG_CATEGORY category, bool to_output, const char* line, size_t length, size_t message_offset, bool plain)
+{
+    // a log message repeated over and over is only counted, and reported later
+    if (log_internal_limit_duplicate(category, to_output, line + message_offset, length - message_offset))
+        return;
+
+    log_internal_output(category, to_output, line, length, message_offset, plain);
+}
+
+void log_internal_output(LOG_MSG_CATEGORY category, bool to_output, const char* line, size_t length, size_t message_offset, bool plain)
+{
+    // the default sink, unless it writes a binary log file: print calls have already written the log message there
+    if (to_output && !log_internal_binary_enabled())
+    {
+        uint64_t start = log_internal_stats_clock();
+
+        // the memory-mapped sink takes no lock: a single memcpy in the common case
+        if (!log_internal_mmap_write(line, length))
+        {
+            pthread_mutex_lock(&log_atts.lock);
+            write_line(category, line, length, plain);
+            pthread_mutex_unlock(&log_atts.lock);
+        }
+
+        log_internal_stats_latency(LOG_SINK_DEFAULT, start);
+        log_internal_stats_add(LOG_STAT_BYTES, length);
+    }
+
+    // the very same rendered line is shared by every other sink
+    log_internal_sinks_write(category, line, length, message_offset, plain);
+}
+
+/**
+ * @brief This is the actual printf wrapper. Depending on LOG_MSG_CATEGORY, it will print
+ *        a different message format (labels, colors...) along with the current date and time.
+ * 
+ *        The whole line is rendered once, and then written at once to every sink whose level allows it,
+ *        so that log messages from different threads never interleave.
+ *        In asynchronous mode, the log message is handed over to the writer thread instead.
+ * 
+ * @param category 
+ * @param location where the print call was made, or NULL if unknown
+ * @param fmt 
+ * @param args 
+ */
+static void print_line_va(LOG_MSG_CATEGORY category, LOG_MSG_CATEGORY output_level, const log_location_t* location,
+                          const char* fmt, va_list args)
+{
+    log_line_buffer_t* thread_buffer;
+    char fallback[MIN_LINE_SIZE];
+    char* line = fallback;
+    size_t line_size = sizeof(fallback);
+    char* long_line = NULL;
+    struct timespec timestamp;
+    size_t needed;
+    size_t message_offset;
+    size_t len;
+    va_list line_args;
+    va_list retry_args;
+
+    bool to_output = (int)category <= (int)output_level;
+    bool to_sinks = log_internal_sinks_accept(category);
+    bool to_recorder = log_internal_recorder_enabled();
+
+    if (!to_output && !to_sinks && !to_recorder)
+    {
+        log_internal_stats_add(LOG_STAT_FILTERED, 1);
+        return;
+    }
+    log_internal_stats_message(category);
+
+    // the binary sink skips text formatting altogether
+    if (to_output && log_internal_binary_write(category, fmt, args))
+        to_output = false;
+
+    // the writer thread renders its own copy, for the log output and the other sinks
+    if ((to_output || to_sinks) && log_internal_async_submit(category, to_output, location, fmt, args))
+        to_output = to_sinks = false;
+
+    if (!to_output && !to_sinks && !to_recorder)
+        return;
+
+    log_internal_now(&timestamp);
+
+    // the per-thread buffer needs no lock nor heap allocation, except on the first print call of each thread
+    if ((thread_buffer = get_line_buffer()))
+    {
+        line = thread_buffer->buffer;
+        line_size = thread_buffer->size;
+    }
+
+    // va_list may be an array type, so it cannot be passed by address as a parameter
+    va_copy(line_args, args);
+    va_copy(retry_args, args);
+    len = compose_line(line, line_size, category, location, &timestamp, fmt, &line_args, NULL, 0, &needed, &message_offset);
+    va_end(line_args);
+
+    // slow path: the line did not fit, so render it again in a heap buffer, up to LOG4EMBEDDED_MAX_LINE_SIZE bytes
+    if (needed >= line_size)
+    {
+        size_t long_size = needed < LOG4EMBEDDED_MAX_LINE_SIZE ? needed + 1 : LOG4EMBEDDED_MAX_LINE_SIZE;
+        if (long_size > line_size && (long_line = malloc(long_size)))
+            len = compose_line(long_line, long_size, category, location, &timestamp, fmt, &retry_args, NULL, 0, NULL, NULL);
+    }
+    va_end(retry_args);
+
+    // the flight recorder keeps every log message, whatever the log level
+    if (to_recorder)
+        log_internal_recorder_write(long_line ? long_line : line, len);
+
+    if (to_output || to_sinks)
+        log_internal_write(category, to_output, long_line ? long_line : line, len, message_offset, false);
+    free(long_line);
+
+    if (to_recorder && category == LOG_MSG_CRIT)
+        log_flight_recorder_dump();
+}
+
+/**
+ * @brief Same as print_line_va, unless the rate limit of the call site drops the print call
+ *
+ * @param category
+ * @param location where the print call was made, or NULL if unknown
+ * @param fmt
+ * @param args
+ */
+static void print_internal_va(LOG_MSG_CATEGORY category, LOG_MSG_CATEGORY output_level, const log_location_t* location,
+                              const char* fmt, va_list args)
+{
+    if (log_internal_limit_allow(category, output_level, location, fmt))
+        print_line_va(category, output_level, location, fmt, args);
+}
+
+/**
+ * @brief Same as print_line_va, for arguments already captured as tagged values of 'fmt'
+ *
+ * @param category
+ * @param output_level most verbose category which makes it to the log output
+ * @param location
+ * @param fmt
+ * @param args
+ * @param args_size
+ */
+static void print_captured(LOG_MSG_CATEGORY category, LOG_MSG_CATEGORY output_level, const log_location_t* location,
+                           const char* fmt, const uint8_t* args, size_t args_size)
+{
+    log_line_buffer_t* thread_buffer;
+    char fallback[MIN_LINE_SIZE];
+    char* line = fallback;
+    size_t line_size = sizeof(fallback);
+    char* long_line = NULL;
+    struct timespec timestamp;
+    size_t message_offset;
+    size_t len;
+
+    bool to_output = (int)category <= (int)output_level;
+    bool to_sinks = log_internal_sinks_accept(category);
+    bool to_recorder = log_internal_recorder_enabled();
+
+    if (!to_output && !to_sinks && !to_recorder)
+    {
+        log_internal_stats_add(LOG_STAT_FILTERED, 1);
+        return;
+    }
+    log_internal_stats_message(category);
+
+    if (to_output && log_internal_binary_write_captured(category, fmt, args, args_size))
+        to_output = false;
+
+    if ((to_output || to_sinks) && log_internal_async_submit_captured(category, to_output, location, fmt, args, args_size))
+        to_output = to_sinks = false;
+
+    if (!to_output && !to_sinks && !to_recorder)
+        return;
+
+    log_internal_now(&timestamp);
+
+    if ((thread_buffer = get_line_buffer()))
+    {
+        line = thread_buffer->buffer;
+        line_size = thread_buffer->size;
+    }
+
+    len = compose_line(line, line_size, category, location, &timestamp, fmt, NULL, args, args_size, NULL, &message_offset);
+
+    // slow path: the length is not known ahead, so a line filling up the buffer is rendered again in a heap one
+    if (len >= line_size - 1 && line_size < LOG4EMBEDDED_MAX_LINE_SIZE && (long_line = malloc(LOG4EMBEDDED_MAX_LINE_SIZE)))
+        len = compose_line(long_line, LOG4EMBEDDED_MAX_LINE_SIZE, category, location, &timestamp, fmt, NULL, args, args_size,
+                           NULL, NULL);
+
+    if (to_recorder)
+        log_internal_recorder_write(long_line ? long_line : line, len);
+
+    if (to_output || to_sinks)
+        log_internal_write(category, to_output, long_line ? long_line : line, len, message_offset, false);
+    free(long_line);
+
+    if (to_recorder && category == LOG_MSG_CRIT)
+        log_flight_recorder_dump();
+}
+
+/**
+ * @brief Render a structured log message into the per-thread buffer, and write it as print_line_va does.
+ *        In asynchronous mode, the rendered line is handed over to the writer thread.
+ *
+ * @param category
+ * @param msg
+ * @param args key, value pairs up to a NULL key
+ */
+static void print_kv_va(LOG_MSG_CATEGORY category, const char* msg, va_list args)
+{
+    log_line_buffer_t* thread_buffer;
+    char fallback[MIN_LINE_SIZE];
+    char* line = fallback;
+    size_t line_size = sizeof(fallback);
+    char* long_line = NULL;
+    struct timespec timestamp;
+    bool truncated;
+    size_t len;
+    va_list line_args;
+
+    bool to_output = (int)category <= (int)output_level();
+    bool to_sinks = log_internal_sinks_accept(category);
+    bool to_recorder = log_internal_recorder_enabled();
+
+    if (!to_output && !to_sinks && !to_recorder)
+    {
+        log_internal_stats_add(LOG_STAT_FILTERED, 1);
+        return;
+    }
+    log_internal_stats_message(category);
+
+    log_internal_now(&timestamp);
+
+    if ((thread_buffer = get_line_buffer()))
+    {
+        line = thread_buffer->buffer;
+        line_size = thread_buffer->size;
+    }
+
+    // queued log messages keep their order: in asynchronous mode, fields which do not fit in a queued one are left out
+    if (log_internal_async_enabled() && line_size > LOG4EMBEDDED_ASYNC_RECORD_SIZE)
+        line_size = LOG4EMBEDDED_ASYNC_RECORD_SIZE;
+
+    va_copy(line_args, args);
+    len = log_internal_format_kv(line, line_size, category, &timestamp, msg, &line_args, &truncated);
+    va_end(line_args);
+
+    // slow path: some fields did not fit, so render it again in a heap buffer of LOG4EMBEDDED_MAX_LINE_SIZE bytes
+    if (truncated && line_size < LOG4EMBEDDED_MAX_LINE_SIZE && !log_internal_async_enabled() &&
+        (long_line = malloc(LOG4EMBEDDED_MAX_LINE_SIZE)))
+    {
+        va_copy(line_args, args);
+        len = log_internal_format_kv(long_line, LOG4EMBEDDED_MAX_LINE_SIZE, category, &timestamp, msg, &line_args, &truncated);
+        va_end(line_args);
+    }
+
+    if (to_recorder)
+        log_internal_recorder_write(long_line ? long_line : line, len);
+
+    // there is no format string to store in a binary log file: the rendered line is stored instead
+    if (to_output && log_internal_binary_write_line(category, long_line ? long_line : line))
+        to_output = false;
+
+    // the whole line is the message: there is no label to strip for the sinks taking the message only
+    // structured log messages are meant for parsers: no colors around them
+    if ((to_output || to_sinks) && !log_internal_async_submit_line(category, to_output, long_line ? long_line : line, len, 0, true))
+        log_internal_write(category, to_output, long_line ? long_line : line, len, 0, true);
+    free(long_line);
+
+    if (to_recorder && category == LOG_MSG_CRIT)
+        log_flight_recorder_dump();
+}
+
+void log_internal_print(LOG_MSG_CATEGORY category, LOG_MSG_CATEGORY output_level, const log_location_t* location,
+                        const char* fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    print_line_va(category, output_level, location, fmt, args);
+    va_end(args);
+}
+
+
+// Functions about library attributes
+void log_set_level(LOG_MSG_CATEGORY log_level)
+{
+    if (log_level >= LOG_MSG_NONE && log_level <= LOG_MSG_DBG)
+    {
+        __atomic_store_n(&log_atts.log_level, log_level, __ATOMIC_RELAXED);
+        log_internal_update_level();
+    }
+}
+
+LOG_MSG_CATEGORY log_get_level()
+{
+    return __atomic_load_n(&log_atts.log_level, __ATOMIC_RELAXED);
+}
+
+void log_set_file(const char* filepath, size_t filepath_size)
+{
+    // Checks if the file name is valid and if the file exists in the filesystem
+    if (filepath && filepath_size <= MAX_PATH_SIZE)
+        set_log_file(filepath, filepath_size, false);
+    else
+        log_print_warning("Given log file name is not valid. Logs shall be printed to the stdout.\n");
+}
+
+void log_set_file_with_color_text(const char* filepath, size_t filepath_size)
+{
+    // Checks if the file name is valid and if the file exists in the filesystem
+    if (filepath && filepath_size <= MAX_PATH_SIZE)
+        set_log_file(filepath, filepath_size, true);
+    else
+        log_print_warning("Given log file name is not valid. Logs shall be printed to the stdout.\n");
+}
+
+void log_enable_colors()
+{
+    __atomic_store_n(&log_atts.log_colors_enabled, true, __ATOMIC_RELAXED);
+}
+
+void log_disable_colors()
+{
+    __atomic_store_n(&log_atts.log_colors_enabled, false, __ATOMIC_RELAXED);
+    write_all(STDOUT_FILENO, ANSI_COLOR_RESET, strlen(ANSI_COLOR_RESET));
+}
+
+void log_set_buffer_size(size_t buffer_size)
+{
+    pthread_mutex_lock(&log_atts.lock);
+    flush_output();
+    free(log_atts.log_buffer);
+    log_atts.log_buffer = NULL;
+    log_atts.log_buffer_size = buffer_size;
+    pthread_mutex_unlock(&log_atts.lock);
+}
+
+void log_set_line_buffer_size(size_t line_size)
+{
+    if (line_size < MIN_LINE_SIZE)
+        line_size = MIN_LINE_SIZE;
+    if (line_size > LOG4EMBEDDED_MAX_LINE_SIZE)
+        line_size = LOG4EMBEDDED_MAX_LINE_SIZE;
+
+    // every thread resizes its own buffer on its next print call
+    __atomic_store_n(&log_atts.line_buffer_size, line_size, __ATOMIC_RELAXED);
+}
+
+void log_set_timestamp_format(LOG_TIMESTAMP_FORMAT format, LOG_TIMESTAMP_PRECISION precision)
+{
+    if (format >= LOG_TIMESTAMP_LOCAL && format <= LOG_TIMESTAMP_ISO8601_UTC &&
+        precision >= LOG_TIMESTAMP_SEC && precision <= LOG_TIMESTAMP_USEC)
+        __atomic_store_n(&log_atts.timestamp_setting, (int)format | ((int)precision << 8), __ATOMIC_RELAXED);
+}
+
+int log_set_layout(const char* pattern)
+{
+    log_layout_t* layout = NULL;
+
+    if (pattern)
+    {
+        if (!(layout = malloc(sizeof(log_layout_t))))
+            return -1;
+
+        if (!compile_layout(layout, pattern))
+        {
+            free(layout);
+            return -1;
+        }
+    }
+
+    // print calls may still be rendering with the previous layout: it is only released by log_close
+    pthread_mutex_lock(&log_atts.lock);
+    if (log_atts.layout)
+    {
+        log_atts.layout->retired = log_atts.retired_layouts;
+        log_atts.retired_layouts = log_atts.layout;
+    }
+    __atomic_store_n(&log_atts.layout, layout, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&log_atts.lock);
+    return 0;
+}
+
+void log_set_flush_policy(LOG_FLUSH_POLICY policy, size_t size_threshold, unsigned int time_threshold_ms)
+{
+    if (policy >= LOG_FLUSH_EVERY_LINE && policy <= LOG_FLUSH_ON_THRESHOLD)
+    {
+        pthread_mutex_lock(&log_atts.lock);
+        log_atts.flush_policy = policy;
+        log_atts.flush_size_threshold = size_threshold;
+        log_atts.flush_time_threshold_ms = time_threshold_ms;
+        pthread_mutex_unlock(&log_atts.lock);
+    }
+}
+
+int log_set_mmap_file(const char* filepath, size_t filepath_size, size_t segment_size, unsigned int sync_interval_ms)
+{
+    char file_name[MAX_PATH_SIZE];
+
+    if (!filepath || filepath_size == 0 || filepath_size > MAX_PATH_SIZE)
+        return -1;
+
+    snprintf(file_name, filepath_size, "%s", filepath);
+
+    // log messages already buffered for the previous log output are written there
+    log_internal_async_drain();
+    pthread_mutex_lock(&log_atts.lock);
+    close_log_file();
+    log_atts.log_file_name[0] = NULL_CHAR;
+    log_atts.log_file_size = 0;
+    pthread_mutex_unlock(&log_atts.lock);
+
+    log_internal_binary_close();
+    if (log_internal_mmap_open(file_name, segment_size, sync_interval_ms) != 0)
+    {
+        log_print_warning("Memory-mapped log file cannot be opened. Printing logs to the stdout...\n");
+        return -1;
+    }
+
+    __atomic_store_n(&log_atts.log_colors_enabled, false, __ATOMIC_RELAXED);
+    return 0;
+}
+
+int log_set_binary_file(const char* filepath, size_t filepath_size)
+{
+    char file_name[MAX_PATH_SIZE];
+
+    if (!filepath || filepath_size == 0 || filepath_size > MAX_PATH_SIZE)
+        return -1;
+
+    snprintf(file_name, filepath_size, "%s", filepath);
+
+    // log messages already buffered for the previous log output are written there
+    log_internal_async_drain();
+    log_internal_mmap_close();
+    pthread_mutex_lock(&log_atts.lock);
+    close_log_file();
+    log_atts.log_file_name[0] = NULL_CHAR;
+    log_atts.log_file_size = 0;
+    pthread_mutex_unlock(&log_atts.lock);
+
+    if (log_internal_binary_open(file_name) != 0)
+    {
+        log_print_warning("Binary log file cannot be opened. Printing logs to the stdout...\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+int log_set_io_strategy(LOG_IO_STRATEGY strategy)
+{
+    if (strategy < LOG_IO_WRITE || strategy > LOG_IO_URING)
+        return -1;
+
+    // log messages written so far, batched or buffered, reach the log output before any of the new strategy
+    pthread_mutex_lock(&log_atts.lock);
+    flush_output();
+    log_internal_batch_set_strategy(strategy);
+    pthread_mutex_unlock(&log_atts.lock);
+    return 0;
+}
+
+LOG_IO_STRATEGY log_get_io_strategy()
+{
+    return log_internal_batch_strategy();
+}
+
+void log_flight_recorder_dump()
+{
+    // log messages still queued or buffered go first, so that the dump comes after them
+    log_internal_async_drain();
+    log_internal_binary_flush();
+
+    pthread_mutex_lock(&log_atts.lock);
+    flush_output();
+    log_internal_recorder_dump(log_internal_output_fd());
+    pthread_mutex_unlock(&log_atts.lock);
+}
+
+int log_set_rotation(size_t max_file_size, unsigned int max_files, LOG_ROTATION_INTERVAL interval, LOG_COMPRESSION compression)
+{
+    if (max_files == 0 || interval < LOG_ROTATE_NEVER || interval > LOG_ROTATE_DAILY || 
+        !log_internal_compression_available(compression))
+        return -1;
+
+    pthread_mutex_lock(&log_atts.lock);
+    __atomic_store_n(&log_atts.rotation_max_size, max_file_size, __ATOMIC_RELAXED);
+    __atomic_store_n(&log_atts.rotation_max_files, max_files, __ATOMIC_RELAXED);
+    log_atts.rotation_interval = interval;
+    __atomic_store_n(&log_atts.rotation_compression, compression, __ATOMIC_RELAXED);
+    log_atts.next_rollover = next_rollover(interval);
+    pthread_mutex_unlock(&log_atts.lock);
+    return 0;
+}
+
+void log_flush()
+{
+    // counts of suppressed log messages go out with the rest
+    log_internal_limit_report();
+
+    // make sure the writer thread has emptied its queue first
+    log_internal_async_drain();
+
+    pthread_mutex_lock(&log_atts.lock);
+    flush_output();
+    pthread_mutex_unlock(&log_atts.lock);
+
+    log_internal_mmap_sync();
+    log_internal_binary_flush();
+    log_internal_sinks_flush();
+}
+
+void log_close()
+{
+    // no reload may add sinks while they are being removed
+    log_internal_config_close();
+    log_internal_limit_report();
+    log_flight_recorder_stop();
+    log_async_stop();
+    log_internal_sinks_close();
+    log_internal_mmap_close();
+    log_internal_binary_close();
+
+    pthread_mutex_lock(&log_atts.lock);
+    close_log_file();
+    free(log_atts.log_buffer);
+    log_atts.log_buffer = NULL;
+    log_atts.log_file_name[0] = NULL_CHAR;
+    log_atts.log_file_size = 0;
+    log_internal_batch_close();
+
+    // back to the default layout
+    if (log_atts.layout)
+    {
+        log_atts.layout->retired = log_atts.retired_layouts;
+        log_atts.retired_layouts = log_atts.layout;
+        __atomic_store_n(&log_atts.layout, NULL, __ATOMIC_RELEASE);
+    }
+    while (log_atts.retired_layouts)
+    {
+        log_layout_t* retired = log_atts.retired_layouts;
+        log_atts.retired_layouts = retired->retired;
+        free(retired);
+    }
+
+    // let the rotation thread finish renaming and compressing rotated log files
+    log_internal_rotate_stop();
+    pthread_mutex_unlock(&log_atts.lock);
+}
+
+// print function definitions
+void log_print_at(LOG_MSG_CATEGORY category, const char* file, int line, const char* func, const char* fmt, ...)
+{
+    if (fmt && category > LOG_MSG_NONE && category <= LOG_MSG_DBG && level_enabled(category))
+    {
+        log_location_t location = {.file = file, .line = line, .func = func};
+        va_list args;
+        va_start(args, fmt);
+        print_internal_va(category, output_level(), &location, fmt, args);
+        va_end(args);
+    }
+}
+
+void log_print_module_at(LOG_MSG_CATEGORY category, LOG_MSG_CATEGORY module_level, const char* file, int line,
+                         const char* func, const char* fmt, ...)
+{
+    // the LOG_* macros have already checked the level of the module
+    if (fmt && category > LOG_MSG_NONE && category <= LOG_MSG_DBG)
+    {
+        log_location_t location = {.file = file, .line = line, .func = func};
+        va_list args;
+        va_start(args, fmt);
+        print_internal_va(category, module_level, &location, fmt, args);
+        va_end(args);
+    }
+}
+
+void log_print_captured(const log_call_site_t* site, const uint8_t* args, size_t args_size)
+{
+    if (site && site->fmt && site->category > LOG_MSG_NONE && site->category <= LOG_MSG_DBG && (args || args_size == 0) &&
+        args_size <= LOG_MAX_CAPTURED_SIZE && level_enabled(site->category))
+    {
+        log_location_t location = {.file = site->file, .line = site->line, .func = site->func};
+        if (log_internal_limit_allow(site->category, output_level(), &location, site->fmt))
+            print_captured(site->category, output_level(), &location, site->fmt, args, args_size);
+    }
+}
+
+void log_print_module_captured(const log_call_site_t* site, LOG_MSG_CATEGORY module_level, const uint8_t* args,
+                               size_t args_size)
+{
+    // the LOG_* macros have already checked the level of the module
+    if (site && site->fmt && site->category > LOG_MSG_NONE && site->category <= LOG_MSG_DBG && (args || args_size == 0) &&
+        args_size <= LOG_MAX_CAPTURED_SIZE)
+    {
+        log_location_t location = {.file = site->file, .line = site->line, .func = site->func};
+        if (log_internal_limit_allow(site->category, module_level, &location, site->fmt))
+            print_captured(site->category, module_level, &location, site->fmt, args, args_size);
+    }
+}
+
+
+void log_print_kv(LOG_MSG_CATEGORY category, const char* msg, ...)
+{
+    if (msg && category > LOG_MSG_NONE && category <= LOG_MSG_DBG && level_enabled(category) &&
+        log_internal_limit_allow(category, output_level(), NULL, msg))
+    {
+        va_list args;
+        va_start(args, msg);
+        print_kv_va(category, msg, args);
+        va_end(args);
+    }
+}
+
+
 void log_print_critical(const char* fmt, ...)
 {
-    if (fmt && log_atts.log_level >= LOG_MSG_CRIT)
+    if (fmt && level_enabled(LOG_MSG_CRIT))
     {
         va_list args;
         va_start(args, fmt);
-        print_internal_va(LOG_MSG_CRIT, fmt, args);
+        print_internal_va(LOG_MSG_CRIT, output_level(), NULL, fmt, args);
         va_end(args);
     }
 }
@@ -257,11 +1786,11 @@ void log_print_critical(const char* fmt, ...)
 
 void log_print_error(const char* fmt, ...)
 {
-    if (fmt && log_atts.log_level >= LOG_MSG_ERR)
+    if (fmt && level_enabled(LOG_MSG_ERR))
     {
         va_list args;
         va_start(args, fmt);
-        print_internal_va(LOG_MSG_ERR, fmt, args);
+        print_internal_va(LOG_MSG_ERR, output_level(), NULL, fmt, args);
         va_end(args);
     }
 }
@@ -269,11 +1798,11 @@ void log_print_error(const char* fmt, ...)
 
 void log_print_warning(const char* fmt, ...)
 {
-    if (fmt && log_atts.log_level >= LOG_MSG_WARN)
+    if (fmt && level_enabled(LOG_MSG_WARN))
     {
         va_list args;
         va_start(args, fmt);
-        print_internal_va(LOG_MSG_WARN, fmt, args);
+        print_internal_va(LOG_MSG_WARN, output_level(), NULL, fmt, args);
         va_end(args);
     }
 }
@@ -281,11 +1810,11 @@ void log_print_warning(const char* fmt, ...)
 
 void log_print_info(const char* fmt, ...)
 {
-    if (fmt && log_atts.log_level >= LOG_MSG_INFO)
+    if (fmt && level_enabled(LOG_MSG_INFO))
     {
         va_list args;
         va_start(args, fmt);
-        print_internal_va(LOG_MSG_INFO, fmt, args);
+        print_internal_va(LOG_MSG_INFO, output_level(), NULL, fmt, args);
         va_end(args);
     }
 }
@@ -293,11 +1822,11 @@ void log_print_info(const char* fmt, ...)
 
 void log_print_debug(const char* fmt, ...)
 {
-    if (fmt && log_atts.log_level >= LOG_MSG_DBG)
+    if (fmt && level_enabled(LOG_MSG_DBG))
     {
         va_list args;
         va_start(args, fmt);
-        print_internal_va(LOG_MSG_DBG, fmt, args);
+        print_internal_va(LOG_MSG_DBG, output_level(), NULL, fmt, args);
         va_end(args);
     }
 }
\ No newline at end of file
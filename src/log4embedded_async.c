@@ -0,0 +1,552 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "log4embedded.h"
+#include "log4embedded_internal.h"
+
+// Define the cache line size, to keep producer and consumer indexes apart
+#define CACHE_LINE_SIZE     64
+
+// Define how long the writer thread sleeps when the queue is empty, in milliseconds
+#define WRITER_IDLE_MS      100
+
+// one queued log message. 'sequence' tells whether the slot is free or ready to be written (see Vyukov's bounded queue)
+typedef struct {
+    size_t sequence;
+    LOG_MSG_CATEGORY category;
+    bool to_output;                                     // whether it goes to the log output, or to the other sinks only
+    log_location_t location;                            // source location strings are static, so only pointers are kept
+    const char* fmt;                                    // only for deferred formatting, NULL otherwise
+    struct timespec timestamp;                          // only for deferred formatting
+    size_t length;
+    size_t message_offset;                              // where the message starts in the rendered line
+    bool plain;                                         // written with no colors, e.g.: structured log messages
+    char line[LOG4EMBEDDED_ASYNC_RECORD_SIZE];          // rendered line, or captured arguments of 'fmt'
+} log_record_t;
+
+// attributes of the asynchronous mode
+typedef struct {
+    log_record_t* records;
+    size_t mask;                                        // queue capacity - 1
+    LOG_OVERFLOW_POLICY overflow_policy;
+    bool running;
+    bool deferred_formatting;
+
+    _Alignas(CACHE_LINE_SIZE) size_t enqueue_pos;       // written by the print calls
+    _Alignas(CACHE_LINE_SIZE) size_t dequeue_pos;       // written by the writer thread (and by producers dropping the oldest)
+    _Alignas(CACHE_LINE_SIZE) size_t pending;           // queued messages not written yet
+    uint64_t dropped;
+    int active_producers;                               // print calls currently using the queue
+    int writer_sleeping;
+    int producers_waiting;                              // print calls blocked on a full queue
+    int drainers_waiting;                               // calls waiting for the queue to be empty
+    bool stop_requested;
+
+    pthread_t writer;
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;                              // signaled by print calls, for the writer thread
+    pthread_cond_t room;                                // signaled by the writer thread, for blocked print calls
+    pthread_cond_t drained;                             // signaled once no queued log message is left
+} log_async_t;
+
+static log_async_t log_async = {.records = NULL,
+                                .running = false,
+                                .lock = PTHREAD_MUTEX_INITIALIZER,
+                                .wakeup = PTHREAD_COND_INITIALIZER,
+                                .room = PTHREAD_COND_INITIALIZER,
+                                .drained = PTHREAD_COND_INITIALIZER};
+
+// whether the calling thread is the writer thread, which must never queue log messages for itself
+static __thread bool on_writer_thread = false;
+
+
+/**
+ * @brief Claim a free slot of the queue
+ *
+ * @return log_record_t* the claimed slot, or NULL if the queue is full
+ */
+static log_record_t* claim_record(size_t* pos_out)
+{
+    size_t pos = __atomic_load_n(&log_async.enqueue_pos, __ATOMIC_RELAXED);
+
+    for (;;)
+    {
+        log_record_t* record = &log_async.records[pos & log_async.mask];
+        size_t seq = __atomic_load_n(&record->sequence, __ATOMIC_ACQUIRE);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+        if (diff == 0)
+        {
+            if (__atomic_compare_exchange_n(&log_async.enqueue_pos, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+                *pos_out = pos;
+                return record;
+            }
+        }
+        else if (diff < 0)
+            return NULL;
+        else
+            pos = __atomic_load_n(&log_async.enqueue_pos, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief Take the oldest ready slot out of the queue and copy it into 'out'
+ *
+ * @param out
+ * @return true if a log message was dequeued
+ */
+static bool dequeue_record(log_record_t* out)
+{
+    size_t pos = __atomic_load_n(&log_async.dequeue_pos, __ATOMIC_RELAXED);
+
+    for (;;)
+    {
+        log_record_t* record = &log_async.records[pos & log_async.mask];
+        size_t seq = __atomic_load_n(&record->sequence, __ATOMIC_ACQUIRE);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+        if (diff == 0)
+        {
+            if (__atomic_compare_exchange_n(&log_async.dequeue_pos, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+                if (out)
+                {
+                    out->category = record->category;
+                    out->to_output = record->to_output;
+                    out->location = record->location;
+                    out->fmt = record->fmt;
+                    out->timestamp = record->timestamp;
+                    out->length = record->length;
+                    out->message_offset = record->message_offset;
+                    out->plain = record->plain;
+                    memcpy(out->line, record->line, record->length);
+                }
+
+                // hand the slot back to the producers, one lap later
+                __atomic_store_n(&record->sequence, pos + log_async.mask + 1, __ATOMIC_RELEASE);
+                return true;
+            }
+        }
+        else if (diff < 0)
+            return false;
+        else
+            pos = __atomic_load_n(&log_async.dequeue_pos, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief Wake the writer thread up, only if it is sleeping, so that print calls do not pay for a syscall
+ *
+ */
+static void wake_writer()
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&log_async.writer_sleeping, __ATOMIC_SEQ_CST))
+    {
+        pthread_mutex_lock(&log_async.lock);
+        pthread_cond_signal(&log_async.wakeup);
+        pthread_mutex_unlock(&log_async.lock);
+    }
+}
+
+/**
+ * @brief Wake up the print calls blocked on a full queue, only if there are any
+ *
+ */
+static void wake_producers()
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&log_async.producers_waiting, __ATOMIC_SEQ_CST))
+    {
+        pthread_mutex_lock(&log_async.lock);
+        pthread_cond_broadcast(&log_async.room);
+        pthread_mutex_unlock(&log_async.lock);
+    }
+}
+
+/**
+ * @brief Account for a queued log message written or dropped, and wake up the calls waiting for the queue to be
+ *        empty if it was the last one
+ *
+ */
+static void release_pending()
+{
+    if (__atomic_sub_fetch(&log_async.pending, 1, __ATOMIC_SEQ_CST) > 0)
+        return;
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&log_async.drainers_waiting, __ATOMIC_SEQ_CST))
+    {
+        pthread_mutex_lock(&log_async.lock);
+        pthread_cond_broadcast(&log_async.drained);
+        pthread_mutex_unlock(&log_async.lock);
+    }
+}
+
+/**
+ * @brief Whether the next slot of the queue is still taken, i.e.: the queue is full
+ *
+ * @return true
+ * @return false
+ */
+static bool queue_full()
+{
+    size_t pos = __atomic_load_n(&log_async.enqueue_pos, __ATOMIC_SEQ_CST);
+    size_t seq = __atomic_load_n(&log_async.records[pos & log_async.mask].sequence, __ATOMIC_SEQ_CST);
+
+    return (intptr_t)seq - (intptr_t)pos < 0;
+}
+
+/**
+ * @brief Writer thread: drain the queue to the log output, and sleep whenever it is empty
+ *
+ * @param arg
+ * @return void*
+ */
+static void* writer_thread(void* arg)
+{
+    log_record_t record;
+    char line[LOG4EMBEDDED_ASYNC_RECORD_SIZE];
+
+    (void)arg;
+
+    // log messages printed from here on (e.g.: by a sink) are written synchronously
+    on_writer_thread = true;
+
+    for (;;)
+    {
+        // a burst of log messages may be gathered and written at once, according to LOG_IO_STRATEGY
+        log_internal_burst_begin();
+        while (dequeue_record(&record))
+        {
+            if (record.fmt)
+            {
+                size_t message_offset;
+                size_t length = log_internal_format_captured(line, sizeof(line), record.category, &record.location, &record.timestamp, record.fmt,
+                                                             (const uint8_t*)record.line, record.length, &message_offset);
+                log_internal_write(record.category, record.to_output, line, length, message_offset, false);
+            }
+            else
+                log_internal_write(record.category, record.to_output, record.line, record.length, record.message_offset,
+                                   record.plain);
+            release_pending();
+            wake_producers();
+        }
+        log_internal_burst_end();
+
+        if (__atomic_load_n(&log_async.stop_requested, __ATOMIC_ACQUIRE) &&
+            __atomic_load_n(&log_async.pending, __ATOMIC_ACQUIRE) == 0)
+            break;
+
+        // nothing left to write: sleep until a print call wakes us up
+        pthread_mutex_lock(&log_async.lock);
+        __atomic_store_n(&log_async.writer_sleeping, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&log_async.pending, __ATOMIC_SEQ_CST) == 0 &&
+            !__atomic_load_n(&log_async.stop_requested, __ATOMIC_SEQ_CST))
+        {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += WRITER_IDLE_MS * 1000000L;
+            if (deadline.tv_nsec >= 1000000000L)
+            {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&log_async.wakeup, &log_async.lock, &deadline);
+        }
+        __atomic_store_n(&log_async.writer_sleeping, 0, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&log_async.lock);
+    }
+
+    return NULL;
+}
+
+
+/**
+ * @brief Reserve a record of the queue for a print call, applying the overflow policy when the queue is full.
+ *        A reserved record must be published with publish_record.
+ *
+ * @param pos position of the record in the queue
+ * @param handled set to true if the log message was dropped, false if asynchronous mode is off or the caller is the
+ *                writer thread
+ * @return log_record_t* NULL if no record was reserved
+ */
+static log_record_t* reserve_record(size_t* pos, bool* handled)
+{
+    log_record_t* record;
+
+    *handled = false;
+
+    // the writer thread would wait for itself on a full queue: it writes its own log messages right away
+    if (on_writer_thread)
+        return NULL;
+
+    // register as a producer before checking the mode, so that log_async_stop waits for us
+    __atomic_add_fetch(&log_async.active_producers, 1, __ATOMIC_SEQ_CST);
+    if (!__atomic_load_n(&log_async.running, __ATOMIC_SEQ_CST))
+    {
+        __atomic_sub_fetch(&log_async.active_producers, 1, __ATOMIC_RELEASE);
+        return NULL;
+    }
+
+    while (!(record = claim_record(pos)))
+    {
+        switch(log_async.overflow_policy)
+        {
+            case LOG_OVERFLOW_DROP_NEWEST:
+                __atomic_add_fetch(&log_async.dropped, 1, __ATOMIC_RELAXED);
+                log_internal_stats_add(LOG_STAT_DROPPED, 1);
+                __atomic_sub_fetch(&log_async.active_producers, 1, __ATOMIC_RELEASE);
+                *handled = true;
+                return NULL;
+
+            case LOG_OVERFLOW_DROP_OLDEST:
+                // steal the oldest message from the writer thread and try again
+                if (dequeue_record(NULL))
+                {
+                    release_pending();
+                    __atomic_add_fetch(&log_async.dropped, 1, __ATOMIC_RELAXED);
+                    log_internal_stats_add(LOG_STAT_DROPPED, 1);
+                }
+            break;
+
+            case LOG_OVERFLOW_BLOCK:
+            default:
+                // sleep until the writer thread takes a log message out of the queue
+                wake_writer();
+                pthread_mutex_lock(&log_async.lock);
+                __atomic_add_fetch(&log_async.producers_waiting, 1, __ATOMIC_SEQ_CST);
+                if (queue_full())
+                    pthread_cond_wait(&log_async.room, &log_async.lock);
+                __atomic_sub_fetch(&log_async.producers_waiting, 1, __ATOMIC_SEQ_CST);
+                pthread_mutex_unlock(&log_async.lock);
+            break;
+        }
+    }
+
+    return record;
+}
+
+/**
+ * @brief Hand a record filled in by the print call over to the writer thread
+ *
+ * @param record
+ * @param pos position of the record in the queue, as given by reserve_record
+ */
+static void publish_record(log_record_t* record, size_t pos)
+{
+    log_internal_stats_queue_depth(__atomic_add_fetch(&log_async.pending, 1, __ATOMIC_RELEASE));
+    __atomic_store_n(&record->sequence, pos + 1, __ATOMIC_RELEASE);
+
+    wake_writer();
+    __atomic_sub_fetch(&log_async.active_producers, 1, __ATOMIC_RELEASE);
+}
+
+
+bool log_internal_async_enabled()
+{
+    return __atomic_load_n(&log_async.running, __ATOMIC_ACQUIRE);
+}
+
+bool log_internal_async_submit(LOG_MSG_CATEGORY category, bool to_output, const log_location_t* location, const char* fmt, va_list args)
+{
+    log_record_t* record;
+    size_t pos;
+    bool handled;
+
+    if (!(record = reserve_record(&pos, &handled)))
+        return handled;
+
+    record->category = category;
+    record->to_output = to_output;
+    record->location = location ? *location : (log_location_t){.file = NULL, .line = 0, .func = NULL};
+    record->fmt = NULL;
+    record->plain = false;
+
+    // deferred formatting: only capture the arguments, the writer thread renders the log message
+    if (__atomic_load_n(&log_async.deferred_formatting, __ATOMIC_RELAXED))
+    {
+        va_list captured_args;
+        va_copy(captured_args, args);
+        if (log_internal_capture_args((uint8_t*)record->line, sizeof(record->line), &record->length, fmt, captured_args))
+        {
+            record->fmt = fmt;
+            log_internal_now(&record->timestamp);
+        }
+        va_end(captured_args);
+    }
+
+    if (!record->fmt)
+        record->length = log_internal_format_line(record->line, sizeof(record->line), category, location, fmt, args, &record->message_offset);
+
+    publish_record(record, pos);
+    return true;
+}
+
+bool log_internal_async_submit_line(LOG_MSG_CATEGORY category, bool to_output, const char* line, size_t length, size_t message_offset,
+                                    bool plain)
+{
+    log_record_t* record;
+    size_t pos;
+    bool handled;
+
+    // longer lines are written by the print call itself
+    if (length > sizeof(record->line))
+        return false;
+
+    if (!(record = reserve_record(&pos, &handled)))
+        return handled;
+
+    record->category = category;
+    record->to_output = to_output;
+    record->location = (log_location_t){.file = NULL, .line = 0, .func = NULL};
+    record->fmt = NULL;
+    memcpy(record->line, line, length);
+    record->length = length;
+    record->message_offset = message_offset;
+    record->plain = plain;
+
+    publish_record(record, pos);
+    return true;
+}
+
+bool log_internal_async_submit_captured(LOG_MSG_CATEGORY category, bool to_output, const log_location_t* location,
+                                        const char* fmt, const uint8_t* args, size_t args_size)
+{
+    log_record_t* record;
+    size_t pos;
+    bool handled;
+
+    if (!(record = reserve_record(&pos, &handled)))
+        return handled;
+
+    record->category = category;
+    record->to_output = to_output;
+    record->location = location ? *location : (log_location_t){.file = NULL, .line = 0, .func = NULL};
+    record->fmt = NULL;
+    record->plain = false;
+
+    // the arguments are self-contained already: rendering is always left to the writer thread, if they fit
+    if (args_size <= sizeof(record->line))
+    {
+        memcpy(record->line, args, args_size);
+        record->length = args_size;
+        record->fmt = fmt;
+        log_internal_now(&record->timestamp);
+    }
+    else
+    {
+        struct timespec timestamp;
+        log_internal_now(&timestamp);
+        record->length = log_internal_format_captured(record->line, sizeof(record->line), category, location, &timestamp,
+                                                      fmt, args, args_size, &record->message_offset);
+    }
+
+    publish_record(record, pos);
+    return true;
+}
+
+void log_internal_async_drain()
+{
+    // the writer thread cannot wait for itself
+    if (!log_internal_async_enabled() || on_writer_thread)
+        return;
+
+    // sleep until the writer thread takes the last log message out of the queue
+    while (__atomic_load_n(&log_async.pending, __ATOMIC_ACQUIRE) > 0)
+    {
+        wake_writer();
+        pthread_mutex_lock(&log_async.lock);
+        __atomic_add_fetch(&log_async.drainers_waiting, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&log_async.pending, __ATOMIC_SEQ_CST) > 0)
+            pthread_cond_wait(&log_async.drained, &log_async.lock);
+        __atomic_sub_fetch(&log_async.drainers_waiting, 1, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&log_async.lock);
+    }
+}
+
+
+int log_async_start(size_t queue_capacity, LOG_OVERFLOW_POLICY policy)
+{
+    size_t capacity = 2;
+
+    if (log_internal_async_enabled())
+        return 0;
+
+    if (queue_capacity == 0 || policy < LOG_OVERFLOW_BLOCK || policy > LOG_OVERFLOW_DROP_OLDEST)
+        return -1;
+
+    while (capacity < queue_capacity)
+        capacity <<= 1;
+
+    log_async.records = malloc(capacity * sizeof(log_record_t));
+    if (!log_async.records)
+        return -1;
+
+    for (size_t i = 0; i < capacity; ++i)
+        log_async.records[i].sequence = i;
+
+    log_async.mask = capacity - 1;
+    log_async.overflow_policy = policy;
+    log_async.enqueue_pos = 0;
+    log_async.dequeue_pos = 0;
+    log_async.pending = 0;
+    log_async.dropped = 0;
+    log_async.active_producers = 0;
+    log_async.writer_sleeping = 0;
+    log_async.producers_waiting = 0;
+    log_async.drainers_waiting = 0;
+    log_async.stop_requested = false;
+
+    if (pthread_create(&log_async.writer, NULL, writer_thread, NULL) != 0)
+    {
+        free(log_async.records);
+        log_async.records = NULL;
+        return -1;
+    }
+
+    __atomic_store_n(&log_async.running, true, __ATOMIC_RELEASE);
+    return 0;
+}
+
+void log_async_stop()
+{
+    if (!log_internal_async_enabled())
+        return;
+
+    // new print calls go synchronous from now on, then the writer empties the queue and exits
+    __atomic_store_n(&log_async.running, false, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&log_async.active_producers, __ATOMIC_ACQUIRE) > 0)
+        sched_yield();
+
+    __atomic_store_n(&log_async.stop_requested, true, __ATOMIC_SEQ_CST);
+    wake_writer();
+    pthread_mutex_lock(&log_async.lock);
+    pthread_cond_signal(&log_async.wakeup);
+    pthread_mutex_unlock(&log_async.lock);
+    pthread_join(log_async.writer, NULL);
+
+    free(log_async.records);
+    log_async.records = NULL;
+}
+
+uint64_t log_async_get_dropped()
+{
+    return __atomic_load_n(&log_async.dropped, __ATOMIC_RELAXED);
+}
+
+void log_enable_deferred_formatting()
+{
+    __atomic_store_n(&log_async.deferred_formatting, true, __ATOMIC_RELAXED);
+}
+
+void log_disable_deferred_formatting()
+{
+    __atomic_store_n(&log_async.deferred_formatting, false, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,408 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#ifdef LOG4EMBEDDED_HAVE_IO_URING
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+#include "log4embedded.h"
+#include "log4embedded_internal.h"
+
+// Define the size of every batch of log messages, in bytes
+#define BATCH_SIZE          (64 * 1024)
+
+// Define the maximum number of pieces (color, log message, trailer) of a batch, within the IOV_MAX of Linux
+#define BATCH_MAX_PARTS     1024
+
+// batch of log messages gathered by the writer thread during a burst, and submitted with a single system call
+typedef struct {
+    char* data;                         // log messages, back to back. Colors are not copied, but referenced
+    size_t used;
+    struct iovec parts[BATCH_MAX_PARTS];
+    int count;
+    size_t bytes;                       // total length of 'parts'
+    int fd;
+} log_batch_t;
+
+#ifdef LOG4EMBEDDED_HAVE_IO_URING
+// io_uring instance, driven with raw system calls: one writev request in flight at a time
+typedef struct {
+    int fd;
+    void* sq_ring;
+    size_t sq_ring_size;
+    void* cq_ring;
+    size_t cq_ring_size;
+    struct io_uring_sqe* sqes;
+    size_t sqes_size;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_cqe* cqes;
+} log_uring_t;
+#endif
+
+// attributes of the batched writes. Everything but 'batching' is protected by the lock of the log output
+typedef struct {
+    LOG_IO_STRATEGY strategy;           // read atomically by log_get_io_strategy
+    log_batch_t batches[2];             // one is filled while the other one is written by io_uring
+    int current;
+    int in_flight;                      // batch submitted to io_uring and not completed yet, -1 if none
+#ifdef LOG4EMBEDDED_HAVE_IO_URING
+    log_uring_t uring;
+#endif
+} log_batches_t;
+
+static log_batches_t log_batches = {.strategy = LOG_IO_WRITE,
+                                    .current = 0,
+                                    .in_flight = -1,
+#ifdef LOG4EMBEDDED_HAVE_IO_URING
+                                    .uring = {.fd = -1}
+#endif
+                                    };
+
+// whether the calling thread is within a burst: only the writer thread gathers log messages
+static __thread bool batching = false;
+
+
+/**
+ * @brief Write all the pieces of a batch into 'fd' with as few writev() calls as possible, skipping the first
+ *        'done' bytes, already written
+ *
+ * @param fd
+ * @param parts
+ * @param count
+ * @param done
+ */
+static void write_parts(int fd, struct iovec* parts, int count, size_t done)
+{
+    for (;;)
+    {
+        while (count > 0 && done >= parts->iov_len)
+        {
+            done -= parts->iov_len;
+            parts++;
+            count--;
+        }
+
+        if (count == 0)
+            return;
+
+        // a partially written piece is resumed where it was left
+        parts->iov_base = (char*)parts->iov_base + done;
+        parts->iov_len -= done;
+
+        ssize_t ret = writev(fd, parts, count);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+            {
+                done = 0;
+                continue;
+            }
+            return;
+        }
+        done = (size_t)ret;
+    }
+}
+
+/**
+ * @brief Empty a batch, so that it can be filled again
+ *
+ * @param batch
+ */
+static void reset_batch(log_batch_t* batch)
+{
+    batch->used = 0;
+    batch->count = 0;
+    batch->bytes = 0;
+}
+
+#ifdef LOG4EMBEDDED_HAVE_IO_URING
+/**
+ * @brief Set up the io_uring instance. It needs writes at the current file position (Linux 5.6)
+ *
+ * @return true if io_uring can be used
+ */
+static bool open_uring()
+{
+    log_uring_t* ring = &log_batches.uring;
+    struct io_uring_params params;
+
+    memset(&params, 0, sizeof(params));
+    ring->fd = (int)syscall(__NR_io_uring_setup, 2, &params);
+    if (ring->fd < 0)
+        return false;
+
+    if (!(params.features & IORING_FEAT_RW_CUR_POS))
+    {
+        close(ring->fd);
+        ring->fd = -1;
+        return false;
+    }
+
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if (ring->cq_ring_size > ring->sq_ring_size)
+            ring->sq_ring_size = ring->cq_ring_size;
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    ring->cq_ring = (params.features & IORING_FEAT_SINGLE_MMAP) ? ring->sq_ring :
+                    mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+
+    if (ring->sq_ring == MAP_FAILED || ring->cq_ring == MAP_FAILED || ring->sqes == MAP_FAILED)
+    {
+        if (ring->sq_ring != MAP_FAILED)
+            munmap(ring->sq_ring, ring->sq_ring_size);
+        if (ring->cq_ring != MAP_FAILED && ring->cq_ring != ring->sq_ring)
+            munmap(ring->cq_ring, ring->cq_ring_size);
+        if (ring->sqes != MAP_FAILED)
+            munmap(ring->sqes, ring->sqes_size);
+        close(ring->fd);
+        ring->fd = -1;
+        return false;
+    }
+
+    ring->sq_tail = (unsigned*)((char*)ring->sq_ring + params.sq_off.tail);
+    ring->sq_mask = (unsigned*)((char*)ring->sq_ring + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*)((char*)ring->sq_ring + params.sq_off.array);
+    ring->cq_head = (unsigned*)((char*)ring->cq_ring + params.cq_off.head);
+    ring->cq_tail = (unsigned*)((char*)ring->cq_ring + params.cq_off.tail);
+    ring->cq_mask = (unsigned*)((char*)ring->cq_ring + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)((char*)ring->cq_ring + params.cq_off.cqes);
+    return true;
+}
+
+/**
+ * @brief Release the io_uring instance, if any
+ *
+ */
+static void close_uring()
+{
+    log_uring_t* ring = &log_batches.uring;
+
+    if (ring->fd < 0)
+        return;
+
+    munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring != ring->sq_ring)
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    munmap(ring->sq_ring, ring->sq_ring_size);
+    close(ring->fd);
+    ring->fd = -1;
+}
+
+/**
+ * @brief Hand a batch over to io_uring as a single writev request, with no waiting for it
+ *
+ * @param batch
+ * @return true if submitted
+ */
+static bool submit_uring(log_batch_t* batch)
+{
+    log_uring_t* ring = &log_batches.uring;
+    unsigned tail = *ring->sq_tail;
+    unsigned index = tail & *ring->sq_mask;
+    struct io_uring_sqe* sqe = &ring->sqes[index];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_WRITEV;
+    sqe->fd = batch->fd;
+    sqe->addr = (uint64_t)(uintptr_t)batch->parts;
+    sqe->len = (uint32_t)batch->count;
+    sqe->off = (uint64_t)-1;            // at the current file position, as write() does
+    sqe->user_data = (uint64_t)(batch - log_batches.batches);
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    while (syscall(__NR_io_uring_enter, ring->fd, 1, 0, 0, NULL, 0) < 0)
+    {
+        if (errno != EINTR)
+        {
+            // take the request back: the batch is written synchronously instead
+            __atomic_store_n(ring->sq_tail, tail, __ATOMIC_RELEASE);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Wait for the batch in flight, if any, and finish it with writev() if io_uring wrote it partially
+ *
+ */
+static void wait_uring()
+{
+    log_uring_t* ring = &log_batches.uring;
+    log_batch_t* batch;
+    unsigned head;
+    int result;
+
+    if (log_batches.in_flight < 0)
+        return;
+
+    head = *ring->cq_head;
+    while (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+    {
+        if (syscall(__NR_io_uring_enter, ring->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno != EINTR)
+            break;
+    }
+
+    batch = &log_batches.batches[log_batches.in_flight];
+    result = -1;
+    if (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+    {
+        result = ring->cqes[head & *ring->cq_mask].res;
+        __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+    }
+
+    if (result < 0 || (size_t)result < batch->bytes)
+        write_parts(batch->fd, batch->parts, batch->count, result < 0 ? 0 : (size_t)result);
+
+    reset_batch(batch);
+    log_batches.in_flight = -1;
+}
+#endif
+
+
+LOG_IO_STRATEGY log_internal_batch_set_strategy(LOG_IO_STRATEGY strategy)
+{
+    log_internal_batch_flush();
+
+#ifdef LOG4EMBEDDED_HAVE_IO_URING
+    if (strategy == LOG_IO_URING && log_batches.uring.fd < 0 && !open_uring())
+        strategy = LOG_IO_WRITEV;
+    if (strategy != LOG_IO_URING)
+        close_uring();
+#else
+    // no io_uring support: fall back to writev
+    if (strategy == LOG_IO_URING)
+        strategy = LOG_IO_WRITEV;
+#endif
+
+    __atomic_store_n(&log_batches.strategy, strategy, __ATOMIC_RELAXED);
+    return strategy;
+}
+
+LOG_IO_STRATEGY log_internal_batch_strategy()
+{
+    return __atomic_load_n(&log_batches.strategy, __ATOMIC_RELAXED);
+}
+
+void log_internal_batch_begin()
+{
+    batching = true;
+}
+
+void log_internal_batch_end()
+{
+    log_internal_batch_submit();
+    batching = false;
+}
+
+bool log_internal_batch_gathering()
+{
+    return batching && log_batches.strategy != LOG_IO_WRITE;
+}
+
+bool log_internal_batch_add(int fd, const char* color, const char* line, size_t length, const char* trailer)
+{
+    log_batch_t* batch = &log_batches.batches[log_batches.current];
+    size_t color_length = strlen(color);
+    size_t trailer_length = strlen(trailer);
+
+    if (!batching || log_batches.strategy == LOG_IO_WRITE)
+        return false;
+
+    if (batch->count > 0 && (batch->fd != fd || batch->count + 3 > BATCH_MAX_PARTS || batch->used + length > BATCH_SIZE))
+    {
+        log_internal_batch_submit();
+        batch = &log_batches.batches[log_batches.current];
+    }
+
+    if (!batch->data && !(batch->data = malloc(BATCH_SIZE)))
+        return false;
+
+    // log messages longer than a batch are written as usual, after the pending ones
+    if (length > BATCH_SIZE)
+    {
+        log_internal_batch_flush();
+        return false;
+    }
+
+    batch->fd = fd;
+    memcpy(batch->data + batch->used, line, length);
+
+    if (color_length > 0)
+        batch->parts[batch->count++] = (struct iovec){.iov_base = (void*)color, .iov_len = color_length};
+    batch->parts[batch->count++] = (struct iovec){.iov_base = batch->data + batch->used, .iov_len = length};
+    if (trailer_length > 0)
+        batch->parts[batch->count++] = (struct iovec){.iov_base = (void*)trailer, .iov_len = trailer_length};
+
+    batch->used += length;
+    batch->bytes += color_length + length + trailer_length;
+    return true;
+}
+
+void log_internal_batch_submit()
+{
+    log_batch_t* batch = &log_batches.batches[log_batches.current];
+
+    if (batch->count == 0)
+        return;
+
+    // a batch written stands for the flushes of the LOG_FLUSH_POLICY, which it bypasses
+    log_internal_stats_add(LOG_STAT_FLUSHES, 1);
+
+#ifdef LOG4EMBEDDED_HAVE_IO_URING
+    // one request in flight at a time, so that log messages reach the log output in order
+    if (log_batches.strategy == LOG_IO_URING && log_batches.uring.fd >= 0)
+    {
+        wait_uring();
+        if (submit_uring(batch))
+        {
+            log_batches.in_flight = log_batches.current;
+            log_batches.current ^= 1;
+            return;
+        }
+    }
+#endif
+
+    write_parts(batch->fd, batch->parts, batch->count, 0);
+    reset_batch(batch);
+}
+
+void log_internal_batch_flush()
+{
+    log_internal_batch_submit();
+#ifdef LOG4EMBEDDED_HAVE_IO_URING
+    wait_uring();
+#endif
+}
+
+void log_internal_batch_close()
+{
+    log_internal_batch_flush();
+
+    for (int i = 0; i < 2; ++i)
+    {
+        free(log_batches.batches[i].data);
+        log_batches.batches[i].data = NULL;
+    }
+}
@@ -0,0 +1,501 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "log4embedded.h"
+#include "log4embedded_internal.h"
+
+// Define the size of the write buffer of the binary log file
+#define BINARY_BUFFER_SIZE      4096
+
+// Define the maximum size of the arguments of a log message, as captured and as packed
+#define BINARY_ARGS_SIZE        1024
+
+// Define the maximum size of a varint
+#define MAX_VARINT_SIZE         10
+
+// Define the maximum size of a file header: magic, version and time base
+#define MAX_FILE_HEADER_SIZE    (sizeof(LOG4EMBEDDED_BINARY_MAGIC) - 1 + 1 + 2 * MAX_VARINT_SIZE)
+
+// Define the initial number of entries of the format string table
+#define MIN_TABLE_SIZE          64
+
+// Define the FNV-1a hash constants
+#define FNV_OFFSET_BASIS    0xcbf29ce484222325ULL
+#define FNV_PRIME           0x100000001b3ULL
+
+// one entry of the format string table. Format strings are found by address, and their contents checked by hash,
+// as a buffer reused for another format string keeps its address
+typedef struct {
+    const char* fmt;
+    uint64_t hash;
+    uint32_t id;
+} log_format_entry_t;
+
+// attributes of the binary sink
+typedef struct {
+    bool active;                        // whether the sink is in use, read on every print call
+    int fd;
+    char file_name[LOG4EMBEDDED_MAX_PATH_SIZE];
+    uint8_t buffer[BINARY_BUFFER_SIZE];
+    size_t buffer_used;
+    size_t file_bytes;                  // bytes written into the binary log file so far, buffered ones included
+    struct timespec last_timestamp;     // of the last record, as timestamps are stored as deltas
+    log_format_entry_t* formats;        // open addressing hash table, emptied for every new file
+    size_t formats_size;
+    uint32_t formats_count;             // entries of the table
+    uint32_t next_id;                   // IDs of format strings written into the file so far
+    unsigned long segment_count;        // gives every rotated file a unique name until the rotation thread takes it
+    pthread_mutex_t lock;
+} log_binary_t;
+
+static log_binary_t log_binary = {.active = false,
+                                  .fd = -1,
+                                  .buffer_used = 0,
+                                  .formats = NULL,
+                                  .formats_size = 0,
+                                  .formats_count = 0,
+                                  .next_id = 0,
+                                  .segment_count = 0,
+                                  .lock = PTHREAD_MUTEX_INITIALIZER};
+
+// format string of the log messages stored as rendered text, instead of packed arguments
+static const char text_fmt[] = "%s";
+
+
+/**
+ * @brief Write the whole buffer into the binary log file. 'log_binary.lock' must be held.
+ *
+ */
+static void flush_buffer()
+{
+    size_t written = 0;
+
+    while (written < log_binary.buffer_used)
+    {
+        ssize_t ret = write(log_binary.fd, log_binary.buffer + written, log_binary.buffer_used - written);
+        if (ret <= 0)
+            break;
+        written += (size_t)ret;
+    }
+
+    log_binary.buffer_used = 0;
+}
+
+/**
+ * @brief Append bytes to the write buffer, flushing it first if there is no room. 'log_binary.lock' must be held.
+ *
+ * @param data
+ * @param length
+ */
+static void append(const uint8_t* data, size_t length)
+{
+    if (log_binary.buffer_used + length > sizeof(log_binary.buffer))
+        flush_buffer();
+
+    // records never get larger than the buffer, so a flush always makes room
+    memcpy(log_binary.buffer + log_binary.buffer_used, data, length);
+    log_binary.buffer_used += length;
+    log_binary.file_bytes += length;
+}
+
+/**
+ * @brief Empty the format string table, so that format strings are written again in the next file.
+ *        'log_binary.lock' must be held.
+ *
+ */
+static void reset_formats()
+{
+    if (log_binary.formats)
+        memset(log_binary.formats, 0, log_binary.formats_size * sizeof(log_format_entry_t));
+    log_binary.formats_count = 0;
+    log_binary.next_id = 0;
+}
+
+/**
+ * @brief Slot of a format string in a table of 'size' entries (a power of two), from its address
+ *
+ * @param fmt
+ * @param size
+ * @return size_t
+ */
+static size_t format_slot(const char* fmt, size_t size)
+{
+    return (size_t)(((uint64_t)(uintptr_t)fmt * 0x9E3779B97F4A7C15ULL) >> 32) & (size - 1);
+}
+
+/**
+ * @brief FNV-1a hash of the contents of a format string, along with its length, in a single pass
+ *
+ * @param fmt
+ * @param length
+ * @return uint64_t
+ */
+static uint64_t format_hash(const char* fmt, size_t* length)
+{
+    uint64_t hash = FNV_OFFSET_BASIS;
+    const unsigned char* p = (const unsigned char*)fmt;
+
+    for (; *p; ++p)
+    {
+        hash ^= *p;
+        hash *= FNV_PRIME;
+    }
+    *length = (size_t)(p - (const unsigned char*)fmt);
+    return hash;
+}
+
+/**
+ * @brief Look up the ID of a format string, adding it to the table if it is not there yet, or if the format string
+ *        at that address changed since: it gets a new ID then. 'log_binary.lock' must be held.
+ *
+ * @param fmt
+ * @param hash hash of the contents of 'fmt', as given by format_hash
+ * @param id
+ * @return true if the format string was just added, so that it must be written into the file
+ */
+static bool format_id(const char* fmt, uint64_t hash, uint32_t* id)
+{
+    size_t mask;
+    size_t slot;
+
+    // keep the table at most half full
+    if ((log_binary.formats_count + 1) * 2 > log_binary.formats_size)
+    {
+        size_t new_size = log_binary.formats_size ? log_binary.formats_size * 2 : MIN_TABLE_SIZE;
+        log_format_entry_t* new_formats = calloc(new_size, sizeof(log_format_entry_t));
+
+        if (new_formats)
+        {
+            for (size_t i = 0; i < log_binary.formats_size; ++i)
+            {
+                if (!log_binary.formats[i].fmt)
+                    continue;
+                slot = format_slot(log_binary.formats[i].fmt, new_size);
+                while (new_formats[slot].fmt)
+                    slot = (slot + 1) & (new_size - 1);
+                new_formats[slot] = log_binary.formats[i];
+            }
+            free(log_binary.formats);
+            log_binary.formats = new_formats;
+            log_binary.formats_size = new_size;
+        }
+        else if (!log_binary.formats || log_binary.formats_count + 1 >= log_binary.formats_size)
+        {
+            // no memory: the format string is written along with this log message, every time
+            *id = log_binary.next_id++;
+            return true;
+        }
+    }
+
+    mask = log_binary.formats_size - 1;
+    slot = format_slot(fmt, log_binary.formats_size);
+    while (log_binary.formats[slot].fmt)
+    {
+        if (log_binary.formats[slot].fmt == fmt)
+        {
+            if (log_binary.formats[slot].hash == hash)
+            {
+                *id = log_binary.formats[slot].id;
+                return false;
+            }
+
+            // same buffer, other contents: the entry takes a new ID, written along with this log message
+            break;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    if (!log_binary.formats[slot].fmt)
+        log_binary.formats_count++;
+    log_binary.formats[slot].fmt = fmt;
+    log_binary.formats[slot].hash = hash;
+    log_binary.formats[slot].id = log_binary.next_id++;
+    *id = log_binary.formats[slot].id;
+    return true;
+}
+
+/**
+ * @brief Open the binary log file and write a file header. 'log_binary.lock' must be held.
+ *
+ * @return true on success
+ */
+static bool open_file()
+{
+    uint8_t header[MAX_FILE_HEADER_SIZE];
+    struct stat file_stat;
+    size_t len = 0;
+
+    log_binary.fd = open(log_binary.file_name, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (log_binary.fd < 0)
+        return false;
+
+    log_binary.buffer_used = 0;
+    log_binary.file_bytes = (fstat(log_binary.fd, &file_stat) == 0) ? (size_t)file_stat.st_size : 0;
+    reset_formats();
+
+    // records appended to an existing file start with a header too, with a new time base and format string table
+    log_internal_now(&log_binary.last_timestamp);
+    memcpy(header, LOG4EMBEDDED_BINARY_MAGIC, sizeof(LOG4EMBEDDED_BINARY_MAGIC) - 1);
+    len += sizeof(LOG4EMBEDDED_BINARY_MAGIC) - 1;
+    header[len++] = LOG4EMBEDDED_BINARY_VERSION;
+    len += log_internal_put_varint(header + len, (uint64_t)log_binary.last_timestamp.tv_sec);
+    len += log_internal_put_varint(header + len, (uint64_t)(log_binary.last_timestamp.tv_nsec / 1000));
+    append(header, len);
+    return true;
+}
+
+/**
+ * @brief Flush and close the binary log file. 'log_binary.lock' must be held.
+ *
+ */
+static void close_file()
+{
+    if (log_binary.fd < 0)
+        return;
+
+    flush_buffer();
+    close(log_binary.fd);
+    log_binary.fd = -1;
+}
+
+/**
+ * @brief Rotate the binary log file, as set by log_set_rotation, and start a new one with its own header and
+ *        format string table. 'log_binary.lock' must be held.
+ *
+ * @param max_files
+ * @param compression
+ */
+static void rotate_file(unsigned int max_files, LOG_COMPRESSION compression)
+{
+    char segment_name[LOG4EMBEDDED_MAX_PATH_SIZE + 32];
+
+    close_file();
+
+    snprintf(segment_name, sizeof(segment_name), "%s.%lu.rotating", log_binary.file_name, log_binary.segment_count++);
+    if (rename(log_binary.file_name, segment_name) == 0)
+        log_internal_rotate_submit(log_binary.file_name, segment_name, max_files, compression);
+
+    // on failure, the sink is closed and log messages go back to the regular output
+    if (!open_file())
+        __atomic_store_n(&log_binary.active, false, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Capture the arguments of 'fmt' into 'out', with a variable argument list
+ *
+ * @return true on success
+ */
+static bool capture_text(uint8_t* out, size_t out_size, size_t* captured, const char* fmt, ...)
+{
+    va_list args;
+    bool ok;
+
+    va_start(args, fmt);
+    ok = log_internal_capture_args(out, out_size, captured, fmt, args);
+    va_end(args);
+    return ok;
+}
+
+
+/**
+ * @brief Append one log message to the binary log file, as packed arguments of 'fmt'
+ *
+ * @return true if it was written
+ */
+static bool write_packed(LOG_MSG_CATEGORY category, const char* fmt, const uint8_t* packed, size_t packed_size)
+{
+    uint8_t record[1 + 3 * MAX_VARINT_SIZE];
+    size_t record_len = 0;
+    struct timespec timestamp;
+    size_t max_file_size;
+    unsigned int max_files;
+    LOG_COMPRESSION compression;
+    uint32_t id;
+    size_t fmt_len;
+    uint64_t hash;
+
+    // the format string is scanned before taking the lock, so that writers do not wait for each other's scan
+    hash = format_hash(fmt, &fmt_len);
+    log_internal_now(&timestamp);
+    log_internal_rotation_settings(&max_file_size, &max_files, &compression);
+
+    pthread_mutex_lock(&log_binary.lock);
+    if (log_binary.fd < 0)
+    {
+        pthread_mutex_unlock(&log_binary.lock);
+        return false;
+    }
+
+    // a counter comparison, as for text log files. The format string is accounted for, just in case
+    if (max_file_size > 0 && log_binary.file_bytes > MAX_FILE_HEADER_SIZE &&
+        log_binary.file_bytes + 4 * MAX_VARINT_SIZE + fmt_len + packed_size > max_file_size)
+    {
+        rotate_file(max_files, compression);
+        if (log_binary.fd < 0)
+        {
+            pthread_mutex_unlock(&log_binary.lock);
+            return false;
+        }
+    }
+
+    if (format_id(fmt, hash, &id))
+    {
+        uint8_t definition[1 + 2 * MAX_VARINT_SIZE];
+        size_t definition_len = 0;
+
+        // format strings longer than the write buffer are cut, as records must fit in it
+        if (fmt_len > sizeof(log_binary.buffer) - sizeof(definition))
+            fmt_len = sizeof(log_binary.buffer) - sizeof(definition);
+
+        definition[definition_len++] = LOG4EMBEDDED_BINARY_FORMAT;
+        definition_len += log_internal_put_varint(definition + definition_len, id);
+        definition_len += log_internal_put_varint(definition + definition_len, fmt_len);
+        append(definition, definition_len);
+        append((const uint8_t*)fmt, fmt_len);
+    }
+
+    // timestamps are taken out of the lock, so they may go slightly backwards: signed delta
+    int64_t delta_us = (int64_t)(timestamp.tv_sec - log_binary.last_timestamp.tv_sec) * 1000000 +
+                       (timestamp.tv_nsec - log_binary.last_timestamp.tv_nsec) / 1000;
+    log_binary.last_timestamp = timestamp;
+
+    record[record_len++] = (uint8_t)category;
+    record_len += log_internal_put_varint(record + record_len, ((uint64_t)delta_us << 1) ^ (uint64_t)(delta_us >> 63));
+    record_len += log_internal_put_varint(record + record_len, id);
+    record_len += log_internal_put_varint(record + record_len, packed_size);
+    append(record, record_len);
+    append(packed, packed_size);
+    log_internal_stats_add(LOG_STAT_BYTES, record_len + packed_size);
+
+    // same as LOG_FLUSH_ON_ERROR: records are only flushed once the buffer is full, or for critical and error messages
+    if (category == LOG_MSG_CRIT || category == LOG_MSG_ERR)
+        flush_buffer();
+
+    pthread_mutex_unlock(&log_binary.lock);
+    return true;
+}
+
+
+bool log_internal_binary_enabled()
+{
+    return __atomic_load_n(&log_binary.active, __ATOMIC_RELAXED);
+}
+
+bool log_internal_binary_write(LOG_MSG_CATEGORY category, const char* fmt, va_list args)
+{
+    uint8_t captured[BINARY_ARGS_SIZE];
+    size_t captured_size = 0;
+    va_list capture_args;
+
+    if (!log_internal_binary_enabled())
+        return false;
+
+    // no text formatting: only the arguments are captured, and packed
+    va_copy(capture_args, args);
+    bool ok = log_internal_capture_args(captured, sizeof(captured), &captured_size, fmt, capture_args);
+    va_end(capture_args);
+
+    // arguments which cannot be captured: the log message is rendered and stored as a string
+    if (!ok)
+    {
+        char text[BINARY_ARGS_SIZE / 2];
+        va_list text_args;
+
+        va_copy(text_args, args);
+        vsnprintf(text, sizeof(text), fmt, text_args);
+        va_end(text_args);
+
+        fmt = text_fmt;
+        captured_size = 0;
+        capture_text(captured, sizeof(captured), &captured_size, fmt, text);
+    }
+
+    return log_internal_binary_write_captured(category, fmt, captured, captured_size);
+}
+
+bool log_internal_binary_write_line(LOG_MSG_CATEGORY category, const char* line)
+{
+    uint8_t captured[BINARY_ARGS_SIZE];
+    size_t captured_size = 0;
+
+    if (!log_internal_binary_enabled())
+        return false;
+
+    // no format string to refer to: the line is stored as a string, cut to fit if too long
+    capture_text(captured, sizeof(captured), &captured_size, text_fmt, line);
+    return log_internal_binary_write_captured(category, text_fmt, captured, captured_size);
+}
+
+bool log_internal_binary_write_captured(LOG_MSG_CATEGORY category, const char* fmt, const uint8_t* captured,
+                                        size_t captured_size)
+{
+    uint8_t packed[BINARY_ARGS_SIZE + BINARY_ARGS_SIZE / 2];
+    uint8_t text_args[BINARY_ARGS_SIZE];
+    size_t packed_size;
+
+    if (!log_internal_binary_enabled())
+        return false;
+
+    packed_size = log_internal_pack_args(packed, sizeof(packed), captured, captured_size);
+
+    // arguments too long: the log message is rendered and stored as a string
+    if (captured_size > 0 && packed_size == 0)
+    {
+        char text[BINARY_ARGS_SIZE / 2];
+        size_t text_size = 0;
+
+        log_internal_render_args(text, sizeof(text), fmt, captured, captured_size);
+        fmt = text_fmt;
+        packed_size = 0;
+        if (capture_text(text_args, sizeof(text_args), &text_size, fmt, text))
+            packed_size = log_internal_pack_args(packed, sizeof(packed), text_args, text_size);
+    }
+
+    return write_packed(category, fmt, packed, packed_size);
+}
+
+int log_internal_binary_open(const char* filepath)
+{
+    log_internal_binary_close();
+
+    pthread_mutex_lock(&log_binary.lock);
+    snprintf(log_binary.file_name, sizeof(log_binary.file_name), "%s", filepath);
+    if (!open_file())
+    {
+        pthread_mutex_unlock(&log_binary.lock);
+        return -1;
+    }
+    __atomic_store_n(&log_binary.active, true, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&log_binary.lock);
+
+    return 0;
+}
+
+void log_internal_binary_flush()
+{
+    pthread_mutex_lock(&log_binary.lock);
+    if (log_binary.fd >= 0)
+        flush_buffer();
+    pthread_mutex_unlock(&log_binary.lock);
+}
+
+void log_internal_binary_close()
+{
+    pthread_mutex_lock(&log_binary.lock);
+    __atomic_store_n(&log_binary.active, false, __ATOMIC_RELAXED);
+    close_file();
+    free(log_binary.formats);
+    log_binary.formats = NULL;
+    log_binary.formats_size = 0;
+    log_binary.formats_count = 0;
+    log_binary.next_id = 0;
+    pthread_mutex_unlock(&log_binary.lock);
+}
@@ -0,0 +1,748 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+
+#include "log4embedded.h"
+#include "log4embedded_internal.h"
+
+// Define the maximum size of a line of the configuration file
+#define MAX_CONFIG_LINE_SIZE    512
+
+// Define the size of the buffer inotify events are read into
+#define EVENT_BUFFER_SIZE       4096
+
+// Define the separators between the words of a key
+#define KEY_SEPARATORS          " \t"
+
+/*
+    Enum LOG_CONFIG_SINK_TYPE: Define the sinks a configuration file may add.
+*/
+typedef enum {
+    LOG_CONFIG_SINK_FILE = 0,   // "sink file <path> = <level>", see 'log_add_file_sink'
+    LOG_CONFIG_SINK_UDP,        // "sink udp <host>:<port> = <level>", see 'log_add_udp_sink'
+    LOG_CONFIG_SINK_SYSLOG      // "sink syslog <ident> = <level>", see 'log_add_syslog_sink'
+} LOG_CONFIG_SINK_TYPE;
+
+// sink added by the configuration file
+typedef struct {
+    LOG_CONFIG_SINK_TYPE type;
+    char target[LOG4EMBEDDED_MAX_PATH_SIZE];    // path, "host:port" or ident
+    LOG_MSG_CATEGORY level;
+} log_config_sink_t;
+
+// settings read from a configuration file. Never modified once parsed: a reload parses a new one, and swaps them
+typedef struct {
+    bool has_level;
+    LOG_MSG_CATEGORY level;
+
+    bool has_file;
+    char file_name[LOG4EMBEDDED_MAX_PATH_SIZE];
+
+    bool has_flush;
+    LOG_FLUSH_POLICY flush_policy;
+    size_t flush_size_threshold;
+    unsigned int flush_time_threshold_ms;
+
+    bool has_rotation;
+    size_t rotation_max_size;
+    unsigned int rotation_max_files;
+    LOG_ROTATION_INTERVAL rotation_interval;
+    LOG_COMPRESSION rotation_compression;
+
+    size_t module_count;
+    struct {
+        char pattern[LOG_MAX_MODULE_NAME];
+        LOG_MSG_CATEGORY level;
+    } modules[LOG_MAX_MODULE_LEVELS];
+
+    bool has_sink_level[LOG_MAX_SINKS + 1];     // levels of sinks added by the application, per ID. "sink 0" sets 'level'
+    LOG_MSG_CATEGORY sink_levels[LOG_MAX_SINKS + 1];
+
+    size_t sink_count;
+    log_config_sink_t sinks[LOG_MAX_SINKS];
+} log_config_snapshot_t;
+
+// attributes of the configuration file
+typedef struct {
+    log_config_snapshot_t* current;             // applied snapshot, NULL if none
+    int sink_ids[LOG_MAX_SINKS];                // IDs of the sinks added for current->sinks
+    char* sink_idents[LOG_MAX_SINKS];           // syslog idents, which must outlive their sink
+
+    char file_name[LOG4EMBEDDED_MAX_PATH_SIZE];
+    bool running;
+    bool owned_sinks_closed;                    // 'log_close' has removed every sink already
+    int inotify_fd;
+    int stop_fd;
+    pthread_t watcher;
+    pthread_mutex_t lock;                       // serializes loads, which only the watcher thread does at runtime
+} log_config_state_t;
+
+static log_config_state_t log_config = {.current = NULL,
+                                        .running = false,
+                                        .owned_sinks_closed = false,
+                                        .inotify_fd = -1,
+                                        .stop_fd = -1,
+                                        .lock = PTHREAD_MUTEX_INITIALIZER};
+
+
+/**
+ * @brief Remove blanks at both ends of 'text', in place
+ *
+ * @param text
+ * @return char* first character which is not blank
+ */
+static char* trim(char* text)
+{
+    char* end = text + strlen(text);
+
+    while (isspace((unsigned char)*text))
+        text++;
+    while (end > text && isspace((unsigned char)end[-1]))
+        *--end = '\0';
+
+    return text;
+}
+
+/**
+ * @brief Parse a level name: none, crit, err, warn, info or debug (also critical, error, warning and dbg)
+ *
+ * @param text
+ * @param level
+ * @return true if valid
+ */
+static bool parse_level(const char* text, LOG_MSG_CATEGORY* level)
+{
+    static const struct {
+        const char* name;
+        LOG_MSG_CATEGORY level;
+    } names[] = {{"none", LOG_MSG_NONE}, {"crit", LOG_MSG_CRIT}, {"critical", LOG_MSG_CRIT}, {"err", LOG_MSG_ERR},
+                 {"error", LOG_MSG_ERR}, {"warn", LOG_MSG_WARN}, {"warning", LOG_MSG_WARN}, {"info", LOG_MSG_INFO},
+                 {"debug", LOG_MSG_DBG}, {"dbg", LOG_MSG_DBG}};
+
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i)
+    {
+        if (strcasecmp(text, names[i].name) == 0)
+        {
+            *level = names[i].level;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Parse a size, in bytes, with an optional K, M or G suffix
+ *
+ * @param text
+ * @param end set to the first character after the size
+ * @param size
+ * @return true if valid
+ */
+static bool parse_size(const char* text, char** end, size_t* size)
+{
+    unsigned long long value;
+
+    if (!isdigit((unsigned char)*text))
+        return false;
+
+    errno = 0;
+    value = strtoull(text, end, 10);
+    if (errno != 0)
+        return false;
+
+    switch(toupper((unsigned char)**end))
+    {
+        case 'K': value <<= 10; (*end)++; break;
+        case 'M': value <<= 20; (*end)++; break;
+        case 'G': value <<= 30; (*end)++; break;
+        default: break;
+    }
+
+    *size = (size_t)value;
+    return **end == '\0' || isspace((unsigned char)**end);
+}
+
+/**
+ * @brief Parse "flush = every_line | on_error | threshold <bytes> <ms>"
+ *
+ * @param value
+ * @param config
+ * @return true if valid
+ */
+static bool parse_flush(char* value, log_config_snapshot_t* config)
+{
+    char* save = NULL;
+    char* policy = strtok_r(value, KEY_SEPARATORS, &save);
+    char* size = strtok_r(NULL, KEY_SEPARATORS, &save);
+    char* ms = strtok_r(NULL, KEY_SEPARATORS, &save);
+    char* end;
+    size_t time_threshold;
+
+    if (!policy || strtok_r(NULL, KEY_SEPARATORS, &save))
+        return false;
+
+    config->has_flush = true;
+    config->flush_size_threshold = 0;
+    config->flush_time_threshold_ms = 0;
+
+    if (strcasecmp(policy, "every_line") == 0 && !size)
+        config->flush_policy = LOG_FLUSH_EVERY_LINE;
+    else if (strcasecmp(policy, "on_error") == 0 && !size)
+        config->flush_policy = LOG_FLUSH_ON_ERROR;
+    else if (strcasecmp(policy, "threshold") == 0 && size && ms &&
+             parse_size(size, &end, &config->flush_size_threshold) && parse_size(ms, &end, &time_threshold))
+    {
+        config->flush_policy = LOG_FLUSH_ON_THRESHOLD;
+        config->flush_time_threshold_ms = (unsigned int)time_threshold;
+    }
+    else
+        return false;
+
+    return true;
+}
+
+/**
+ * @brief Parse "rotation = off | <max_bytes> <max_files> [daily] [gzip]"
+ *
+ * @param value
+ * @param config
+ * @return true if valid
+ */
+static bool parse_rotation(char* value, log_config_snapshot_t* config)
+{
+    char* save = NULL;
+    char* word = strtok_r(value, KEY_SEPARATORS, &save);
+    char* end;
+    size_t max_files;
+
+    if (!word)
+        return false;
+
+    config->has_rotation = true;
+    config->rotation_max_size = 0;
+    config->rotation_max_files = 1;
+    config->rotation_interval = LOG_ROTATE_NEVER;
+    config->rotation_compression = LOG_COMPRESS_NONE;
+
+    if (strcasecmp(word, "off") == 0)
+        return !strtok_r(NULL, KEY_SEPARATORS, &save);
+
+    if (!parse_size(word, &end, &config->rotation_max_size) || !(word = strtok_r(NULL, KEY_SEPARATORS, &save)) ||
+        !parse_size(word, &end, &max_files) || max_files == 0)
+        return false;
+    config->rotation_max_files = (unsigned int)max_files;
+
+    while ((word = strtok_r(NULL, KEY_SEPARATORS, &save)))
+    {
+        if (strcasecmp(word, "daily") == 0)
+            config->rotation_interval = LOG_ROTATE_DAILY;
+        else if (strcasecmp(word, "gzip") == 0)
+            config->rotation_compression = LOG_COMPRESS_GZIP;
+        else
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Parse "sink <id> = <level>" for a sink added by the application, or "sink <type> <target> = <level>"
+ *        for a sink added by the configuration file
+ *
+ * @param key words after "sink"
+ * @param level
+ * @param config
+ * @return true if valid
+ */
+static bool parse_sink(char* key, LOG_MSG_CATEGORY level, log_config_snapshot_t* config)
+{
+    char* save = NULL;
+    char* type = strtok_r(key, KEY_SEPARATORS, &save);
+    char* target = type ? strtok_r(NULL, KEY_SEPARATORS, &save) : NULL;
+    log_config_sink_t* sink;
+    char* end;
+    long id;
+
+    if (!type || (target && strtok_r(NULL, KEY_SEPARATORS, &save)))
+        return false;
+
+    if (!target)
+    {
+        id = strtol(type, &end, 10);
+        if (*end != '\0' || id < LOG_SINK_DEFAULT || id > LOG_MAX_SINKS)
+            return false;
+
+        // the default sink is the log output
+        if (id == LOG_SINK_DEFAULT)
+        {
+            config->has_level = true;
+            config->level = level;
+            return true;
+        }
+
+        config->has_sink_level[id] = true;
+        config->sink_levels[id] = level;
+        return true;
+    }
+
+    if (config->sink_count == LOG_MAX_SINKS || strlen(target) >= sizeof(sink->target))
+        return false;
+
+    sink = &config->sinks[config->sink_count];
+    if (strcasecmp(type, "file") == 0)
+        sink->type = LOG_CONFIG_SINK_FILE;
+    else if (strcasecmp(type, "udp") == 0 && strrchr(target, ':'))
+        sink->type = LOG_CONFIG_SINK_UDP;
+    else if (strcasecmp(type, "syslog") == 0)
+        sink->type = LOG_CONFIG_SINK_SYSLOG;
+    else
+        return false;
+
+    strcpy(sink->target, target);
+    sink->level = level;
+    config->sink_count++;
+    return true;
+}
+
+/**
+ * @brief Parse a "key = value" line into 'config'. Blank lines and lines starting with '#' are skipped
+ *
+ * @param line
+ * @param config
+ * @return true if valid
+ */
+static bool parse_line(char* line, log_config_snapshot_t* config)
+{
+    char* separator;
+    char* key;
+    char* value;
+    LOG_MSG_CATEGORY level;
+
+    line = trim(line);
+    if (*line == '\0' || *line == '#')
+        return true;
+
+    if (!(separator = strchr(line, '=')))
+        return false;
+
+    *separator = '\0';
+    key = trim(line);
+    value = trim(separator + 1);
+
+    if (strcasecmp(key, "level") == 0)
+    {
+        config->has_level = true;
+        return parse_level(value, &config->level);
+    }
+
+    if (strcasecmp(key, "file") == 0)
+    {
+        config->has_file = true;
+        return *value != '\0' && strlen(value) < sizeof(config->file_name) &&
+               snprintf(config->file_name, sizeof(config->file_name), "%s", value) > 0;
+    }
+
+    if (strcasecmp(key, "flush") == 0)
+        return parse_flush(value, config);
+
+    if (strcasecmp(key, "rotation") == 0)
+        return parse_rotation(value, config);
+
+    if (strncasecmp(key, "module", 6) == 0 && isspace((unsigned char)key[6]))
+    {
+        char* pattern = trim(key + 6);
+
+        if (config->module_count == LOG_MAX_MODULE_LEVELS || strlen(pattern) >= LOG_MAX_MODULE_NAME ||
+            !parse_level(value, &level))
+            return false;
+
+        strcpy(config->modules[config->module_count].pattern, pattern);
+        config->modules[config->module_count].level = level;
+        config->module_count++;
+        return true;
+    }
+
+    if (strncasecmp(key, "sink", 4) == 0 && isspace((unsigned char)key[4]))
+        return parse_level(value, &level) && parse_sink(key + 4, level, config);
+
+    return false;
+}
+
+/**
+ * @brief Parse a configuration file into a new snapshot
+ *
+ * @param file_name
+ * @return log_config_snapshot_t* NULL if the file cannot be read or is not valid, which is reported as a warning
+ */
+static log_config_snapshot_t* parse_file(const char* file_name)
+{
+    char line[MAX_CONFIG_LINE_SIZE];
+    log_config_snapshot_t* config;
+    unsigned int line_number = 0;
+    FILE* file;
+
+    if (!(file = fopen(file_name, "re")))
+    {
+        log_print_warning("Config file %s cannot be read: the current configuration is kept.\n", file_name);
+        return NULL;
+    }
+
+    // zeroed, so that snapshots can be compared as a whole
+    if (!(config = calloc(1, sizeof(log_config_snapshot_t))))
+    {
+        fclose(file);
+        return NULL;
+    }
+
+    while (fgets(line, sizeof(line), file))
+    {
+        line_number++;
+        if (!strchr(line, '\n') && !feof(file))
+            break;
+
+        if (!parse_line(line, config))
+        {
+            log_print_warning("Config file %s, line %u is not valid: the current configuration is kept.\n",
+                              file_name, line_number);
+            free(config);
+            fclose(file);
+            return NULL;
+        }
+    }
+
+    if (!feof(file))
+    {
+        log_print_warning("Config file %s, line %u is too long: the current configuration is kept.\n",
+                          file_name, line_number);
+        free(config);
+        config = NULL;
+    }
+
+    fclose(file);
+    return config;
+}
+
+/**
+ * @brief Add a sink of the configuration file
+ *
+ * @param sink
+ * @param ident set to the syslog ident to free once the sink is removed, if any
+ * @return int ID of the sink, -1 on failure
+ */
+static int add_sink(const log_config_sink_t* sink, char** ident)
+{
+    log_sink_config_t config = {.level = sink->level, .colors = false, .format = LOG_SINK_FORMAT_FULL};
+    char host[LOG4EMBEDDED_MAX_PATH_SIZE];
+    char* port;
+    int id = -1;
+
+    *ident = NULL;
+
+    switch(sink->type)
+    {
+        case LOG_CONFIG_SINK_FILE:
+            id = log_add_file_sink(sink->target, strlen(sink->target) + 1, &config);
+        break;
+
+        case LOG_CONFIG_SINK_UDP:
+            snprintf(host, sizeof(host), "%s", sink->target);
+            port = strrchr(host, ':');
+            *port++ = '\0';
+            id = log_add_udp_sink(host, (unsigned short)strtoul(port, NULL, 10), &config);
+        break;
+
+        case LOG_CONFIG_SINK_SYSLOG:
+            config.format = LOG_SINK_FORMAT_MESSAGE;
+            if ((*ident = strdup(sink->target)) && (id = log_add_syslog_sink(*ident, &config)) < 0)
+            {
+                free(*ident);
+                *ident = NULL;
+            }
+        break;
+    }
+
+    if (id < 0)
+        log_print_warning("Config file: sink %s cannot be added.\n", sink->target);
+
+    return id;
+}
+
+/**
+ * @brief Bring the sinks of the configuration file from 'old' to 'new': sinks in both keep running, with their new level
+ *
+ * @param old NULL if none
+ * @param new
+ */
+static void apply_sinks(const log_config_snapshot_t* old, const log_config_snapshot_t* new)
+{
+    int sink_ids[LOG_MAX_SINKS];
+    char* sink_idents[LOG_MAX_SINKS] = {NULL};
+    size_t old_count = old ? old->sink_count : 0;
+
+    for (size_t i = 0; i < new->sink_count; ++i)
+    {
+        sink_ids[i] = -1;
+        for (size_t j = 0; j < old_count; ++j)
+        {
+            if (log_config.sink_ids[j] >= 0 && old->sinks[j].type == new->sinks[i].type &&
+                strcmp(old->sinks[j].target, new->sinks[i].target) == 0)
+            {
+                sink_ids[i] = log_config.sink_ids[j];
+                sink_idents[i] = log_config.sink_idents[j];
+                log_config.sink_ids[j] = -1;
+                log_config.sink_idents[j] = NULL;
+
+                if (old->sinks[j].level != new->sinks[i].level)
+                    log_set_sink_level(sink_ids[i], new->sinks[i].level);
+                break;
+            }
+        }
+    }
+
+    // the ones left are gone from the file
+    for (size_t j = 0; j < old_count; ++j)
+    {
+        if (log_config.sink_ids[j] >= 0)
+            log_remove_sink(log_config.sink_ids[j]);
+        free(log_config.sink_idents[j]);
+    }
+
+    for (size_t i = 0; i < new->sink_count; ++i)
+    {
+        if (sink_ids[i] < 0)
+            sink_ids[i] = add_sink(&new->sinks[i], &sink_idents[i]);
+
+        log_config.sink_ids[i] = sink_ids[i];
+        log_config.sink_idents[i] = sink_idents[i];
+    }
+}
+
+/**
+ * @brief Apply what changed from 'old' to 'new' through the usual configuration functions, each of which publishes
+ *        its setting with a single atomic store or under the lock print calls already take: print calls see either
+ *        setting, never a torn one. Settings missing from the file are left as they are, but module patterns and
+ *        sinks which the file no longer has are removed.
+ *
+ * @param old NULL if none
+ * @param new
+ */
+static void apply_snapshot(const log_config_snapshot_t* old, const log_config_snapshot_t* new)
+{
+    if (new->has_file && (!old || !old->has_file || strcmp(old->file_name, new->file_name) != 0))
+        log_set_file(new->file_name, strlen(new->file_name) + 1);
+
+    if (new->has_rotation && (!old || !old->has_rotation || old->rotation_max_size != new->rotation_max_size ||
+        old->rotation_max_files != new->rotation_max_files || old->rotation_interval != new->rotation_interval ||
+        old->rotation_compression != new->rotation_compression) &&
+        log_set_rotation(new->rotation_max_size, new->rotation_max_files, new->rotation_interval,
+                         new->rotation_compression) != 0)
+        log_print_warning("Config file: rotation is not available as set.\n");
+
+    if (new->has_flush && (!old || !old->has_flush || old->flush_policy != new->flush_policy ||
+        old->flush_size_threshold != new->flush_size_threshold || old->flush_time_threshold_ms != new->flush_time_threshold_ms))
+        log_set_flush_policy(new->flush_policy, new->flush_size_threshold, new->flush_time_threshold_ms);
+
+    for (size_t j = 0; old && j < old->module_count; ++j)
+    {
+        bool kept = false;
+
+        for (size_t i = 0; i < new->module_count && !kept; ++i)
+            kept = strcmp(old->modules[j].pattern, new->modules[i].pattern) == 0;
+        if (!kept)
+            log_remove_module_level(old->modules[j].pattern);
+    }
+    for (size_t i = 0; i < new->module_count; ++i)
+    {
+        if (log_get_module_level(new->modules[i].pattern) != new->modules[i].level &&
+            log_set_module_level(new->modules[i].pattern, new->modules[i].level) != 0)
+            log_print_warning("Config file: module pattern %s is not valid.\n", new->modules[i].pattern);
+    }
+
+    apply_sinks(old, new);
+
+    for (int id = LOG_SINK_DEFAULT + 1; id <= LOG_MAX_SINKS; ++id)
+    {
+        if (new->has_sink_level[id] && (!old || !old->has_sink_level[id] || old->sink_levels[id] != new->sink_levels[id]))
+            log_set_sink_level(id, new->sink_levels[id]);
+    }
+
+    // the level goes last, so that a more verbose one only applies once everything else is in place
+    if (new->has_level && (!old || !old->has_level || old->level != new->level))
+        log_set_level(new->level);
+}
+
+/**
+ * @brief Parse the configuration file and apply it, if valid and different from the current one
+ *
+ * @param file_name
+ * @return int 0 on success, -1 if the file is not valid
+ */
+static int load_file(const char* file_name)
+{
+    log_config_snapshot_t* config = parse_file(file_name);
+    log_config_snapshot_t* old;
+
+    if (!config)
+        return -1;
+
+    pthread_mutex_lock(&log_config.lock);
+    if (log_config.owned_sinks_closed)
+    {
+        // every sink was removed by 'log_close': start from scratch
+        free(log_config.current);
+        log_config.current = NULL;
+        log_config.owned_sinks_closed = false;
+    }
+
+    old = log_config.current;
+    if (old && memcmp(old, config, sizeof(log_config_snapshot_t)) == 0)
+    {
+        // editors save files in several steps: every one of them wakes the watcher up
+        pthread_mutex_unlock(&log_config.lock);
+        free(config);
+        return 0;
+    }
+
+    apply_snapshot(old, config);
+    __atomic_store_n(&log_config.current, config, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&log_config.lock);
+
+    free(old);
+    return 0;
+}
+
+/**
+ * @brief Thread watching the directory of the configuration file, as editors often replace files rather than write them
+ *
+ * @param arg
+ * @return void*
+ */
+static void* config_thread(void* arg)
+{
+    const char* base_name = strrchr(log_config.file_name, '/');
+    char events[EVENT_BUFFER_SIZE] __attribute__((aligned(__alignof__(struct inotify_event))));
+    struct pollfd fds[2] = {{.fd = log_config.inotify_fd, .events = POLLIN}, {.fd = log_config.stop_fd, .events = POLLIN}};
+
+    (void)arg;
+    base_name = base_name ? base_name + 1 : log_config.file_name;
+
+    for (;;)
+    {
+        bool changed = false;
+        ssize_t len;
+
+        if (poll(fds, 2, -1) < 0 && errno != EINTR)
+            break;
+        if (fds[1].revents)
+            break;
+        if (!(fds[0].revents & POLLIN) || (len = read(log_config.inotify_fd, events, sizeof(events))) <= 0)
+            continue;
+
+        for (char* p = events; p < events + len; p += sizeof(struct inotify_event) + ((struct inotify_event*)p)->len)
+        {
+            const struct inotify_event* event = (const struct inotify_event*)p;
+
+            if (event->len > 0 && strcmp(event->name, base_name) == 0)
+                changed = true;
+        }
+
+        if (changed)
+            load_file(log_config.file_name);
+    }
+
+    return NULL;
+}
+
+
+void log_internal_config_close()
+{
+    log_unwatch_config_file();
+
+    // 'log_close' removes every sink, the ones of the configuration file included
+    pthread_mutex_lock(&log_config.lock);
+    for (size_t i = 0; i < LOG_MAX_SINKS; ++i)
+    {
+        free(log_config.sink_idents[i]);
+        log_config.sink_idents[i] = NULL;
+    }
+    if (log_config.current)
+        log_config.owned_sinks_closed = true;
+    pthread_mutex_unlock(&log_config.lock);
+}
+
+
+int log_load_config_file(const char* filepath, size_t filepath_size)
+{
+    char file_name[LOG4EMBEDDED_MAX_PATH_SIZE];
+
+    if (!filepath || filepath_size == 0 || filepath_size > LOG4EMBEDDED_MAX_PATH_SIZE)
+        return -1;
+
+    snprintf(file_name, filepath_size, "%s", filepath);
+    return load_file(file_name);
+}
+
+int log_watch_config_file(const char* filepath, size_t filepath_size)
+{
+    char dir_name[LOG4EMBEDDED_MAX_PATH_SIZE];
+    char* slash;
+
+    if (!filepath || filepath_size == 0 || filepath_size > LOG4EMBEDDED_MAX_PATH_SIZE)
+        return -1;
+
+    log_unwatch_config_file();
+
+    snprintf(log_config.file_name, filepath_size, "%s", filepath);
+    snprintf(dir_name, sizeof(dir_name), "%s", log_config.file_name);
+    if (!(slash = strrchr(dir_name, '/')))
+        strcpy(dir_name, ".");
+    else if (slash == dir_name)
+        slash[1] = '\0';
+    else
+        *slash = '\0';
+
+    if (load_file(log_config.file_name) != 0)
+        return -1;
+
+    if ((log_config.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0 ||
+        inotify_add_watch(log_config.inotify_fd, dir_name, IN_CLOSE_WRITE | IN_MOVED_TO) < 0 ||
+        (log_config.stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0 ||
+        pthread_create(&log_config.watcher, NULL, config_thread, NULL) != 0)
+    {
+        if (log_config.inotify_fd >= 0)
+            close(log_config.inotify_fd);
+        if (log_config.stop_fd >= 0)
+            close(log_config.stop_fd);
+        log_config.inotify_fd = log_config.stop_fd = -1;
+        return -1;
+    }
+
+    log_config.running = true;
+    return 0;
+}
+
+void log_unwatch_config_file()
+{
+    uint64_t stop = 1;
+
+    if (!log_config.running)
+        return;
+
+    while (write(log_config.stop_fd, &stop, sizeof(stop)) < 0 && errno == EINTR)
+        ;
+    pthread_join(log_config.watcher, NULL);
+
+    close(log_config.inotify_fd);
+    close(log_config.stop_fd);
+    log_config.inotify_fd = log_config.stop_fd = -1;
+    log_config.running = false;
+}
@@ -0,0 +1,367 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "log4embedded.h"
+
+// Define the size of the output buffer of a console sink, when none is given
+#define DEFAULT_BUFFER_SIZE     16384
+
+// Define how full the output buffer may be, in percent, before debug and info messages are dropped
+#define DROP_DEBUG_PERCENT      50
+#define DROP_INFO_PERCENT       75
+
+// Define how long the writer thread waits for the console to take more bytes, in milliseconds
+#define POLL_TIMEOUT_MS         100
+
+// Define how long flushing or closing a console sink waits for the console to take the buffered bytes, in milliseconds
+#define DRAIN_TIMEOUT_MS        1000
+
+// Define the maximum size of the line reporting dropped log messages
+#define MAX_REPORT_SIZE         64
+
+// context of a console sink: a ring of bytes filled by print calls and written by its own thread
+typedef struct {
+    int fd;                             // private, non-blocking if possible, file descriptor of the console
+    bool colors;                        // whether the console is a terminal
+    char* buffer;
+    size_t size;
+    size_t head;                        // first byte not written yet
+    size_t used;
+    uint64_t dropped;                   // log messages dropped since the last report
+    bool stop_requested;
+    pthread_t writer;
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;              // there are bytes to write, or the sink is closing
+    pthread_cond_t room;                // bytes were written
+} log_console_t;
+
+
+/**
+ * @brief Open a file descriptor of its own for the terminal or pipe behind 'fd', so that non-blocking mode does not
+ *        change the one of the application (and of any other process sharing it). Anything else, such as a regular
+ *        file the output was redirected to, gets a blocking copy of 'fd' instead, sharing its offset and O_APPEND
+ *        flag, so that neither overwrites the other. Only the writer thread waits for it anyway.
+ *
+ * @param fd
+ * @return int -1 on failure
+ */
+static int open_console(int fd)
+{
+    char path[32];
+    struct stat info;
+    int console_fd = -1;
+
+    if (fstat(fd, &info) == 0 && (S_ISCHR(info.st_mode) || S_ISFIFO(info.st_mode)))
+    {
+        snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+        console_fd = open(path, O_WRONLY | O_NONBLOCK | O_NOCTTY | O_CLOEXEC);
+    }
+    if (console_fd < 0)
+        console_fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+
+    return console_fd;
+}
+
+/**
+ * @brief Deadline 'ms' milliseconds from now, for pthread_cond_timedwait
+ *
+ * @param deadline
+ * @param ms
+ */
+static void deadline_in(struct timespec* deadline, unsigned int ms)
+{
+    clock_gettime(CLOCK_REALTIME, deadline);
+    deadline->tv_sec += ms / 1000;
+    deadline->tv_nsec += (long)(ms % 1000) * 1000000L;
+    if (deadline->tv_nsec >= 1000000000L)
+    {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000L;
+    }
+}
+
+/**
+ * @brief Copy bytes at the end of the ring. The lock must be held, and there must be room for them
+ *
+ * @param console
+ * @param data
+ * @param length
+ */
+static void push_bytes(log_console_t* console, const char* data, size_t length)
+{
+    size_t tail = (console->head + console->used) % console->size;
+    size_t first = console->size - tail < length ? console->size - tail : length;
+
+    memcpy(console->buffer + tail, data, first);
+    memcpy(console->buffer, data + first, length - first);
+    console->used += length;
+}
+
+/**
+ * @brief Whether a log message is dropped, as the console does not keep up: debug messages go first, then info
+ *        ones, then the ones which do not fit. Critical messages are never dropped. The lock must be held
+ *
+ * @param console
+ * @param category
+ * @param length bytes the log message takes
+ * @return true
+ */
+static bool drop_message(const log_console_t* console, LOG_MSG_CATEGORY category, size_t length)
+{
+    size_t used = console->used + length;
+
+    switch(category)
+    {
+        case LOG_MSG_CRIT:
+            return false;
+
+        case LOG_MSG_DBG:
+            return used * 100 > console->size * DROP_DEBUG_PERCENT;
+
+        case LOG_MSG_INFO:
+            return used * 100 > console->size * DROP_INFO_PERCENT;
+
+        default:
+            return used > console->size;
+    }
+}
+
+/**
+ * @brief Write some bytes of the ring into the console, waiting for it to take them if it is busy.
+ *        The lock must be held: it is released meanwhile
+ *
+ * @param console
+ */
+static void write_some(log_console_t* console)
+{
+    size_t length = console->size - console->head < console->used ? console->size - console->head : console->used;
+    const char* data = console->buffer + console->head;
+    ssize_t ret;
+
+    // print calls only append after 'used' bytes, so these ones can be read with no lock
+    pthread_mutex_unlock(&console->lock);
+    ret = write(console->fd, data, length);
+    if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    {
+        struct pollfd pending = {.fd = console->fd, .events = POLLOUT};
+        poll(&pending, 1, POLL_TIMEOUT_MS);
+    }
+    pthread_mutex_lock(&console->lock);
+
+    // a console which cannot be written any more (e.g.: closed pipe) just loses the log messages
+    if (ret < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        ret = (ssize_t)length;
+
+    if (ret > 0)
+    {
+        console->head = (console->head + (size_t)ret) % console->size;
+        console->used -= (size_t)ret;
+        pthread_cond_broadcast(&console->room);
+    }
+}
+
+/**
+ * @brief Queue a line telling how many log messages were dropped. The lock must be held, and the ring empty
+ *
+ * @param console
+ */
+static void report_dropped(log_console_t* console)
+{
+    char report[MAX_REPORT_SIZE];
+    int len = snprintf(report, sizeof(report), "Console sink: %llu log messages dropped\n",
+                       (unsigned long long)console->dropped);
+
+    if (len > 0 && (size_t)len <= console->size)
+    {
+        push_bytes(console, report, (size_t)len);
+        console->dropped = 0;
+    }
+}
+
+/**
+ * @brief Thread of a console sink: writes the ring into the console as fast as it takes it
+ *
+ * @param arg log_console_t
+ * @return void*
+ */
+static void* console_thread(void* arg)
+{
+    log_console_t* console = arg;
+    struct timespec stop_deadline;
+
+    pthread_mutex_lock(&console->lock);
+    for (;;)
+    {
+        while (console->used == 0 && !console->stop_requested)
+            pthread_cond_wait(&console->wakeup, &console->lock);
+
+        if (console->stop_requested)
+            break;
+
+        write_some(console);
+
+        // the console keeps up again: tell how many log messages it missed
+        if (console->used == 0 && console->dropped > 0)
+            report_dropped(console);
+    }
+
+    // closing: whatever is left gets some time to make it to the console
+    deadline_in(&stop_deadline, DRAIN_TIMEOUT_MS);
+    while (console->used > 0)
+    {
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        if (now.tv_sec > stop_deadline.tv_sec ||
+            (now.tv_sec == stop_deadline.tv_sec && now.tv_nsec >= stop_deadline.tv_nsec))
+            break;
+
+        write_some(console);
+    }
+    pthread_mutex_unlock(&console->lock);
+
+    return NULL;
+}
+
+/**
+ * @brief Write operation of the console sinks: queue the log message, or drop it if the console does not keep up
+ *
+ * @param context
+ * @param message
+ */
+static void console_sink_write(void* context, const log_sink_message_t* message)
+{
+    log_console_t* console = context;
+    const char* color = console->colors ? message->color : "";
+    const char* color_reset = console->colors ? message->color_reset : "";
+    size_t color_len = strlen(color);
+    size_t color_reset_len = strlen(color_reset);
+    size_t length = color_len + message->length + color_reset_len;
+
+    // longer log messages lose their colors, and are cut so that they fit in the ring
+    if (length > console->size)
+    {
+        length = message->length < console->size ? message->length : console->size;
+        color_len = color_reset_len = 0;
+        color = color_reset = "";
+    }
+
+    pthread_mutex_lock(&console->lock);
+
+    // critical messages wait for room rather than being dropped
+    while (message->category == LOG_MSG_CRIT && console->used + length > console->size && !console->stop_requested)
+        pthread_cond_wait(&console->room, &console->lock);
+
+    if (drop_message(console, message->category, length) || console->used + length > console->size)
+    {
+        console->dropped++;
+        pthread_mutex_unlock(&console->lock);
+        return;
+    }
+
+    push_bytes(console, color, color_len);
+    push_bytes(console, message->text, length - color_len - color_reset_len);
+    push_bytes(console, color_reset, color_reset_len);
+
+    pthread_cond_signal(&console->wakeup);
+    pthread_mutex_unlock(&console->lock);
+}
+
+/**
+ * @brief Flush operation of the console sinks: wait a while for the console to take the buffered bytes
+ *
+ * @param context
+ */
+static void console_sink_flush(void* context)
+{
+    log_console_t* console = context;
+    struct timespec deadline;
+
+    deadline_in(&deadline, DRAIN_TIMEOUT_MS);
+
+    pthread_mutex_lock(&console->lock);
+    while (console->used > 0)
+    {
+        if (pthread_cond_timedwait(&console->room, &console->lock, &deadline) == ETIMEDOUT)
+            break;
+    }
+    pthread_mutex_unlock(&console->lock);
+}
+
+/**
+ * @brief Close operation of the console sinks
+ *
+ * @param context
+ */
+static void console_sink_close(void* context)
+{
+    log_console_t* console = context;
+
+    pthread_mutex_lock(&console->lock);
+    console->stop_requested = true;
+    pthread_cond_broadcast(&console->wakeup);
+    pthread_cond_broadcast(&console->room);
+    pthread_mutex_unlock(&console->lock);
+
+    pthread_join(console->writer, NULL);
+
+    close(console->fd);
+    pthread_cond_destroy(&console->room);
+    pthread_cond_destroy(&console->wakeup);
+    pthread_mutex_destroy(&console->lock);
+    free(console->buffer);
+    free(console);
+}
+
+
+int log_add_console_sink(int fd, size_t buffer_size, const log_sink_config_t* config)
+{
+    static const log_sink_ops_t ops = {.write = console_sink_write, .flush = console_sink_flush, .close = console_sink_close};
+    log_console_t* console;
+    int id;
+
+    if (fd < 0 || !config)
+        return -1;
+
+    if (!(console = calloc(1, sizeof(log_console_t))))
+        return -1;
+
+    console->size = buffer_size > 0 ? buffer_size : DEFAULT_BUFFER_SIZE;
+    console->colors = isatty(fd) == 1;
+    if (!(console->buffer = malloc(console->size)) || (console->fd = open_console(fd)) < 0)
+    {
+        free(console->buffer);
+        free(console);
+        return -1;
+    }
+
+    pthread_mutex_init(&console->lock, NULL);
+    pthread_cond_init(&console->wakeup, NULL);
+    pthread_cond_init(&console->room, NULL);
+
+    if (pthread_create(&console->writer, NULL, console_thread, console) != 0)
+    {
+        close(console->fd);
+        pthread_cond_destroy(&console->room);
+        pthread_cond_destroy(&console->wakeup);
+        pthread_mutex_destroy(&console->lock);
+        free(console->buffer);
+        free(console);
+        return -1;
+    }
+
+    id = log_add_sink(&ops, console, config);
+    if (id < 0)
+        console_sink_close(console);
+
+    return id;
+}
@@ -0,0 +1,681 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <limits.h>
+#include <string.h>
+#include <wchar.h>
+
+#include "log4embedded_internal.h"
+
+// Define the maximum size of a single conversion specification, e.g.: "%-+#0*.*lld"
+#define MAX_SPEC_SIZE   32
+
+// Define the maximum size of a string argument rendered with flags, width or precision
+#define MAX_STRING_ARG_SIZE     256
+
+// Define the maximum size of a packed number: 64-bit varint
+#define MAX_PACKED_VALUE_SIZE   10
+
+// Define the NULL character
+#define NULL_CHAR  '\0'
+
+// parsed printf conversion specification
+typedef struct {
+    const char* start;          // points to '%'
+    size_t length;              // up to, and including, the conversion character
+    int stars;                  // number of '*' for width and precision (0, 1 or 2)
+    bool precision_star;        // whether the last '*' is the precision
+    int precision;              // precision given as digits, -1 if none (or given by '*')
+    char length_mod[3];         // "hh", "h", "l", "ll", "j", "z", "t", "L" or ""
+    char conversion;
+} log_spec_t;
+
+
+/**
+ * @brief Parse the conversion specification starting at 'fmt' (which points to '%')
+ *
+ * @param fmt
+ * @param spec
+ * @return true if a valid conversion specification was found
+ */
+static bool parse_spec(const char* fmt, log_spec_t* spec)
+{
+    const char* p = fmt + 1;
+    size_t mod_len = 0;
+
+    spec->start = fmt;
+    spec->stars = 0;
+    spec->precision_star = false;
+    spec->precision = -1;
+
+    // flags
+    while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0' || *p == '\'')
+        p++;
+
+    // width
+    if (*p == '*')
+    {
+        spec->stars++;
+        p++;
+    }
+    else
+        while (*p >= '0' && *p <= '9')
+            p++;
+
+    // precision
+    if (*p == '.')
+    {
+        p++;
+        if (*p == '*')
+        {
+            spec->stars++;
+            spec->precision_star = true;
+            p++;
+        }
+        else
+        {
+            spec->precision = 0;
+            while (*p >= '0' && *p <= '9')
+            {
+                // saturate rather than overflow: such a precision takes the whole string anyway
+                if (spec->precision <= (INT_MAX - 9) / 10)
+                    spec->precision = spec->precision * 10 + (*p - '0');
+                p++;
+            }
+        }
+    }
+
+    // length modifier
+    while ((*p == 'h' || *p == 'l' || *p == 'j' || *p == 'z' || *p == 't' || *p == 'L') && mod_len < 2)
+        spec->length_mod[mod_len++] = *p++;
+    spec->length_mod[mod_len] = NULL_CHAR;
+
+    if (*p == NULL_CHAR || (size_t)(p - fmt) >= MAX_SPEC_SIZE - 4)
+        return false;
+
+    spec->conversion = *p;
+    spec->length = (size_t)(p - fmt) + 1;
+    return true;
+}
+
+/**
+ * @brief Whether the integer conversion needs 64 bits, according to its length modifier
+ *
+ * @param spec
+ * @return true
+ */
+static bool is_wide_integer(const log_spec_t* spec)
+{
+    return spec->length_mod[0] == 'l' || spec->length_mod[0] == 'j' ||
+           spec->length_mod[0] == 'z' || spec->length_mod[0] == 't';
+}
+
+/**
+ * @brief Append one tagged argument to the capture buffer
+ *
+ * @return true if there was room for it
+ */
+static bool put_arg(uint8_t* out, size_t out_size, size_t* pos, uint8_t tag, const void* value, size_t value_size)
+{
+    if (*pos + 1 + value_size > out_size)
+        return false;
+
+    out[(*pos)++] = tag;
+    memcpy(out + *pos, value, value_size);
+    *pos += value_size;
+    return true;
+}
+
+/**
+ * @brief Append a copy of a string argument to the capture buffer. Strings are truncated to fit.
+ *
+ * @return true if there was room for, at least, its length
+ */
+static bool put_string(uint8_t* out, size_t out_size, size_t* pos, const char* str, size_t len)
+{
+    uint16_t stored;
+
+    if (*pos + 1 + sizeof(stored) > out_size)
+        return false;
+
+    if (len > out_size - *pos - 1 - sizeof(stored))
+        len = out_size - *pos - 1 - sizeof(stored);
+    if (len > UINT16_MAX)
+        len = UINT16_MAX;
+    stored = (uint16_t)len;
+
+    out[(*pos)++] = LOG_ARG_STRING;
+    memcpy(out + *pos, &stored, sizeof(stored));
+    *pos += sizeof(stored);
+    memcpy(out + *pos, str, len);
+    *pos += len;
+    return true;
+}
+
+bool log_internal_capture_args(uint8_t* out, size_t out_size, size_t* captured, const char* fmt, va_list args)
+{
+    size_t pos = 0;
+    log_spec_t spec;
+
+    for (const char* p = fmt; *p != NULL_CHAR; p++)
+    {
+        if (*p != '%')
+            continue;
+
+        if (p[1] == '%')
+        {
+            p++;
+            continue;
+        }
+
+        if (!parse_spec(p, &spec))
+            return false;
+        p += spec.length - 1;
+
+        for (int i = 0; i < spec.stars; i++)
+        {
+            int32_t star = va_arg(args, int);
+            if (!put_arg(out, out_size, &pos, LOG_ARG_INT32, &star, sizeof(star)))
+                return false;
+
+            // a negative precision is taken as if it were omitted, as printf does
+            if (spec.precision_star && i == spec.stars - 1)
+                spec.precision = star < 0 ? -1 : star;
+        }
+
+        bool ok = true;
+        switch(spec.conversion)
+        {
+            case 'd': case 'i':
+                if (is_wide_integer(&spec))
+                {
+                    int64_t v = spec.length_mod[0] == 'l' && spec.length_mod[1] == 'l' ? va_arg(args, long long) :
+                                spec.length_mod[0] == 'l' ? va_arg(args, long) :
+                                spec.length_mod[0] == 'j' ? va_arg(args, intmax_t) :
+                                spec.length_mod[0] == 'z' ? (int64_t)va_arg(args, size_t) : va_arg(args, ptrdiff_t);
+                    ok = put_arg(out, out_size, &pos, LOG_ARG_INT64, &v, sizeof(v));
+                }
+                else
+                {
+                    int32_t v = va_arg(args, int);
+                    if (spec.length_mod[0] == 'h')
+                        v = spec.length_mod[1] == 'h' ? (signed char)v : (short)v;
+                    ok = put_arg(out, out_size, &pos, LOG_ARG_INT32, &v, sizeof(v));
+                }
+            break;
+
+            case 'u': case 'o': case 'x': case 'X':
+                if (is_wide_integer(&spec))
+                {
+                    uint64_t v = spec.length_mod[0] == 'l' && spec.length_mod[1] == 'l' ? va_arg(args, unsigned long long) :
+                                 spec.length_mod[0] == 'l' ? va_arg(args, unsigned long) :
+                                 spec.length_mod[0] == 'j' ? va_arg(args, uintmax_t) :
+                                 spec.length_mod[0] == 'z' ? va_arg(args, size_t) : (uint64_t)va_arg(args, ptrdiff_t);
+                    ok = put_arg(out, out_size, &pos, LOG_ARG_INT64, &v, sizeof(v));
+                }
+                else
+                {
+                    uint32_t v = va_arg(args, unsigned int);
+                    if (spec.length_mod[0] == 'h')
+                        v = spec.length_mod[1] == 'h' ? (unsigned char)v : (unsigned short)v;
+                    ok = put_arg(out, out_size, &pos, LOG_ARG_INT32, &v, sizeof(v));
+                }
+            break;
+
+            case 'c':
+            {
+                int32_t v = spec.length_mod[0] == 'l' ? (int32_t)va_arg(args, wint_t) : va_arg(args, int);
+                ok = put_arg(out, out_size, &pos, LOG_ARG_INT32, &v, sizeof(v));
+            }
+            break;
+
+            case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+                if (spec.length_mod[0] == 'L')
+                {
+                    long double v = va_arg(args, long double);
+                    ok = put_arg(out, out_size, &pos, LOG_ARG_LONG_DOUBLE, &v, sizeof(v));
+                }
+                else
+                {
+                    double v = va_arg(args, double);
+                    ok = put_arg(out, out_size, &pos, LOG_ARG_DOUBLE, &v, sizeof(v));
+                }
+            break;
+
+            case 's':
+                if (spec.length_mod[0] == 'l')
+                {
+                    // wide strings are converted right away, as the writer thread cannot rely on their lifetime
+                    char converted[LOG4EMBEDDED_ASYNC_RECORD_SIZE];
+                    const wchar_t* ws = va_arg(args, const wchar_t*);
+                    int len = snprintf(converted, sizeof(converted), "%ls", ws ? ws : L"(null)");
+                    ok = len >= 0 && put_string(out, out_size, &pos, converted, strnlen(converted, sizeof(converted)));
+                }
+                else
+                {
+                    // with a precision, the string needs no terminating null character: never read past it
+                    const char* str = va_arg(args, const char*);
+                    if (!str)
+                        str = "(null)";
+                    ok = put_string(out, out_size, &pos, str,
+                                    spec.precision >= 0 ? strnlen(str, (size_t)spec.precision) : strlen(str));
+                }
+            break;
+
+            case 'p':
+            {
+                uint64_t v = (uintptr_t)va_arg(args, void*);
+                ok = put_arg(out, out_size, &pos, LOG_ARG_POINTER, &v, sizeof(v));
+            }
+            break;
+
+            case 'n':
+                // never written back: the caller has already returned when the message is rendered
+                (void)va_arg(args, void*);
+            break;
+
+            default:
+                return false;
+        }
+
+        if (!ok)
+            return false;
+    }
+
+    *captured = pos;
+    return true;
+}
+
+/**
+ * @brief Read one tagged argument from the capture buffer
+ *
+ * @return true if the argument is there, with the expected tag
+ */
+static bool get_arg(const uint8_t* args, size_t args_size, size_t* pos, uint8_t tag, void* value, size_t value_size)
+{
+    if (*pos + 1 + value_size > args_size || args[*pos] != tag)
+        return false;
+
+    memcpy(value, args + *pos + 1, value_size);
+    *pos += 1 + value_size;
+    return true;
+}
+
+// snprintf a single value with 0, 1 or 2 star arguments ahead of it
+#define SNPRINTF_STARS(out, size, spec, stars, star, value)                                 \
+    ((stars) == 0 ? snprintf(out, size, spec, value) :                                      \
+     (stars) == 1 ? snprintf(out, size, spec, star[0], value) :                             \
+                    snprintf(out, size, spec, star[0], star[1], value))
+
+size_t log_internal_render_args(char* out, size_t out_size, const char* fmt, const uint8_t* args, size_t args_size)
+{
+    size_t len = 0;
+    size_t pos = 0;
+    log_spec_t spec;
+
+    if (out_size == 0)
+        return 0;
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+#pragma GCC diagnostic ignored "-Wformat-security"
+    for (const char* p = fmt; *p != NULL_CHAR && len < out_size - 1; p++)
+    {
+        if (*p != '%' || p[1] == '%')
+        {
+            out[len++] = *p;
+            p += (*p == '%');
+            continue;
+        }
+
+        if (!parse_spec(p, &spec))
+            break;
+        p += spec.length - 1;
+
+        // rewrite the specification without its length modifier, so that a canonical one matches the stored value
+        char spec_text[MAX_SPEC_SIZE];
+        size_t spec_len = 0;
+        for (const char* s = spec.start; s < spec.start + spec.length - 1; s++)
+            if (!strchr("hljztLq", *s))
+                spec_text[spec_len++] = *s;
+
+        int32_t star[2] = {0, 0};
+        bool ok = true;
+        for (int i = 0; i < spec.stars && ok; i++)
+            ok = get_arg(args, args_size, &pos, LOG_ARG_INT32, &star[i], sizeof(star[i]));
+
+        char* dst = out + len;
+        size_t room = out_size - len;
+        int ret = 0;
+
+        switch(spec.conversion)
+        {
+            case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+                if (ok && pos < args_size && args[pos] == LOG_ARG_INT64)
+                {
+                    int64_t v;
+                    memcpy(spec_text + spec_len, "ll", 2);
+                    spec_text[spec_len + 2] = spec.conversion;
+                    spec_text[spec_len + 3] = NULL_CHAR;
+                    ok = get_arg(args, args_size, &pos, LOG_ARG_INT64, &v, sizeof(v));
+                    if (ok)
+                        ret = SNPRINTF_STARS(dst, room, spec_text, spec.stars, star, (long long)v);
+                }
+                else
+                {
+                    int32_t v = 0;
+                    spec_text[spec_len] = spec.conversion;
+                    spec_text[spec_len + 1] = NULL_CHAR;
+                    ok = ok && get_arg(args, args_size, &pos, LOG_ARG_INT32, &v, sizeof(v));
+                    if (ok)
+                        ret = SNPRINTF_STARS(dst, room, spec_text, spec.stars, star, (int)v);
+                }
+            break;
+
+            case 'c':
+            {
+                int32_t v = 0;
+                spec_text[spec_len] = spec.length_mod[0] == 'l' ? 'l' : 'c';
+                spec_text[spec_len + 1] = spec.length_mod[0] == 'l' ? 'c' : NULL_CHAR;
+                spec_text[spec_len + 2] = NULL_CHAR;
+                ok = ok && get_arg(args, args_size, &pos, LOG_ARG_INT32, &v, sizeof(v));
+                if (ok)
+                    ret = SNPRINTF_STARS(dst, room, spec_text, spec.stars, star, (int)v);
+            }
+            break;
+
+            case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+                if (spec.length_mod[0] == 'L')
+                {
+                    long double v = 0;
+                    spec_text[spec_len] = 'L';
+                    spec_text[spec_len + 1] = spec.conversion;
+                    spec_text[spec_len + 2] = NULL_CHAR;
+                    ok = ok && get_arg(args, args_size, &pos, LOG_ARG_LONG_DOUBLE, &v, sizeof(v));
+                    if (ok)
+                        ret = SNPRINTF_STARS(dst, room, spec_text, spec.stars, star, v);
+                }
+                else
+                {
+                    double v = 0;
+                    spec_text[spec_len] = spec.conversion;
+                    spec_text[spec_len + 1] = NULL_CHAR;
+                    ok = ok && get_arg(args, args_size, &pos, LOG_ARG_DOUBLE, &v, sizeof(v));
+                    if (ok)
+                        ret = SNPRINTF_STARS(dst, room, spec_text, spec.stars, star, v);
+                }
+            break;
+
+            case 's':
+            {
+                uint16_t str_len = 0;
+                ok = ok && get_arg(args, args_size, &pos, LOG_ARG_STRING, &str_len, sizeof(str_len)) &&
+                     pos + str_len <= args_size;
+                if (ok && spec_len == 1)
+                {
+                    // plain "%s": copy the string as it is
+                    ret = str_len;
+                    memcpy(dst, args + pos, (size_t)str_len < room - 1 ? str_len : room - 1);
+                    pos += str_len;
+                }
+                else if (ok)
+                {
+                    // strings are not NULL terminated in the capture buffer
+                    char str[MAX_STRING_ARG_SIZE];
+                    size_t copy_len = str_len < sizeof(str) ? str_len : sizeof(str) - 1;
+                    memcpy(str, args + pos, copy_len);
+                    str[copy_len] = NULL_CHAR;
+                    pos += str_len;
+                    spec_text[spec_len] = 's';
+                    spec_text[spec_len + 1] = NULL_CHAR;
+                    ret = SNPRINTF_STARS(dst, room, spec_text, spec.stars, star, str);
+                }
+            }
+            break;
+
+            case 'p':
+            {
+                uint64_t v = 0;
+                spec_text[spec_len] = 'p';
+                spec_text[spec_len + 1] = NULL_CHAR;
+                ok = ok && get_arg(args, args_size, &pos, LOG_ARG_POINTER, &v, sizeof(v));
+                if (ok)
+                    ret = SNPRINTF_STARS(dst, room, spec_text, spec.stars, star, (void*)(uintptr_t)v);
+            }
+            break;
+
+            case 'n':
+            break;
+
+            default:
+                ok = false;
+            break;
+        }
+
+        if (!ok || ret < 0)
+            break;
+
+        len += (size_t)ret < room ? (size_t)ret : room - 1;
+    }
+#pragma GCC diagnostic pop
+
+    out[len] = NULL_CHAR;
+    return len;
+}
+
+size_t log_internal_put_varint(uint8_t* out, uint64_t value)
+{
+    size_t len = 0;
+
+    while (value >= 0x80)
+    {
+        out[len++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[len++] = (uint8_t)value;
+    return len;
+}
+
+bool log_internal_get_varint(const uint8_t* in, size_t in_size, size_t* pos, uint64_t* value)
+{
+    uint64_t result = 0;
+
+    for (int shift = 0; shift < 64 && *pos < in_size; shift += 7)
+    {
+        uint8_t byte = in[(*pos)++];
+        result |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+        {
+            *value = result;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Map signed integers to unsigned ones, so that small negative values also take few varint bytes
+ */
+static uint64_t zigzag_encode(int64_t value)
+{
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int64_t zigzag_decode(uint64_t value)
+{
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+/**
+ * @brief Read the value of a captured argument whose tag has already been read, if it fits in 'args'
+ *
+ * @return true on success
+ */
+static bool take_value(const uint8_t* args, size_t args_size, size_t* pos, void* value, size_t value_size)
+{
+    if (value_size > args_size - *pos)
+        return false;
+
+    memcpy(value, args + *pos, value_size);
+    *pos += value_size;
+    return true;
+}
+
+size_t log_internal_pack_args(uint8_t* out, size_t out_size, const uint8_t* args, size_t args_size)
+{
+    size_t pos = 0;
+    size_t len = 0;
+
+    while (pos < args_size)
+    {
+        uint8_t tag = args[pos++];
+        uint8_t packed[MAX_PACKED_VALUE_SIZE];
+        size_t packed_len = 0;
+        const uint8_t* string = NULL;
+        uint16_t string_len = 0;
+
+        switch(tag)
+        {
+            case LOG_ARG_INT32:
+            {
+                int32_t v;
+                if (!take_value(args, args_size, &pos, &v, sizeof(v)))
+                    return 0;
+                packed_len = log_internal_put_varint(packed, zigzag_encode(v));
+            }
+            break;
+
+            case LOG_ARG_INT64:
+            case LOG_ARG_POINTER:
+            {
+                int64_t v;
+                if (!take_value(args, args_size, &pos, &v, sizeof(v)))
+                    return 0;
+                packed_len = log_internal_put_varint(packed, tag == LOG_ARG_INT64 ? zigzag_encode(v) : (uint64_t)v);
+            }
+            break;
+
+            case LOG_ARG_DOUBLE:
+            case LOG_ARG_LONG_DOUBLE:
+            {
+                double v;
+                uint64_t bits;
+                if (tag == LOG_ARG_DOUBLE)
+                {
+                    if (!take_value(args, args_size, &pos, &v, sizeof(v)))
+                        return 0;
+                }
+                else
+                {
+                    long double lv;
+                    if (!take_value(args, args_size, &pos, &lv, sizeof(lv)))
+                        return 0;
+                    v = (double)lv;
+                }
+
+                // little-endian IEEE-754, whatever the host
+                memcpy(&bits, &v, sizeof(bits));
+                for (size_t i = 0; i < sizeof(bits); ++i)
+                    packed[packed_len++] = (uint8_t)(bits >> (8 * i));
+            }
+            break;
+
+            case LOG_ARG_STRING:
+                if (!take_value(args, args_size, &pos, &string_len, sizeof(string_len)) || string_len > args_size - pos)
+                    return 0;
+                string = args + pos;
+                pos += string_len;
+                packed_len = log_internal_put_varint(packed, string_len);
+            break;
+
+            default:
+                return 0;
+        }
+
+        if (len + 1 + packed_len + string_len > out_size)
+            return 0;
+
+        out[len++] = tag;
+        memcpy(out + len, packed, packed_len);
+        len += packed_len;
+        if (string)
+        {
+            memcpy(out + len, string, string_len);
+            len += string_len;
+        }
+    }
+
+    return len;
+}
+
+size_t log_internal_unpack_args(uint8_t* out, size_t out_size, const uint8_t* packed, size_t packed_size)
+{
+    size_t pos = 0;
+    size_t len = 0;
+
+    while (pos < packed_size)
+    {
+        uint8_t tag = packed[pos++];
+        uint64_t v = 0;
+        bool ok = true;
+
+        switch(tag)
+        {
+            case LOG_ARG_INT32:
+            {
+                int32_t value;
+                ok = log_internal_get_varint(packed, packed_size, &pos, &v);
+                value = (int32_t)zigzag_decode(v);
+                ok = ok && put_arg(out, out_size, &len, tag, &value, sizeof(value));
+            }
+            break;
+
+            case LOG_ARG_INT64:
+            case LOG_ARG_POINTER:
+            {
+                int64_t value;
+                ok = log_internal_get_varint(packed, packed_size, &pos, &v);
+                value = tag == LOG_ARG_INT64 ? zigzag_decode(v) : (int64_t)v;
+                ok = ok && put_arg(out, out_size, &len, tag, &value, sizeof(value));
+            }
+            break;
+
+            case LOG_ARG_DOUBLE:
+            case LOG_ARG_LONG_DOUBLE:
+            {
+                double value;
+                if (pos + sizeof(v) > packed_size)
+                    return 0;
+                for (size_t i = 0; i < sizeof(v); ++i)
+                    v |= (uint64_t)packed[pos++] << (8 * i);
+                memcpy(&value, &v, sizeof(value));
+
+                if (tag == LOG_ARG_DOUBLE)
+                    ok = put_arg(out, out_size, &len, tag, &value, sizeof(value));
+                else
+                {
+                    long double lvalue = value;
+                    ok = put_arg(out, out_size, &len, tag, &lvalue, sizeof(lvalue));
+                }
+            }
+            break;
+
+            case LOG_ARG_STRING:
+                ok = log_internal_get_varint(packed, packed_size, &pos, &v) && v <= UINT16_MAX && pos + v <= packed_size &&
+                     out_size - len >= 1 + sizeof(uint16_t) + v &&
+                     put_string(out, out_size, &len, (const char*)packed + pos, (size_t)v);
+                pos += (size_t)v;
+            break;
+
+            default:
+                return 0;
+        }
+
+        if (!ok)
+            return 0;
+    }
+
+    return len;
+}
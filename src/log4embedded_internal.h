@@ -0,0 +1,510 @@
+/**
+ * @file    log4embedded_internal.h
+ * @brief   Private interface shared between the translation units of log4embedded.
+ *          This header is not installed, nor meant to be included by applications.
+ * 
+ */
+
+#ifndef LOG4EMBEDDED_INTERNAL_H
+#define LOG4EMBEDDED_INTERNAL_H
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "log4embedded.h"
+
+// Maximum size of a log message queued in asynchronous mode, including label and date
+#ifndef LOG4EMBEDDED_ASYNC_RECORD_SIZE
+#define LOG4EMBEDDED_ASYNC_RECORD_SIZE  256
+#endif
+
+// Maximum path size of a log file, including the NULL character
+#define LOG4EMBEDDED_MAX_PATH_SIZE      256
+
+
+/*
+    Binary log file layout (see log_set_binary_file), all numbers as varints:
+        file header:    "L4EB", version byte, seconds and microseconds of the time base
+        format record:  LOG4EMBEDDED_BINARY_FORMAT, format ID, length, format string. Once per format string and file
+        message record: LOG_MSG_CATEGORY byte, zigzag microseconds since the previous record (or the time base),
+                        format ID, length of the arguments, arguments packed by log_internal_pack_args
+*/
+#define LOG4EMBEDDED_BINARY_MAGIC       "L4EB"
+#define LOG4EMBEDDED_BINARY_VERSION     1
+#define LOG4EMBEDDED_BINARY_FORMAT      0x00
+
+// Where a print call was made. 'file' is NULL when unknown (e.g.: log_print_* functions)
+typedef struct {
+    const char* file;
+    int line;
+    const char* func;
+} log_location_t;
+
+
+/***********    log4embedded.c    ************/
+
+/**
+ * @brief   Render a whole log message (label, date, message with arguments) into 'line', with no colors.
+ *          The message is truncated if it does not fit in 'line_size' bytes.
+ * 
+ * @param   message_offset  where the message starts in 'line', right after the label and date
+ * @return  size_t length of the rendered line, without the NULL character
+ */
+size_t log_internal_format_line(char* line, size_t line_size, LOG_MSG_CATEGORY category, const log_location_t* location,
+                                const char* fmt, va_list args, size_t* message_offset);
+
+/**
+ * @brief   Same as log_internal_format_line, from a format string whose arguments were captured by
+ *          log_internal_capture_args, and the date when the log message was generated.
+ */
+size_t log_internal_format_captured(char* line, size_t line_size, LOG_MSG_CATEGORY category, const log_location_t* location,
+                                    const struct timespec* timestamp, const char* fmt, const uint8_t* args, size_t args_size,
+                                    size_t* message_offset);
+
+/**
+ * @brief   ANSI escape sequence of the color of a LOG_MSG_CATEGORY on the console.
+ */
+const char* log_internal_console_color(LOG_MSG_CATEGORY category);
+
+/**
+ * @brief   Take the date and time of a log message, from the clock matching the timestamp precision in use.
+ */
+void log_internal_now(struct timespec* timestamp);
+
+/**
+ * @brief   Write an already rendered log message to the log output if 'to_output', applying the flush policy, and to
+ *          every other sink whose level allows it. 'plain' log messages are written with no colors nor trailer.
+ */
+void log_internal_write(LOG_MSG_CATEGORY category, bool to_output, const char* line, size_t length, size_t message_offset, bool plain);
+
+/**
+ * @brief   Same as log_internal_write, with no duplicate suppression: for the reports of the suppression itself.
+ */
+void log_internal_output(LOG_MSG_CATEGORY category, bool to_output, const char* line, size_t length, size_t message_offset, bool plain);
+
+/**
+ * @brief   Print a log message as the print functions do, with no rate limit: for the reports of the rate limiter.
+ *          It goes to the log output if 'category' is not above 'output_level'.
+ */
+void log_internal_print(LOG_MSG_CATEGORY category, LOG_MSG_CATEGORY output_level, const log_location_t* location,
+                        const char* fmt, ...);
+
+/**
+ * @brief   Recompute the level print calls are checked against, after a change of log level or flight recorder mode.
+ */
+void log_internal_update_level();
+
+/**
+ * @brief   File descriptor of the text log output: the log file, the stdout, or the stderr if log messages go into a
+ *          binary or memory-mapped log file. Async-signal-safe.
+ */
+int log_internal_output_fd();
+
+/**
+ * @brief   Start a burst of log messages written by the calling thread (the writer thread), which may be gathered
+ *          and written at once, according to LOG_IO_STRATEGY.
+ */
+void log_internal_burst_begin();
+
+/**
+ * @brief   End a burst of log messages, submitting the ones gathered so far.
+ */
+void log_internal_burst_end();
+
+/**
+ * @brief   Get the number of rotated log files to keep and their compression, as set by log_set_rotation.
+ */
+void log_internal_rotation_settings(size_t* max_file_size, unsigned int* max_files, LOG_COMPRESSION* compression);
+
+
+/***********    log4embedded_async.c    ************/
+
+/**
+ * @brief   Whether log messages shall be handed over to the writer thread.
+ */
+bool log_internal_async_enabled();
+
+/**
+ * @brief   Render a log message into the asynchronous queue, applying the overflow policy when full.
+ * 
+ * @return  false if asynchronous mode is off or the caller is the writer thread, so the caller must write the log
+ *          message itself
+ */
+bool log_internal_async_submit(LOG_MSG_CATEGORY category, bool to_output, const log_location_t* location, const char* fmt, va_list args);
+
+/**
+ * @brief   Copy an already rendered log message into the asynchronous queue, applying the overflow policy when full.
+ * 
+ * @return  false if asynchronous mode is off, the caller is the writer thread or the line does not fit in a queued
+ *          log message, so the caller must write the log message itself
+ */
+bool log_internal_async_submit_line(LOG_MSG_CATEGORY category, bool to_output, const char* line, size_t length, size_t message_offset,
+                                    bool plain);
+
+/**
+ * @brief   Queue a log message whose arguments are already captured, to be rendered by the writer thread, applying the
+ *          overflow policy when full. Arguments which do not fit in a queued log message are rendered right away.
+ * 
+ * @return  false if asynchronous mode is off or the caller is the writer thread, so the caller must write the log
+ *          message itself
+ */
+bool log_internal_async_submit_captured(LOG_MSG_CATEGORY category, bool to_output, const log_location_t* location,
+                                        const char* fmt, const uint8_t* args, size_t args_size);
+
+/**
+ * @brief   Wait until the writer thread has written every queued log message. No-op in synchronous mode, or from the
+ *          writer thread itself.
+ */
+void log_internal_async_drain();
+
+
+/***********    log4embedded_rotate.c    ************/
+
+/**
+ * @brief   Whether rotated log files can be stored with the given LOG_COMPRESSION.
+ */
+bool log_internal_compression_available(LOG_COMPRESSION compression);
+
+/**
+ * @brief   Hand a rotated log file, already renamed to 'segment_name', over to the rotation thread: it shifts
+ *          the older rotated files of 'file_name', and stores this one as number 1, compressed if requested.
+ *          The job is run right away if the thread cannot be started.
+ */
+void log_internal_rotate_submit(const char* file_name, const char* segment_name, unsigned int max_files, LOG_COMPRESSION compression);
+
+/**
+ * @brief   Wait until the rotation thread has finished every pending job.
+ */
+void log_internal_rotate_drain();
+
+/**
+ * @brief   Finish every pending job and stop the rotation thread. It is started again on the next rotation.
+ */
+void log_internal_rotate_stop();
+
+
+/***********    log4embedded_mmap.c    ************/
+
+/**
+ * @brief   Whether log messages are written into a memory-mapped log file.
+ */
+bool log_internal_mmap_enabled();
+
+/**
+ * @brief   Copy an already rendered log message into the memory-mapped log file, rolling its segment over when full.
+ * 
+ * @return  false if the memory-mapped sink is not in use, so the caller must write the log message itself
+ */
+bool log_internal_mmap_write(const char* line, size_t length);
+
+/**
+ * @brief   Map 'filepath', closing any previous memory-mapped log file, and start the sync thread if
+ *          'sync_interval_ms' is not 0.
+ * 
+ * @return  0 on success, -1 if the file cannot be created, preallocated or mapped
+ */
+int log_internal_mmap_open(const char* filepath, size_t segment_size, unsigned int sync_interval_ms);
+
+/**
+ * @brief   msync the memory-mapped log file, if any.
+ */
+void log_internal_mmap_sync();
+
+/**
+ * @brief   Sync, unmap and cut the memory-mapped log file down to its log messages. No-op if not in use.
+ */
+void log_internal_mmap_close();
+
+
+/***********    log4embedded_binary.c    ************/
+
+/**
+ * @brief   Whether log messages are written into a binary log file.
+ */
+bool log_internal_binary_enabled();
+
+/**
+ * @brief   Write a log message into the binary log file, as its format string ID and packed arguments.
+ * 
+ * @return  false if the binary sink is not in use, so the caller must write the log message itself
+ */
+bool log_internal_binary_write(LOG_MSG_CATEGORY category, const char* fmt, va_list args);
+
+/**
+ * @brief   Same as log_internal_binary_write, for arguments already captured by log_internal_capture_args.
+ * 
+ * @return  false if the binary sink is not in use, so the caller must write the log message itself
+ */
+bool log_internal_binary_write_captured(LOG_MSG_CATEGORY category, const char* fmt, const uint8_t* captured,
+                                        size_t captured_size);
+
+/**
+ * @brief   Write an already rendered, null-terminated log message into the binary log file, as a "%s" record.
+ * 
+ * @return  false if the binary sink is not in use, so the caller must write the log message itself
+ */
+bool log_internal_binary_write_line(LOG_MSG_CATEGORY category, const char* line);
+
+/**
+ * @brief   Open 'filepath' as a binary log file, closing any previous one.
+ * 
+ * @return  0 on success, -1 if the file cannot be opened
+ */
+int log_internal_binary_open(const char* filepath);
+
+/**
+ * @brief   Write the buffered records into the binary log file, if any.
+ */
+void log_internal_binary_flush();
+
+/**
+ * @brief   Flush and close the binary log file. No-op if not in use.
+ */
+void log_internal_binary_close();
+
+
+/***********    log4embedded_recorder.c    ************/
+
+/**
+ * @brief   Whether log messages are also kept in the flight recorder.
+ */
+bool log_internal_recorder_enabled();
+
+/**
+ * @brief   Copy an already rendered log message into the flight recorder ring, overwriting the oldest ones. No lock.
+ */
+void log_internal_recorder_write(const char* line, size_t length);
+
+/**
+ * @brief   Write the log messages kept since the last dump into 'fd', between two banners. Async-signal-safe.
+ */
+void log_internal_recorder_dump(int fd);
+
+
+/***********    log4embedded_sink.c    ************/
+
+/**
+ * @brief   Most verbose level of the sinks added via log_add_sink, LOG_MSG_NONE if there is none.
+ */
+LOG_MSG_CATEGORY log_internal_sinks_level();
+
+/**
+ * @brief   Whether any sink added via log_add_sink takes log messages of this category. No lock.
+ */
+bool log_internal_sinks_accept(LOG_MSG_CATEGORY category);
+
+/**
+ * @brief   Hand an already rendered log message over to every sink added via log_add_sink whose level allows it.
+ *          'plain' log messages get no colors, whatever the sink configuration.
+ */
+void log_internal_sinks_write(LOG_MSG_CATEGORY category, const char* line, size_t length, size_t message_offset, bool plain);
+
+/**
+ * @brief   Flush every sink added via log_add_sink.
+ */
+void log_internal_sinks_flush();
+
+/**
+ * @brief   Remove and close every sink added via log_add_sink.
+ */
+void log_internal_sinks_close();
+
+
+/***********    log4embedded_batch.c    ************/
+/*          Every function but log_internal_batch_strategy and log_internal_batch_begin must be called with the lock
+            of the log output held. */
+
+/**
+ * @brief   Select how batches are written, setting io_uring up if requested.
+ * 
+ * @return  LOG_IO_STRATEGY the one in use: LOG_IO_WRITEV if io_uring is requested but not available
+ */
+LOG_IO_STRATEGY log_internal_batch_set_strategy(LOG_IO_STRATEGY strategy);
+
+/**
+ * @brief   Get the LOG_IO_STRATEGY in use.
+ */
+LOG_IO_STRATEGY log_internal_batch_strategy();
+
+/**
+ * @brief   From now on, the calling thread gathers its log messages into batches, unless LOG_IO_WRITE is in use.
+ */
+void log_internal_batch_begin();
+
+/**
+ * @brief   Submit the log messages gathered by the calling thread, and stop gathering them.
+ */
+void log_internal_batch_end();
+
+/**
+ * @brief   Whether the calling thread gathers its log messages into batches. 'log_atts.lock' must be held.
+ */
+bool log_internal_batch_gathering();
+
+/**
+ * @brief   Add a log message to the current batch, submitting it first if full. Colors are referenced, not copied.
+ * 
+ * @return  false if the calling thread does not gather log messages, so the caller must write it itself
+ */
+bool log_internal_batch_add(int fd, const char* color, const char* line, size_t length, const char* trailer);
+
+/**
+ * @brief   Submit the current batch: with one writev() call, or as one io_uring request, which is not waited for.
+ */
+void log_internal_batch_submit();
+
+/**
+ * @brief   Submit the current batch, and wait until every submitted one is written.
+ */
+void log_internal_batch_flush();
+
+/**
+ * @brief   Write every batch, and release their memory.
+ */
+void log_internal_batch_close();
+
+
+/***********    log4embedded_config.c    ************/
+
+/**
+ * @brief   Stop watching the configuration file, and forget the sinks it added, which 'log_close' removes anyway.
+ */
+void log_internal_config_close();
+
+
+/***********    log4embedded_stats.c    ************/
+
+// Counters of the logging pipeline, besides the log messages of each category
+typedef enum {
+    LOG_STAT_FILTERED = 0,      // print calls filtered out by the log levels
+    LOG_STAT_RATE_LIMITED,      // print calls dropped by the rate limit
+    LOG_STAT_DUPLICATES,        // log messages suppressed as duplicates
+    LOG_STAT_DROPPED,           // log messages dropped by the asynchronous queue
+    LOG_STAT_BYTES,             // bytes written into the log output
+    LOG_STAT_FLUSHES,           // writes of the write buffer, or of a batch, into the log output
+    LOG_STAT_COUNT
+} LOG_STAT_COUNTER;
+
+/**
+ * @brief   Add 'value' to a counter of the calling thread's stripe. No lock, and seldom a shared cache line.
+ */
+void log_internal_stats_add(LOG_STAT_COUNTER counter, uint64_t value);
+
+/**
+ * @brief   Count a log message which made it past the log levels, and print the statistics if their report is due.
+ */
+void log_internal_stats_message(LOG_MSG_CATEGORY category);
+
+/**
+ * @brief   Raise the high-water mark of the asynchronous queue to 'depth' log messages, if higher.
+ */
+void log_internal_stats_queue_depth(size_t depth);
+
+/**
+ * @brief   Start timing a write into a sink.
+ * 
+ * @return  uint64_t monotonic time in nanoseconds, 0 if writes are not timed (see 'log_enable_stats')
+ */
+uint64_t log_internal_stats_clock();
+
+/**
+ * @brief   Add a write into 'sink' to its latency histogram, 'start_ns' being given by log_internal_stats_clock.
+ */
+void log_internal_stats_latency(int sink, uint64_t start_ns);
+
+
+/***********    log4embedded_limit.c    ************/
+
+/**
+ * @brief   Whether the rate limit of a call site, identified by its format string and location, lets a print call
+ *          through. Reports how many print calls the call site dropped, if any, when it lets one through again. No lock.
+ */
+bool log_internal_limit_allow(LOG_MSG_CATEGORY category, LOG_MSG_CATEGORY output_level, const log_location_t* location,
+                              const char* fmt);
+
+/**
+ * @brief   Whether a rendered log message is the same as the last one, and shall only be counted. Reports how many
+ *          times the last log message was repeated, when a different one comes or periodically. No lock.
+ */
+bool log_internal_limit_duplicate(LOG_MSG_CATEGORY category, bool to_output, const char* message, size_t length);
+
+/**
+ * @brief   Report the log messages suppressed so far, by the rate limiter and the duplicate suppression.
+ */
+void log_internal_limit_report();
+
+
+/***********    log4embedded_module.c    ************/
+
+/**
+ * @brief   Make every call site of the LOG_* macros look up the level of its module again, after a change of the
+ *          log level, the levels of the sinks or the flight recorder mode.
+ */
+void log_internal_modules_invalidate();
+
+
+/***********    log4embedded_kv.c    ************/
+
+/**
+ * @brief   Render a structured log message into 'line' according to LOG_KV_FORMAT, reading its fields from 'args'
+ *          up to a NULL key. Fields which do not fit are left out whole.
+ * 
+ * @param   truncated   set to true if some fields were left out
+ * @return  size_t length of the rendered line, without the NULL character
+ */
+size_t log_internal_format_kv(char* line, size_t line_size, LOG_MSG_CATEGORY category, const struct timespec* timestamp,
+                              const char* msg, va_list* args, bool* truncated);
+
+
+/***********    log4embedded_fmt.c    ************/
+
+/**
+ * @brief   Pack the arguments of 'fmt' into 'out' as tagged binary values, without formatting them.
+ *          Strings are copied, so the caller may release them right after this call.
+ * 
+ * @param captured  number of bytes written into 'out'
+ * @return  false if the arguments do not fit in 'out_size' bytes, or 'fmt' cannot be deferred
+ */
+bool log_internal_capture_args(uint8_t* out, size_t out_size, size_t* captured, const char* fmt, va_list args);
+
+/**
+ * @brief   Render 'fmt' with the arguments packed by log_internal_capture_args. Output is truncated to 'out_size'.
+ * 
+ * @return  size_t length of the rendered text, without the NULL character
+ */
+size_t log_internal_render_args(char* out, size_t out_size, const char* fmt, const uint8_t* args, size_t args_size);
+
+/**
+ * @brief   Write 'value' as a varint: 7 bits per byte, least significant first. 'out' needs room for 10 bytes.
+ * 
+ * @return  size_t number of bytes written
+ */
+size_t log_internal_put_varint(uint8_t* out, uint64_t value);
+
+/**
+ * @brief   Read a varint written by log_internal_put_varint, at position 'pos' of 'in', and move 'pos' past it.
+ * 
+ * @return  false if 'in' ends before the varint does
+ */
+bool log_internal_get_varint(const uint8_t* in, size_t in_size, size_t* pos, uint64_t* value);
+
+/**
+ * @brief   Convert arguments packed by log_internal_capture_args into a compact and portable form: integers and
+ *          pointers as varints, floating point numbers as little-endian doubles, and strings with a varint length.
+ *          Long doubles are stored as doubles.
+ * 
+ * @return  size_t number of bytes written into 'out', or 0 if they do not fit
+ */
+size_t log_internal_pack_args(uint8_t* out, size_t out_size, const uint8_t* args, size_t args_size);
+
+/**
+ * @brief   Convert arguments packed by log_internal_pack_args back into the form log_internal_render_args reads.
+ * 
+ * @return  size_t number of bytes written into 'out', or 0 if they do not fit or 'packed' is malformed
+ */
+size_t log_internal_unpack_args(uint8_t* out, size_t out_size, const uint8_t* packed, size_t packed_size);
+
+#endif // LOG4EMBEDDED_INTERNAL_H
@@ -0,0 +1,374 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "log4embedded.h"
+#include "log4embedded_internal.h"
+
+// Define the NULL character
+#define NULL_CHAR           '\0'
+
+// Define the room kept at the end of the line for the end of a structured log message: "}\n" and the NULL character
+#define KV_TRAILER_ROOM     3
+
+// Define the largest magnitude of a double rendered as fixed point, and the number of its decimals
+#define KV_FIXED_MAX        1e15
+#define KV_FIXED_MIN        1e-3
+#define KV_DECIMALS         6
+#define KV_DECIMALS_SCALE   1e6
+
+// position of the encoder in the line, and the end it must not go past
+typedef struct {
+    char* p;
+    char* end;
+} kv_writer_t;
+
+// date and time of the last second rendered by the calling thread, "YYYY-MM-DDThh:mm:ss" in UTC
+typedef struct {
+    time_t second;
+    char text[20];
+} kv_timestamp_cache_t;
+
+static LOG_KV_FORMAT kv_format = LOG_KV_JSON;
+
+static __thread kv_timestamp_cache_t kv_timestamp_cache = {.second = -1};
+
+// names of the LOG_MSG_CATEGORY values in structured log messages
+static const char* const kv_levels[] = {"none", "crit", "error", "warn", "info", "debug"};
+
+// two decimal digits of every number from 0 to 99
+static const char kv_digit_pairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+// how every byte is written in a JSON string: 0 as is, 'u' as \u00XX, any other character after a backslash
+static const char kv_json_escapes[256] = {
+    ['\b'] = 'b', ['\t'] = 't', ['\n'] = 'n', ['\f'] = 'f', ['\r'] = 'r',
+    [0x00] = 'u', [0x01] = 'u', [0x02] = 'u', [0x03] = 'u', [0x04] = 'u', [0x05] = 'u', [0x06] = 'u', [0x07] = 'u',
+    [0x0b] = 'u', [0x0e] = 'u', [0x0f] = 'u', [0x10] = 'u', [0x11] = 'u', [0x12] = 'u', [0x13] = 'u', [0x14] = 'u',
+    [0x15] = 'u', [0x16] = 'u', [0x17] = 'u', [0x18] = 'u', [0x19] = 'u', [0x1a] = 'u', [0x1b] = 'u', [0x1c] = 'u',
+    [0x1d] = 'u', [0x1e] = 'u', [0x1f] = 'u', [0x7f] = 'u',
+    ['"'] = '"', ['\\'] = '\\'};
+
+
+/**
+ * @brief Append 'length' bytes to the line
+ *
+ * @return false if they do not fit
+ */
+static bool put_raw(kv_writer_t* out, const char* text, size_t length)
+{
+    if ((size_t)(out->end - out->p) < length)
+        return false;
+
+    memcpy(out->p, text, length);
+    out->p += length;
+    return true;
+}
+
+/**
+ * @brief Append a single character to the line
+ *
+ * @return false if it does not fit
+ */
+static bool put_char(kv_writer_t* out, char c)
+{
+    if (out->p >= out->end)
+        return false;
+
+    *out->p++ = c;
+    return true;
+}
+
+/**
+ * @brief Append an unsigned integer, two digits at a time from a lookup table
+ *
+ * @return false if it does not fit
+ */
+static bool put_uint(kv_writer_t* out, uint64_t value)
+{
+    char digits[20];
+    char* p = digits + sizeof(digits);
+
+    while (value >= 100)
+    {
+        const char* pair = kv_digit_pairs + (value % 100) * 2;
+        value /= 100;
+        *--p = pair[1];
+        *--p = pair[0];
+    }
+    if (value >= 10)
+    {
+        const char* pair = kv_digit_pairs + value * 2;
+        *--p = pair[1];
+        *--p = pair[0];
+    }
+    else
+        *--p = (char)('0' + value);
+
+    return put_raw(out, p, (size_t)(digits + sizeof(digits) - p));
+}
+
+/**
+ * @brief Append a signed integer
+ *
+ * @return false if it does not fit
+ */
+static bool put_int(kv_writer_t* out, int64_t value)
+{
+    if (value < 0)
+        return put_char(out, '-') && put_uint(out, (uint64_t)0 - (uint64_t)value);
+
+    return put_uint(out, (uint64_t)value);
+}
+
+/**
+ * @brief Append a floating point number. Numbers of usual magnitudes are written as fixed point, with up to
+ *        KV_DECIMALS decimals and no trailing zero, with integer arithmetic only. Others go through snprintf.
+ *        JSON has no NaN nor infinity: they are written as null
+ *
+ * @return false if it does not fit
+ */
+static bool put_double(kv_writer_t* out, double value, LOG_KV_FORMAT format)
+{
+    double magnitude = fabs(value);
+
+    if (isnan(value) || isinf(value))
+    {
+        if (format == LOG_KV_JSON)
+            return put_raw(out, "null", 4);
+        if (isnan(value))
+            return put_raw(out, "NaN", 3);
+        return value > 0 ? put_raw(out, "+Inf", 4) : put_raw(out, "-Inf", 4);
+    }
+
+    if (magnitude < KV_FIXED_MAX && (magnitude >= KV_FIXED_MIN || magnitude == 0))
+    {
+        uint64_t integer = (uint64_t)magnitude;
+        uint64_t fraction = (uint64_t)((magnitude - (double)integer) * KV_DECIMALS_SCALE + 0.5);
+        char decimals[KV_DECIMALS];
+        int count = KV_DECIMALS;
+
+        if (fraction >= (uint64_t)KV_DECIMALS_SCALE)
+        {
+            integer++;
+            fraction -= (uint64_t)KV_DECIMALS_SCALE;
+        }
+
+        if (value < 0 && !put_char(out, '-'))
+            return false;
+        if (!put_uint(out, integer))
+            return false;
+        if (fraction == 0)
+            return true;
+
+        for (int i = KV_DECIMALS - 1; i >= 0; i--)
+        {
+            decimals[i] = (char)('0' + fraction % 10);
+            fraction /= 10;
+        }
+        while (decimals[count - 1] == '0')
+            count--;
+
+        return put_char(out, '.') && put_raw(out, decimals, (size_t)count);
+    }
+
+    char text[32];
+    int length = snprintf(text, sizeof(text), "%.9g", value);
+    return length > 0 && put_raw(out, text, (size_t)length);
+}
+
+/**
+ * @brief Append a string between double quotes, escaped as JSON does. Runs of bytes which need no escaping
+ *        are copied at once
+ *
+ * @return false if it does not fit
+ */
+static bool put_quoted(kv_writer_t* out, const char* text)
+{
+    static const char hex[] = "0123456789abcdef";
+    const unsigned char* run = (const unsigned char*)text;
+    const unsigned char* s = run;
+
+    if (!put_char(out, '"'))
+        return false;
+
+    for (;; ++s)
+    {
+        char escape = kv_json_escapes[*s];
+
+        if (*s != NULL_CHAR && !escape)
+            continue;
+
+        if (!put_raw(out, (const char*)run, (size_t)(s - run)))
+            return false;
+        if (*s == NULL_CHAR)
+            break;
+
+        if (escape == 'u')
+        {
+            char unicode[6] = {'\\', 'u', '0', '0', hex[*s >> 4], hex[*s & 0x0f]};
+            if (!put_raw(out, unicode, sizeof(unicode)))
+                return false;
+        }
+        else
+        {
+            char pair[2] = {'\\', escape};
+            if (!put_raw(out, pair, sizeof(pair)))
+                return false;
+        }
+        run = s + 1;
+    }
+
+    return put_char(out, '"');
+}
+
+/**
+ * @brief Append a string: always quoted in JSON, only when it has to be in logfmt (empty, or with spaces,
+ *        '=', quotes, backslashes or control characters)
+ *
+ * @return false if it does not fit
+ */
+static bool put_string(kv_writer_t* out, const char* text, LOG_KV_FORMAT format)
+{
+    if (!text)
+        return format == LOG_KV_JSON ? put_raw(out, "null", 4) : put_raw(out, "\"\"", 2);
+
+    if (format == LOG_KV_LOGFMT && text[0] != NULL_CHAR)
+    {
+        const unsigned char* s = (const unsigned char*)text;
+
+        while (*s != NULL_CHAR && *s != ' ' && *s != '=' && !kv_json_escapes[*s])
+            s++;
+        if (*s == NULL_CHAR)
+            return put_raw(out, text, (size_t)(s - (const unsigned char*)text));
+    }
+
+    return put_quoted(out, text);
+}
+
+/**
+ * @brief Append the separator and the key of a field: ',"key":' in JSON, ' key=' in logfmt
+ *
+ * @return false if it does not fit
+ */
+static bool put_key(kv_writer_t* out, const char* key, LOG_KV_FORMAT format, bool first)
+{
+    if (format == LOG_KV_JSON)
+        return (first || put_char(out, ',')) && put_quoted(out, key) && put_char(out, ':');
+
+    return (first || put_char(out, ' ')) && put_raw(out, key, strlen(key)) && put_char(out, '=');
+}
+
+/**
+ * @brief Append the value of a field
+ *
+ * @return false if it does not fit
+ */
+static bool put_value(kv_writer_t* out, const log_kv_value_t* value, LOG_KV_FORMAT format)
+{
+    switch (value->type)
+    {
+        case LOG_KV_INT:
+            return put_int(out, value->value.i);
+        case LOG_KV_UINT:
+            return put_uint(out, value->value.u);
+        case LOG_KV_DOUBLE:
+            return put_double(out, value->value.d, format);
+        case LOG_KV_BOOL:
+            return value->value.b ? put_raw(out, "true", 4) : put_raw(out, "false", 5);
+        case LOG_KV_STRING:
+        default:
+            return put_string(out, value->value.s, format);
+    }
+}
+
+/**
+ * @brief Append the date and time as RFC 3339 in UTC, with milliseconds. The date is only rendered again when
+ *        the second changes
+ *
+ * @return false if it does not fit
+ */
+static bool put_timestamp(kv_writer_t* out, const struct timespec* timestamp)
+{
+    char fraction[5] = {'.', '0', '0', '0', 'Z'};
+    unsigned long ms = (unsigned long)timestamp->tv_nsec / 1000000UL;
+
+    if (__builtin_expect(kv_timestamp_cache.second != timestamp->tv_sec, 0))
+    {
+        struct tm tm;
+        gmtime_r(&timestamp->tv_sec, &tm);
+        strftime(kv_timestamp_cache.text, sizeof(kv_timestamp_cache.text), "%Y-%m-%dT%H:%M:%S", &tm);
+        kv_timestamp_cache.second = timestamp->tv_sec;
+    }
+
+    fraction[3] = (char)('0' + ms % 10);
+    fraction[2] = (char)('0' + ms / 10 % 10);
+    fraction[1] = (char)('0' + ms / 100);
+
+    return put_raw(out, kv_timestamp_cache.text, sizeof(kv_timestamp_cache.text) - 1) &&
+           put_raw(out, fraction, sizeof(fraction));
+}
+
+
+size_t log_internal_format_kv(char* line, size_t line_size, LOG_MSG_CATEGORY category, const struct timespec* timestamp,
+                              const char* msg, va_list* args, bool* truncated)
+{
+    LOG_KV_FORMAT format = __atomic_load_n(&kv_format, __ATOMIC_RELAXED);
+    kv_writer_t out = {.p = line, .end = line + line_size - KV_TRAILER_ROOM};
+    log_kv_value_t level = {.type = LOG_KV_STRING, .value.s = kv_levels[category]};
+    log_kv_value_t message = {.type = LOG_KV_STRING, .value.s = msg};
+    const char* key;
+    char* field;
+
+    *truncated = false;
+
+    if (format == LOG_KV_JSON)
+        put_char(&out, '{');
+
+    // the date, level and message always come first, so they never have to be looked for
+    field = out.p;
+    if (!(put_key(&out, "ts", format, true) && (format == LOG_KV_LOGFMT || put_char(&out, '"')) &&
+          put_timestamp(&out, timestamp) && (format == LOG_KV_LOGFMT || put_char(&out, '"')) &&
+          put_key(&out, "level", format, false) && put_value(&out, &level, format) &&
+          put_key(&out, "msg", format, false) && put_value(&out, &message, format)))
+    {
+        out.p = field;
+        *truncated = true;
+    }
+
+    // fields which do not fit are left out whole, so that the line always stays valid
+    while (!*truncated && (key = va_arg(*args, const char*)))
+    {
+        log_kv_value_t value = va_arg(*args, log_kv_value_t);
+
+        field = out.p;
+        if (!put_key(&out, key, format, false) || !put_value(&out, &value, format))
+        {
+            out.p = field;
+            *truncated = true;
+        }
+    }
+
+    if (format == LOG_KV_JSON)
+        *out.p++ = '}';
+    *out.p++ = '\n';
+    *out.p = NULL_CHAR;
+
+    return (size_t)(out.p - line);
+}
+
+
+int log_set_kv_format(LOG_KV_FORMAT format)
+{
+    if (format != LOG_KV_JSON && format != LOG_KV_LOGFMT)
+        return -1;
+
+    __atomic_store_n(&kv_format, format, __ATOMIC_RELAXED);
+    return 0;
+}
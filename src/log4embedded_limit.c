@@ -0,0 +1,321 @@
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "log4embedded.h"
+#include "log4embedded_internal.h"
+
+// Define the number of call sites the rate limiter keeps track of. Further call sites are not limited
+#define MAX_CALL_SITES      256
+
+// Define how many slots of the call site table are probed before giving up
+#define MAX_PROBES          16
+
+// Define the maximum size of a suppression report
+#define REPORT_SIZE         256
+
+// Define the FNV-1a hash constants
+#define FNV_OFFSET_BASIS    0xcbf29ce484222325ULL
+#define FNV_PRIME           0x100000001b3ULL
+
+// one call site of a print call, as seen by the rate limiter
+typedef struct {
+    uintptr_t key;                      // hash of the call site, 0 for a free slot. Claimed with a CAS
+    bool ready;                         // the fields below are set
+    LOG_MSG_CATEGORY category;
+    LOG_MSG_CATEGORY output_level;      // level of the log output the call site was last printed with
+    const char* fmt;
+    log_location_t location;
+    uint64_t tat;                       // theoretical arrival time of the next print call, in nanoseconds (GCRA)
+    uint64_t suppressed;                // print calls dropped since the last report
+} log_limit_site_t;
+
+// attributes of the rate limiter and the duplicate suppression
+typedef struct {
+    uint64_t interval_ns;               // nanoseconds between two print calls of a call site, 0 if not limited
+    uint64_t burst_ns;                  // how far ahead of time a call site may go: (burst - 1) * interval_ns
+    log_limit_site_t sites[MAX_CALL_SITES];
+
+    bool dedup_enabled;
+    uint64_t dedup_report_ns;           // how often a repeated log message is reported, while it keeps coming
+    uint64_t last_hash;                 // hash of the last log message written
+    LOG_MSG_CATEGORY last_category;
+    bool last_to_output;                // whether the last log message went to the log output, or to the other sinks only
+    uint64_t repeats;                   // times the last log message was repeated since the last report
+    uint64_t first_repeat_ns;
+} log_limit_t;
+
+static log_limit_t log_limit = {.interval_ns = 0,
+                                .burst_ns = 0,
+                                .dedup_enabled = false,
+                                .dedup_report_ns = 0,
+                                .last_hash = 0,
+                                .repeats = 0};
+
+
+/**
+ * @brief Monotonic time, from the coarse clock where available: a few milliseconds of resolution are plenty
+ *
+ * @return uint64_t nanoseconds
+ */
+static uint64_t now_ns()
+{
+    struct timespec now;
+
+#ifdef CLOCK_MONOTONIC_COARSE
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &now);
+#endif
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * @brief Hash of a call site: format string, source location and category. Never 0
+ *
+ * @param category
+ * @param location
+ * @param fmt
+ * @return uintptr_t
+ */
+static uintptr_t hash_call_site(LOG_MSG_CATEGORY category, const log_location_t* location, const char* fmt)
+{
+    uint64_t hash = (uint64_t)(uintptr_t)fmt * 0x9e3779b97f4a7c15ULL;
+
+    if (location && location->file)
+        hash ^= ((uint64_t)(uintptr_t)location->file + (uint64_t)location->line) * 0xc2b2ae3d27d4eb4fULL;
+    hash ^= (uint64_t)category;
+    hash ^= hash >> 29;
+
+    return (uintptr_t)hash ? (uintptr_t)hash : 1;
+}
+
+/**
+ * @brief Find the call site of a print call, or claim a free slot for it
+ *
+ * @return log_limit_site_t* NULL if the table is full, or the slot is still being claimed by another thread
+ */
+static log_limit_site_t* find_call_site(LOG_MSG_CATEGORY category, const log_location_t* location, const char* fmt)
+{
+    uintptr_t key = hash_call_site(category, location, fmt);
+
+    for (size_t probe = 0; probe < MAX_PROBES; ++probe)
+    {
+        log_limit_site_t* site = &log_limit.sites[(key + probe) & (MAX_CALL_SITES - 1)];
+        uintptr_t current = __atomic_load_n(&site->key, __ATOMIC_ACQUIRE);
+
+        if (current == 0)
+        {
+            if (!__atomic_compare_exchange_n(&site->key, &current, key, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            {
+                if (current != key)
+                    continue;
+            }
+            else
+            {
+                site->category = category;
+                site->output_level = LOG_MSG_NONE;
+                site->fmt = fmt;
+                site->location = location ? *location : (log_location_t){.file = NULL, .line = 0, .func = NULL};
+                __atomic_store_n(&site->tat, 0, __ATOMIC_RELAXED);
+                __atomic_store_n(&site->suppressed, 0, __ATOMIC_RELAXED);
+                __atomic_store_n(&site->ready, true, __ATOMIC_RELEASE);
+                return site;
+            }
+        }
+
+        if (current == key)
+            return __atomic_load_n(&site->ready, __ATOMIC_ACQUIRE) ? site : NULL;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Report how many print calls a call site dropped, through the usual print path (not rate limited)
+ *
+ * @param site
+ * @param suppressed
+ */
+static void report_call_site(const log_limit_site_t* site, uint64_t suppressed)
+{
+    if (site->location.file)
+        log_internal_print(site->category, __atomic_load_n(&site->output_level, __ATOMIC_RELAXED), &site->location, "Rate limit: %llu similar messages suppressed\n",
+                           (unsigned long long)suppressed);
+    else
+        log_internal_print(site->category, __atomic_load_n(&site->output_level, __ATOMIC_RELAXED), NULL, "Rate limit: %llu messages suppressed, such as \"%.40s\"\n",
+                           (unsigned long long)suppressed, site->fmt);
+}
+
+/**
+ * @brief Render a report of the duplicate suppression and write it right away, so that it is not taken as a
+ *        new log message itself
+ *
+ * @param category
+ * @param to_output whether it goes to the log output, or to the other sinks only
+ * @param fmt
+ * @param ...
+ */
+static void report_repeats(LOG_MSG_CATEGORY category, bool to_output, const char* fmt, ...)
+{
+    char line[REPORT_SIZE];
+    size_t message_offset;
+    size_t length;
+    va_list args;
+
+    va_start(args, fmt);
+    length = log_internal_format_line(line, sizeof(line), category, NULL, fmt, args, &message_offset);
+    va_end(args);
+
+    log_internal_output(category, to_output, line, length, message_offset, false);
+}
+
+/**
+ * @brief FNV-1a hash of a log message and its category. Never 0
+ *
+ * @param category
+ * @param message
+ * @param length
+ * @return uint64_t
+ */
+static uint64_t hash_message(LOG_MSG_CATEGORY category, const char* message, size_t length)
+{
+    uint64_t hash = FNV_OFFSET_BASIS ^ (uint64_t)category;
+
+    for (size_t i = 0; i < length; ++i)
+    {
+        hash ^= (unsigned char)message[i];
+        hash *= FNV_PRIME;
+    }
+
+    return hash ? hash : 1;
+}
+
+
+bool log_internal_limit_allow(LOG_MSG_CATEGORY category, LOG_MSG_CATEGORY output_level, const log_location_t* location,
+                              const char* fmt)
+{
+    uint64_t interval = __atomic_load_n(&log_limit.interval_ns, __ATOMIC_RELAXED);
+    log_limit_site_t* site;
+    uint64_t now, tat, next;
+    uint64_t suppressed;
+
+    // critical messages are never limited
+    if (interval == 0 || category == LOG_MSG_CRIT)
+        return true;
+
+    if (!(site = find_call_site(category, location, fmt)))
+        return true;
+
+    __atomic_store_n(&site->output_level, output_level, __ATOMIC_RELAXED);
+
+    // GCRA: a token bucket held in a single timestamp, updated with a CAS
+    now = now_ns();
+    tat = __atomic_load_n(&site->tat, __ATOMIC_RELAXED);
+    do
+    {
+        if (tat > now + __atomic_load_n(&log_limit.burst_ns, __ATOMIC_RELAXED))
+        {
+            __atomic_add_fetch(&site->suppressed, 1, __ATOMIC_RELAXED);
+            log_internal_stats_add(LOG_STAT_RATE_LIMITED, 1);
+            return false;
+        }
+        next = (tat > now ? tat : now) + interval;
+    } while (!__atomic_compare_exchange_n(&site->tat, &tat, next, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    // the call site is allowed again: tell how many print calls it dropped in the meantime
+    if (__atomic_load_n(&site->suppressed, __ATOMIC_RELAXED) > 0 &&
+        (suppressed = __atomic_exchange_n(&site->suppressed, 0, __ATOMIC_RELAXED)) > 0)
+        report_call_site(site, suppressed);
+
+    return true;
+}
+
+bool log_internal_limit_duplicate(LOG_MSG_CATEGORY category, bool to_output, const char* message, size_t length)
+{
+    uint64_t hash, previous, repeats;
+    LOG_MSG_CATEGORY previous_category;
+    bool previous_to_output;
+
+    if (!__atomic_load_n(&log_limit.dedup_enabled, __ATOMIC_RELAXED))
+        return false;
+
+    hash = hash_message(category, message, length);
+    previous = __atomic_exchange_n(&log_limit.last_hash, hash, __ATOMIC_ACQ_REL);
+    previous_category = __atomic_exchange_n(&log_limit.last_category, category, __ATOMIC_RELAXED);
+    previous_to_output = __atomic_exchange_n(&log_limit.last_to_output, to_output, __ATOMIC_RELAXED);
+
+    if (previous == hash)
+    {
+        uint64_t now = now_ns();
+
+        repeats = __atomic_add_fetch(&log_limit.repeats, 1, __ATOMIC_RELAXED);
+        if (repeats == 1)
+            __atomic_store_n(&log_limit.first_repeat_ns, now, __ATOMIC_RELAXED);
+        else if (now - __atomic_load_n(&log_limit.first_repeat_ns, __ATOMIC_RELAXED) >=
+                 __atomic_load_n(&log_limit.dedup_report_ns, __ATOMIC_RELAXED))
+        {
+            // the same log message keeps coming: report it periodically, and keep suppressing it
+            if ((repeats = __atomic_exchange_n(&log_limit.repeats, 0, __ATOMIC_RELAXED)) > 0)
+                report_repeats(category, to_output, "Last message repeated %llu times\n", (unsigned long long)repeats);
+        }
+        log_internal_stats_add(LOG_STAT_DUPLICATES, 1);
+        return true;
+    }
+
+    if ((repeats = __atomic_exchange_n(&log_limit.repeats, 0, __ATOMIC_RELAXED)) > 0)
+        report_repeats(previous_category, previous_to_output, "Last message repeated %llu times\n", (unsigned long long)repeats);
+
+    return false;
+}
+
+void log_internal_limit_report()
+{
+    uint64_t suppressed;
+
+    if ((suppressed = __atomic_exchange_n(&log_limit.repeats, 0, __ATOMIC_RELAXED)) > 0)
+        report_repeats(__atomic_load_n(&log_limit.last_category, __ATOMIC_RELAXED),
+                       __atomic_load_n(&log_limit.last_to_output, __ATOMIC_RELAXED), "Last message repeated %llu times\n",
+                       (unsigned long long)suppressed);
+
+    for (size_t i = 0; i < MAX_CALL_SITES; ++i)
+    {
+        log_limit_site_t* site = &log_limit.sites[i];
+
+        if (__atomic_load_n(&site->ready, __ATOMIC_ACQUIRE) && __atomic_load_n(&site->suppressed, __ATOMIC_RELAXED) > 0 &&
+            (suppressed = __atomic_exchange_n(&site->suppressed, 0, __ATOMIC_RELAXED)) > 0)
+            report_call_site(site, suppressed);
+    }
+}
+
+
+int log_set_rate_limit(unsigned int messages_per_second, unsigned int burst)
+{
+    if (messages_per_second > 0 && burst == 0)
+        return -1;
+
+    if (messages_per_second == 0)
+    {
+        __atomic_store_n(&log_limit.interval_ns, 0, __ATOMIC_RELAXED);
+        return 0;
+    }
+
+    __atomic_store_n(&log_limit.burst_ns, (uint64_t)(burst - 1) * (1000000000ULL / messages_per_second), __ATOMIC_RELAXED);
+    __atomic_store_n(&log_limit.interval_ns, 1000000000ULL / messages_per_second, __ATOMIC_RELAXED);
+    return 0;
+}
+
+void log_enable_duplicate_suppression(unsigned int report_interval_ms)
+{
+    __atomic_store_n(&log_limit.dedup_report_ns, (uint64_t)report_interval_ms * 1000000ULL, __ATOMIC_RELAXED);
+    __atomic_store_n(&log_limit.dedup_enabled, true, __ATOMIC_RELAXED);
+}
+
+void log_disable_duplicate_suppression()
+{
+    __atomic_store_n(&log_limit.dedup_enabled, false, __ATOMIC_RELAXED);
+    __atomic_store_n(&log_limit.last_hash, 0, __ATOMIC_RELAXED);
+}
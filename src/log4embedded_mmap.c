@@ -0,0 +1,368 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "log4embedded.h"
+#include "log4embedded_internal.h"
+
+// Define the minimum size of a memory-mapped segment, so that the longest log message always fits
+#define MIN_SEGMENT_SIZE    (64 * 1024)
+
+// one memory-mapped log file. Print calls reserve room with an atomic add on 'offset', then copy their log message.
+// Segments are never released, so that a print call holding an old pointer can still check whether it is current.
+typedef struct {
+    char* base;
+    size_t size;
+    size_t offset;                      // next free byte. It may go beyond 'size' once the segment is full
+    size_t end;                         // first reservation which did not fit: every log message before it is complete
+    int writers;                        // print calls currently copying into this segment
+    int fd;
+} log_segment_t;
+
+// attributes of the memory-mapped sink
+typedef struct {
+    log_segment_t segments[2];          // the current segment and the previous one, used in turns
+    log_segment_t* current;             // NULL while a full segment is being replaced, or if the sink is not in use
+    bool active;                        // whether the sink is in use
+    char file_name[LOG4EMBEDDED_MAX_PATH_SIZE];
+    size_t segment_size;
+    unsigned int sync_interval_ms;
+    unsigned long segment_count;        // gives every full segment a unique name until the rotation thread takes it
+    bool syncer_running;
+    bool stop_requested;
+    pthread_t syncer;
+    pthread_mutex_t lock;               // serializes segment roll over, msync and (re)configuration
+    pthread_cond_t wakeup;
+} log_mmap_t;
+
+static log_mmap_t log_mmap = {.current = NULL,
+                              .active = false,
+                              .segment_count = 0,
+                              .syncer_running = false,
+                              .lock = PTHREAD_MUTEX_INITIALIZER,
+                              .wakeup = PTHREAD_COND_INITIALIZER};
+
+
+/**
+ * @brief Cut a log file down to 'length' bytes. On failure, the zeroed tail stays in the file, and it is 
+ *        skipped when the file is opened again.
+ *
+ * @param fd
+ * @param length
+ * @return true on success
+ */
+static bool truncate_file(int fd, size_t length)
+{
+    return ftruncate(fd, (off_t)length) == 0;
+}
+
+/**
+ * @brief Length of the log messages already in a file, ignoring the zeroed tail of a preallocated segment
+ *        left behind by a crash
+ *
+ * @param fd
+ * @param file_size
+ * @return size_t
+ */
+static size_t used_length(int fd, size_t file_size)
+{
+    char* data;
+    size_t used = file_size;
+
+    if (file_size == 0)
+        return 0;
+
+    data = mmap(NULL, file_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED)
+        return file_size;
+
+    while (used > 0 && data[used - 1] == '\0')
+        --used;
+
+    munmap(data, file_size);
+    return used;
+}
+
+/**
+ * @brief Open 'file_name', preallocate a segment of 'segment_size' bytes and map it into 'segment'. Log messages
+ *        already in the file are kept, and new ones are appended after them. 'log_mmap.lock' must be held.
+ *
+ * @param segment
+ * @param file_name
+ * @param segment_size
+ * @return true on success
+ */
+static bool open_segment(log_segment_t* segment, const char* file_name, size_t segment_size)
+{
+    struct stat file_stat;
+    size_t used;
+
+    segment->fd = open(file_name, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (segment->fd < 0)
+        return false;
+
+    used = (fstat(segment->fd, &file_stat) == 0) ? used_length(segment->fd, (size_t)file_stat.st_size) : 0;
+
+    // a file already fuller than a segment is mapped as it is, so that the first log message rolls it over
+    segment->size = used > segment_size ? used : segment_size;
+
+    // allocate the blocks now, so that a full disk fails here rather than with a SIGBUS in a print call
+    if (posix_fallocate(segment->fd, 0, (off_t)segment->size) != 0 && !truncate_file(segment->fd, segment->size))
+    {
+        close(segment->fd);
+        return false;
+    }
+
+    segment->base = mmap(NULL, segment->size, PROT_READ | PROT_WRITE, MAP_SHARED, segment->fd, 0);
+    if (segment->base == MAP_FAILED)
+    {
+        truncate_file(segment->fd, used);
+        close(segment->fd);
+        return false;
+    }
+
+    // 'writers' is left alone: print calls holding an old pointer to this segment may still be counted in
+    segment->offset = used;
+    segment->end = segment->size;
+    return true;
+}
+
+/**
+ * @brief Wait for the print calls still copying into a segment no longer current, then sync it, unmap it and
+ *        cut the file down to the log messages actually written. 'log_mmap.lock' must be held.
+ *
+ * @param segment
+ */
+static void close_segment(log_segment_t* segment)
+{
+    size_t used;
+
+    while (__atomic_load_n(&segment->writers, __ATOMIC_SEQ_CST) > 0)
+        sched_yield();
+
+    used = __atomic_load_n(&segment->offset, __ATOMIC_ACQUIRE);
+    if (used > segment->end)
+        used = segment->end;
+
+    msync(segment->base, segment->size, MS_SYNC);
+    munmap(segment->base, segment->size);
+    truncate_file(segment->fd, used);
+    close(segment->fd);
+}
+
+/**
+ * @brief Record that the reservation starting at 'start' did not fit in 'segment'
+ *
+ * @param segment
+ * @param start
+ */
+static void seal_segment(log_segment_t* segment, size_t start)
+{
+    size_t end = __atomic_load_n(&segment->end, __ATOMIC_RELAXED);
+
+    while (start < end &&
+           !__atomic_compare_exchange_n(&segment->end, &end, start, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+/**
+ * @brief Replace a full segment with a new one. The full segment goes through the log rotation, if
+ *        configured, or is kept as the first rotated log file otherwise.
+ *
+ * @param full
+ */
+static void roll_segment(log_segment_t* full)
+{
+    char segment_name[LOG4EMBEDDED_MAX_PATH_SIZE + 32];
+    size_t max_file_size;
+    unsigned int max_files;
+    LOG_COMPRESSION compression;
+    log_segment_t* next = (full == &log_mmap.segments[0]) ? &log_mmap.segments[1] : &log_mmap.segments[0];
+
+    pthread_mutex_lock(&log_mmap.lock);
+
+    // somebody else rolled it over already
+    if (__atomic_load_n(&log_mmap.current, __ATOMIC_SEQ_CST) != full)
+    {
+        pthread_mutex_unlock(&log_mmap.lock);
+        return;
+    }
+
+    // print calls wait for the new segment on 'log_mmap.lock' meanwhile
+    __atomic_store_n(&log_mmap.current, NULL, __ATOMIC_SEQ_CST);
+    close_segment(full);
+
+    log_internal_rotation_settings(&max_file_size, &max_files, &compression);
+    snprintf(segment_name, sizeof(segment_name), "%s.%lu.segment", log_mmap.file_name, log_mmap.segment_count++);
+    if (rename(log_mmap.file_name, segment_name) == 0)
+        log_internal_rotate_submit(log_mmap.file_name, segment_name, max_files > 0 ? max_files : 1, compression);
+
+    // on failure, the sink is closed and log messages go back to the regular output
+    if (open_segment(next, log_mmap.file_name, log_mmap.segment_size))
+        __atomic_store_n(&log_mmap.current, next, __ATOMIC_SEQ_CST);
+    else
+        __atomic_store_n(&log_mmap.active, false, __ATOMIC_SEQ_CST);
+
+    pthread_mutex_unlock(&log_mmap.lock);
+}
+
+/**
+ * @brief Sync thread: msync the current segment every 'sync_interval_ms' milliseconds
+ *
+ * @param arg
+ * @return void*
+ */
+static void* sync_thread(void* arg)
+{
+    (void)arg;
+
+    pthread_mutex_lock(&log_mmap.lock);
+    while (!log_mmap.stop_requested)
+    {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += log_mmap.sync_interval_ms / 1000;
+        deadline.tv_nsec += (long)(log_mmap.sync_interval_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L)
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&log_mmap.wakeup, &log_mmap.lock, &deadline);
+
+        // segments are only replaced with 'log_mmap.lock' held, so this one stays mapped meanwhile
+        log_segment_t* segment = log_mmap.current;
+        if (segment)
+            msync(segment->base, segment->size, MS_SYNC);
+    }
+    pthread_mutex_unlock(&log_mmap.lock);
+
+    return NULL;
+}
+
+/**
+ * @brief Stop the sync thread, if running. 'log_mmap.lock' must NOT be held.
+ *
+ */
+static void stop_sync_thread()
+{
+    pthread_mutex_lock(&log_mmap.lock);
+    if (!log_mmap.syncer_running)
+    {
+        pthread_mutex_unlock(&log_mmap.lock);
+        return;
+    }
+    log_mmap.stop_requested = true;
+    pthread_cond_signal(&log_mmap.wakeup);
+    pthread_mutex_unlock(&log_mmap.lock);
+
+    pthread_join(log_mmap.syncer, NULL);
+    log_mmap.syncer_running = false;
+}
+
+
+bool log_internal_mmap_enabled()
+{
+    return __atomic_load_n(&log_mmap.active, __ATOMIC_RELAXED);
+}
+
+bool log_internal_mmap_write(const char* line, size_t length)
+{
+    for (;;)
+    {
+        log_segment_t* segment = __atomic_load_n(&log_mmap.current, __ATOMIC_SEQ_CST);
+        size_t start;
+
+        if (!segment)
+        {
+            if (!__atomic_load_n(&log_mmap.active, __ATOMIC_SEQ_CST))
+                return false;
+
+            // a full segment is being replaced: wait for the new one
+            pthread_mutex_lock(&log_mmap.lock);
+            pthread_mutex_unlock(&log_mmap.lock);
+            continue;
+        }
+
+        // register as a writer, then make sure the segment has not been replaced in the meantime
+        __atomic_add_fetch(&segment->writers, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&log_mmap.current, __ATOMIC_SEQ_CST) != segment)
+        {
+            __atomic_sub_fetch(&segment->writers, 1, __ATOMIC_RELEASE);
+            continue;
+        }
+
+        start = __atomic_fetch_add(&segment->offset, length, __ATOMIC_RELAXED);
+        if (start + length <= segment->size)
+        {
+            memcpy(segment->base + start, line, length);
+            __atomic_sub_fetch(&segment->writers, 1, __ATOMIC_RELEASE);
+            return true;
+        }
+
+        seal_segment(segment, start);
+        __atomic_sub_fetch(&segment->writers, 1, __ATOMIC_RELEASE);
+        roll_segment(segment);
+    }
+}
+
+void log_internal_mmap_sync()
+{
+    pthread_mutex_lock(&log_mmap.lock);
+    if (log_mmap.current)
+        msync(log_mmap.current->base, log_mmap.current->size, MS_SYNC);
+    pthread_mutex_unlock(&log_mmap.lock);
+}
+
+void log_internal_mmap_close()
+{
+    stop_sync_thread();
+
+    pthread_mutex_lock(&log_mmap.lock);
+    log_segment_t* segment = log_mmap.current;
+    __atomic_store_n(&log_mmap.active, false, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&log_mmap.current, NULL, __ATOMIC_SEQ_CST);
+    if (segment)
+        close_segment(segment);
+    pthread_mutex_unlock(&log_mmap.lock);
+}
+
+int log_internal_mmap_open(const char* filepath, size_t segment_size, unsigned int sync_interval_ms)
+{
+    log_segment_t* segment;
+
+    log_internal_mmap_close();
+
+    if (segment_size < MIN_SEGMENT_SIZE)
+        segment_size = MIN_SEGMENT_SIZE;
+
+    pthread_mutex_lock(&log_mmap.lock);
+    snprintf(log_mmap.file_name, sizeof(log_mmap.file_name), "%s", filepath);
+    log_mmap.segment_size = segment_size;
+    log_mmap.sync_interval_ms = sync_interval_ms;
+
+    segment = &log_mmap.segments[0];
+    if (!open_segment(segment, log_mmap.file_name, segment_size))
+    {
+        pthread_mutex_unlock(&log_mmap.lock);
+        return -1;
+    }
+    __atomic_store_n(&log_mmap.current, segment, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&log_mmap.active, true, __ATOMIC_SEQ_CST);
+
+    if (sync_interval_ms > 0)
+    {
+        log_mmap.stop_requested = false;
+        log_mmap.syncer_running = (pthread_create(&log_mmap.syncer, NULL, sync_thread, NULL) == 0);
+    }
+    pthread_mutex_unlock(&log_mmap.lock);
+
+    return 0;
+}
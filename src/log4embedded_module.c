@@ -0,0 +1,219 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "log4embedded.h"
+#include "log4embedded_internal.h"
+
+// Define the bits of the generation counter, as stored in the state of a call site
+#define GENERATION_MASK     0xffffffU
+
+// level of the modules matching a pattern
+typedef struct {
+    char pattern[LOG_MAX_MODULE_NAME];
+    size_t length;
+    bool wildcard;                      // pattern ending in "*": 'pattern' holds what comes before it
+    LOG_MSG_CATEGORY level;
+} log_module_level_t;
+
+// attributes of the per-module log levels
+typedef struct {
+    log_module_level_t levels[LOG_MAX_MODULE_LEVELS];
+    size_t count;
+    pthread_mutex_t lock;               // serializes changes of the patterns, and the call sites resolving their level
+} log_modules_t;
+
+static log_modules_t log_modules = {.count = 0,
+                                    .lock = PTHREAD_MUTEX_INITIALIZER};
+
+// Generation of the module levels, which every call site of the LOG_* macros caches its state against.
+// Never 0, so that call sites start out stale. Exported for the inline check of the LOG_* macros, read atomically
+uint32_t log4embedded_generation = 1;
+
+
+/**
+ * @brief Split a pattern into the text to match and whether it is a wildcard
+ *
+ * @param pattern
+ * @param entry
+ * @return true if the pattern is valid
+ */
+static bool parse_pattern(const char* pattern, log_module_level_t* entry)
+{
+    size_t length = strlen(pattern);
+
+    if (length == 0 || length >= LOG_MAX_MODULE_NAME)
+        return false;
+
+    // only a trailing '*' is a wildcard
+    if (memchr(pattern, '*', length - 1))
+        return false;
+
+    entry->wildcard = pattern[length - 1] == '*';
+    entry->length = entry->wildcard ? length - 1 : length;
+    memcpy(entry->pattern, pattern, entry->length);
+    entry->pattern[entry->length] = '\0';
+    return true;
+}
+
+/**
+ * @brief Find the pattern which is the same as 'entry'. The lock must be held
+ *
+ * @param entry
+ * @return log_module_level_t* NULL if there is none
+ */
+static log_module_level_t* find_pattern(const log_module_level_t* entry)
+{
+    for (size_t i = 0; i < log_modules.count; ++i)
+    {
+        log_module_level_t* level = &log_modules.levels[i];
+
+        if (level->wildcard == entry->wildcard && level->length == entry->length &&
+            memcmp(level->pattern, entry->pattern, entry->length) == 0)
+            return level;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Level of a module: the one of the most specific pattern it matches (the exact name, then the longest
+ *        wildcard), or the level of the log output if none matches. The lock must be held
+ *
+ * @param module
+ * @return LOG_MSG_CATEGORY
+ */
+static LOG_MSG_CATEGORY match_module(const char* module)
+{
+    const log_module_level_t* best = NULL;
+    size_t length = strlen(module);
+
+    for (size_t i = 0; i < log_modules.count; ++i)
+    {
+        const log_module_level_t* level = &log_modules.levels[i];
+
+        if (level->wildcard ? (level->length > length || memcmp(level->pattern, module, level->length) != 0)
+                            : (level->length != length || memcmp(level->pattern, module, length) != 0))
+            continue;
+
+        if (!best || (!level->wildcard && best->wildcard) ||
+            (level->wildcard == best->wildcard && level->length > best->length))
+            best = level;
+    }
+
+    return best ? best->level : log_get_level();
+}
+
+/**
+ * @brief Make every call site resolve its level again, on its next print call
+ *
+ */
+static void bump_generation()
+{
+    uint32_t generation = __atomic_load_n(&log4embedded_generation, __ATOMIC_RELAXED);
+    uint32_t next;
+
+    do
+    {
+        next = (generation + 1) & GENERATION_MASK;
+        if (next == 0)
+            next = 1;
+    } while (!__atomic_compare_exchange_n(&log4embedded_generation, &generation, next, true, __ATOMIC_RELEASE,
+                                          __ATOMIC_RELAXED));
+}
+
+
+void log_internal_modules_invalidate()
+{
+    bump_generation();
+}
+
+
+uint32_t log_module_resolve(const char* module, uint32_t* site)
+{
+    LOG_MSG_CATEGORY level;
+    LOG_MSG_CATEGORY gate;
+    LOG_MSG_CATEGORY sinks_level;
+    uint32_t generation;
+    uint32_t state;
+
+    pthread_mutex_lock(&log_modules.lock);
+
+    // taken first: if anything changes meanwhile, the call site is stale again and resolves its level once more
+    generation = __atomic_load_n(&log4embedded_generation, __ATOMIC_ACQUIRE);
+    level = module ? match_module(module) : log_get_level();
+
+    // print calls must also go through for the other sinks and the flight recorder
+    gate = level;
+    sinks_level = log_internal_sinks_level();
+    if (sinks_level > gate)
+        gate = sinks_level;
+    if (log_internal_recorder_enabled())
+        gate = LOG_MSG_DBG;
+
+    state = (generation << 8) | ((uint32_t)gate << 4) | (uint32_t)level;
+    __atomic_store_n(site, state, __ATOMIC_RELAXED);
+
+    pthread_mutex_unlock(&log_modules.lock);
+    return state;
+}
+
+int log_set_module_level(const char* pattern, LOG_MSG_CATEGORY level)
+{
+    log_module_level_t entry;
+    log_module_level_t* existing;
+
+    if (!pattern || level < LOG_MSG_NONE || level > LOG_MSG_DBG || !parse_pattern(pattern, &entry))
+        return -1;
+
+    entry.level = level;
+
+    pthread_mutex_lock(&log_modules.lock);
+    if ((existing = find_pattern(&entry)))
+        existing->level = level;
+    else if (log_modules.count < LOG_MAX_MODULE_LEVELS)
+        log_modules.levels[log_modules.count++] = entry;
+    else
+    {
+        pthread_mutex_unlock(&log_modules.lock);
+        return -1;
+    }
+    bump_generation();
+    pthread_mutex_unlock(&log_modules.lock);
+    return 0;
+}
+
+int log_remove_module_level(const char* pattern)
+{
+    log_module_level_t entry;
+    log_module_level_t* existing;
+
+    if (!pattern || !parse_pattern(pattern, &entry))
+        return -1;
+
+    pthread_mutex_lock(&log_modules.lock);
+    if (!(existing = find_pattern(&entry)))
+    {
+        pthread_mutex_unlock(&log_modules.lock);
+        return -1;
+    }
+    *existing = log_modules.levels[--log_modules.count];
+    bump_generation();
+    pthread_mutex_unlock(&log_modules.lock);
+    return 0;
+}
+
+LOG_MSG_CATEGORY log_get_module_level(const char* module)
+{
+    LOG_MSG_CATEGORY level;
+
+    if (!module)
+        return log_get_level();
+
+    pthread_mutex_lock(&log_modules.lock);
+    level = match_module(module);
+    pthread_mutex_unlock(&log_modules.lock);
+    return level;
+}
@@ -0,0 +1,213 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sched.h>
+
+#include "log4embedded.h"
+#include "log4embedded_internal.h"
+
+// Define the minimum size of the flight recorder ring
+#define MIN_RING_SIZE       4096
+
+// Define the banners written around the content of the flight recorder
+#define DUMP_BEGIN_BANNER   "----- log4embedded flight recorder: begin -----\n"
+#define DUMP_END_BANNER     "----- log4embedded flight recorder: end -----\n"
+
+// attributes of the flight recorder
+typedef struct {
+    char* ring;
+    size_t mask;                        // ring size - 1
+    bool running;
+    uint64_t head;                      // bytes ever written into the ring. The ring holds the last 'mask + 1' of them
+    uint64_t dumped;                    // value of 'head' at the last dump, so that a log message is only dumped once
+    int active_producers;               // print calls currently writing into the ring
+    int dumping;                        // a dump is in progress, so that a crash while dumping does not dump again
+    struct sigaction previous[NSIG];    // signal handlers to restore
+} log_recorder_t;
+
+static log_recorder_t log_recorder = {.ring = NULL,
+                                      .running = false,
+                                      .head = 0,
+                                      .dumped = 0,
+                                      .active_producers = 0,
+                                      .dumping = 0};
+
+// fatal signals which dump the flight recorder before the application dies
+static const int fatal_signals[] = {SIGSEGV, SIGABRT, SIGBUS, SIGFPE, SIGILL};
+
+
+/**
+ * @brief write() everything, retrying on partial writes. Async-signal-safe.
+ *
+ * @param fd
+ * @param buffer
+ * @param length
+ */
+static void write_all(int fd, const char* buffer, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t ret = write(fd, buffer, length);
+        if (ret <= 0)
+            return;
+        buffer += ret;
+        length -= (size_t)ret;
+    }
+}
+
+/**
+ * @brief Write the log messages stored since the last dump into 'fd', oldest first. Only async-signal-safe calls.
+ *
+ * @param fd
+ */
+static void dump_ring(int fd)
+{
+    uint64_t end = __atomic_load_n(&log_recorder.head, __ATOMIC_ACQUIRE);
+    uint64_t begin = end > log_recorder.mask + 1 ? end - (log_recorder.mask + 1) : 0;
+    uint64_t dumped = __atomic_load_n(&log_recorder.dumped, __ATOMIC_RELAXED);
+    bool cut = begin > 0;
+
+    if (begin < dumped)
+    {
+        begin = dumped;
+        cut = false;
+    }
+
+    if (begin >= end)
+        return;
+
+    // the oldest log message may have been partially overwritten: skip to the next one
+    if (cut)
+    {
+        while (begin < end && log_recorder.ring[begin & log_recorder.mask] != '\n')
+            begin++;
+        begin++;
+        if (begin >= end)
+            return;
+    }
+
+    write_all(fd, DUMP_BEGIN_BANNER, sizeof(DUMP_BEGIN_BANNER) - 1);
+
+    size_t start = (size_t)(begin & log_recorder.mask);
+    size_t length = (size_t)(end - begin);
+    size_t first = length < log_recorder.mask + 1 - start ? length : log_recorder.mask + 1 - start;
+    write_all(fd, log_recorder.ring + start, first);
+    write_all(fd, log_recorder.ring, length - first);
+
+    write_all(fd, DUMP_END_BANNER, sizeof(DUMP_END_BANNER) - 1);
+    __atomic_store_n(&log_recorder.dumped, end, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Fatal signal handler: dump the flight recorder, then let the previous handler (or the default action)
+ *        take care of the signal
+ *
+ * @param sig
+ */
+static void fatal_signal_handler(int sig)
+{
+    if (__atomic_exchange_n(&log_recorder.dumping, 1, __ATOMIC_ACQ_REL) == 0)
+        dump_ring(log_internal_output_fd());
+
+    sigaction(sig, &log_recorder.previous[sig], NULL);
+    raise(sig);
+}
+
+
+bool log_internal_recorder_enabled()
+{
+    return __atomic_load_n(&log_recorder.running, __ATOMIC_RELAXED);
+}
+
+void log_internal_recorder_write(const char* line, size_t length)
+{
+    // register as a producer before checking the mode, so that log_flight_recorder_stop waits for us
+    __atomic_add_fetch(&log_recorder.active_producers, 1, __ATOMIC_SEQ_CST);
+    if (!__atomic_load_n(&log_recorder.running, __ATOMIC_SEQ_CST))
+    {
+        __atomic_sub_fetch(&log_recorder.active_producers, 1, __ATOMIC_RELEASE);
+        return;
+    }
+
+    // log messages longer than a quarter of the ring would wipe out too much history: keep their end only
+    size_t ring_size = log_recorder.mask + 1;
+    if (length > ring_size / 4)
+    {
+        line += length - ring_size / 4;
+        length = ring_size / 4;
+    }
+
+    uint64_t pos = __atomic_fetch_add(&log_recorder.head, length, __ATOMIC_ACQ_REL);
+    size_t start = (size_t)(pos & log_recorder.mask);
+    size_t first = length < ring_size - start ? length : ring_size - start;
+    memcpy(log_recorder.ring + start, line, first);
+    memcpy(log_recorder.ring, line + first, length - first);
+
+    __atomic_sub_fetch(&log_recorder.active_producers, 1, __ATOMIC_RELEASE);
+}
+
+void log_internal_recorder_dump(int fd)
+{
+    if (!log_internal_recorder_enabled())
+        return;
+
+    if (__atomic_exchange_n(&log_recorder.dumping, 1, __ATOMIC_ACQ_REL) == 0)
+    {
+        dump_ring(fd);
+        __atomic_store_n(&log_recorder.dumping, 0, __ATOMIC_RELEASE);
+    }
+}
+
+
+int log_flight_recorder_start(size_t ring_size)
+{
+    size_t size = MIN_RING_SIZE;
+    struct sigaction action;
+
+    if (log_internal_recorder_enabled())
+        return 0;
+
+    while (size < ring_size)
+        size <<= 1;
+
+    log_recorder.ring = malloc(size);
+    if (!log_recorder.ring)
+        return -1;
+
+    log_recorder.mask = size - 1;
+    log_recorder.head = 0;
+    log_recorder.dumped = 0;
+    log_recorder.dumping = 0;
+
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = fatal_signal_handler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_ONSTACK;
+    for (size_t i = 0; i < sizeof(fatal_signals) / sizeof(fatal_signals[0]); ++i)
+        sigaction(fatal_signals[i], &action, &log_recorder.previous[fatal_signals[i]]);
+
+    __atomic_store_n(&log_recorder.running, true, __ATOMIC_SEQ_CST);
+    log_internal_update_level();
+    return 0;
+}
+
+void log_flight_recorder_stop()
+{
+    if (!log_internal_recorder_enabled())
+        return;
+
+    __atomic_store_n(&log_recorder.running, false, __ATOMIC_SEQ_CST);
+    log_internal_update_level();
+
+    for (size_t i = 0; i < sizeof(fatal_signals) / sizeof(fatal_signals[0]); ++i)
+        sigaction(fatal_signals[i], &log_recorder.previous[fatal_signals[i]], NULL);
+
+    while (__atomic_load_n(&log_recorder.active_producers, __ATOMIC_ACQUIRE) > 0)
+        sched_yield();
+
+    free(log_recorder.ring);
+    log_recorder.ring = NULL;
+}
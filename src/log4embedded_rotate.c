@@ -0,0 +1,299 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#ifdef LOG4EMBEDDED_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "log4embedded.h"
+#include "log4embedded_internal.h"
+
+// Define the extension of gzip-compressed log files
+#define GZIP_EXTENSION  ".gz"
+
+// Define the size of the chunks a rotated log file is compressed in
+#define COMPRESS_CHUNK_SIZE     4096
+
+// one rotated log file waiting to take its place among the older ones
+typedef struct log_rotate_job {
+    struct log_rotate_job* next;
+    char file_name[LOG4EMBEDDED_MAX_PATH_SIZE];
+    char segment_name[LOG4EMBEDDED_MAX_PATH_SIZE + 32];
+    unsigned int max_files;
+    LOG_COMPRESSION compression;
+} log_rotate_job_t;
+
+// attributes of the rotation thread
+typedef struct {
+    log_rotate_job_t* head;
+    log_rotate_job_t* tail;
+    bool running;
+    bool busy;                          // a job has been taken out of the queue, but is not finished yet
+    bool stop_requested;
+    pthread_t worker;
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+    pthread_cond_t idle;
+} log_rotate_t;
+
+static log_rotate_t log_rotate = {.head = NULL,
+                                  .tail = NULL,
+                                  .running = false,
+                                  .busy = false,
+                                  .stop_requested = false,
+                                  .lock = PTHREAD_MUTEX_INITIALIZER,
+                                  .wakeup = PTHREAD_COND_INITIALIZER,
+                                  .idle = PTHREAD_COND_INITIALIZER};
+
+
+/**
+ * @brief Build the name of the rotated log file number 'index': "log.txt" --> "log.<index>.txt" (+ 'suffix').
+ *        Files with no extension just get the index appended: "log" --> "log.<index>".
+ *
+ * @param out
+ * @param out_size
+ * @param file_name
+ * @param index
+ * @param suffix
+ */
+static void rotated_name(char* out, size_t out_size, const char* file_name, unsigned int index, const char* suffix)
+{
+    const char* slash = strrchr(file_name, '/');
+    const char* dot = strrchr(slash ? slash + 1 : file_name, '.');
+
+    // hidden files such as ".log" have no extension
+    if (!dot || dot == (slash ? slash + 1 : file_name))
+        snprintf(out, out_size, "%s.%u%s", file_name, index, suffix);
+    else
+        snprintf(out, out_size, "%.*s.%u%s%s", (int)(dot - file_name), file_name, index, dot, suffix);
+}
+
+/**
+ * @brief Compress 'source' into 'destination' with gzip. The destination only shows up once it is complete.
+ *
+ * @param source
+ * @param destination
+ * @return true on success
+ */
+static bool compress_file(const char* source, const char* destination)
+{
+#ifdef LOG4EMBEDDED_HAVE_ZLIB
+    char temp_name[LOG4EMBEDDED_MAX_PATH_SIZE + 48];
+    char chunk[COMPRESS_CHUNK_SIZE];
+    bool ok = true;
+    ssize_t len;
+    gzFile out;
+    int in;
+
+    in = open(source, O_RDONLY | O_CLOEXEC);
+    if (in < 0)
+        return false;
+
+    snprintf(temp_name, sizeof(temp_name), "%s.tmp", destination);
+    out = gzopen(temp_name, "wb");
+    if (!out)
+    {
+        close(in);
+        return false;
+    }
+
+    while ((len = read(in, chunk, sizeof(chunk))) > 0)
+    {
+        if (gzwrite(out, chunk, (unsigned int)len) != (int)len)
+        {
+            ok = false;
+            break;
+        }
+    }
+
+    if (len < 0)
+        ok = false;
+
+    close(in);
+    if (gzclose(out) != Z_OK)
+        ok = false;
+
+    if (ok && rename(temp_name, destination) == 0)
+        return true;
+
+    unlink(temp_name);
+    return false;
+#else
+    (void)source;
+    (void)destination;
+    return false;
+#endif
+}
+
+/**
+ * @brief Make room for a rotated log file: remove the oldest rotated file, shift the rest one position up,
+ *        and store the rotated log file as number 1, compressed if requested.
+ *
+ * @param job
+ */
+static void run_job(const log_rotate_job_t* job)
+{
+    char from[LOG4EMBEDDED_MAX_PATH_SIZE + 32];
+    char to[LOG4EMBEDDED_MAX_PATH_SIZE + 32];
+    static const char* suffixes[] = {"", GZIP_EXTENSION};
+
+    // both variants are handled, in case compression was switched on or off in the meantime
+    for (size_t i = 0; i < sizeof(suffixes) / sizeof(suffixes[0]); ++i)
+    {
+        rotated_name(to, sizeof(to), job->file_name, job->max_files, suffixes[i]);
+        unlink(to);
+
+        for (unsigned int index = job->max_files; index > 1; --index)
+        {
+            rotated_name(from, sizeof(from), job->file_name, index - 1, suffixes[i]);
+            rotated_name(to, sizeof(to), job->file_name, index, suffixes[i]);
+            rename(from, to);
+        }
+    }
+
+    if (job->compression == LOG_COMPRESS_GZIP)
+    {
+        rotated_name(to, sizeof(to), job->file_name, 1, GZIP_EXTENSION);
+        if (compress_file(job->segment_name, to))
+        {
+            unlink(job->segment_name);
+            return;
+        }
+    }
+
+    // not compressed, or compression failed: keep the rotated log file as it is
+    rotated_name(to, sizeof(to), job->file_name, 1, "");
+    rename(job->segment_name, to);
+}
+
+/**
+ * @brief Rotation thread: run queued jobs in order, and sleep whenever there is none
+ *
+ * @param arg
+ * @return void*
+ */
+static void* rotate_thread(void* arg)
+{
+    (void)arg;
+
+    pthread_mutex_lock(&log_rotate.lock);
+    for (;;)
+    {
+        log_rotate_job_t* job = log_rotate.head;
+
+        if (!job)
+        {
+            pthread_cond_broadcast(&log_rotate.idle);
+            if (log_rotate.stop_requested)
+                break;
+            pthread_cond_wait(&log_rotate.wakeup, &log_rotate.lock);
+            continue;
+        }
+
+        log_rotate.head = job->next;
+        if (!log_rotate.head)
+            log_rotate.tail = NULL;
+        log_rotate.busy = true;
+        pthread_mutex_unlock(&log_rotate.lock);
+
+        run_job(job);
+        free(job);
+
+        pthread_mutex_lock(&log_rotate.lock);
+        log_rotate.busy = false;
+    }
+    pthread_mutex_unlock(&log_rotate.lock);
+
+    return NULL;
+}
+
+
+bool log_internal_compression_available(LOG_COMPRESSION compression)
+{
+#ifdef LOG4EMBEDDED_HAVE_ZLIB
+    return compression == LOG_COMPRESS_NONE || compression == LOG_COMPRESS_GZIP;
+#else
+    return compression == LOG_COMPRESS_NONE;
+#endif
+}
+
+void log_internal_rotate_submit(const char* file_name, const char* segment_name, unsigned int max_files, LOG_COMPRESSION compression)
+{
+    log_rotate_job_t* job = malloc(sizeof(log_rotate_job_t));
+    log_rotate_job_t local_job;
+    bool queued = false;
+
+    if (!job)
+        job = &local_job;
+
+    job->next = NULL;
+    snprintf(job->file_name, sizeof(job->file_name), "%s", file_name);
+    snprintf(job->segment_name, sizeof(job->segment_name), "%s", segment_name);
+    job->max_files = max_files;
+    job->compression = compression;
+
+    if (job != &local_job)
+    {
+        pthread_mutex_lock(&log_rotate.lock);
+        if (!log_rotate.running)
+        {
+            log_rotate.stop_requested = false;
+            log_rotate.running = (pthread_create(&log_rotate.worker, NULL, rotate_thread, NULL) == 0);
+        }
+
+        if (log_rotate.running)
+        {
+            if (log_rotate.tail)
+                log_rotate.tail->next = job;
+            else
+                log_rotate.head = job;
+            log_rotate.tail = job;
+            pthread_cond_signal(&log_rotate.wakeup);
+            queued = true;
+        }
+        pthread_mutex_unlock(&log_rotate.lock);
+    }
+
+    // no memory or no thread: do the job right away, after any pending one
+    if (!queued)
+    {
+        log_internal_rotate_drain();
+        run_job(job);
+        if (job != &local_job)
+            free(job);
+    }
+}
+
+void log_internal_rotate_drain()
+{
+    pthread_mutex_lock(&log_rotate.lock);
+    while (log_rotate.running && (log_rotate.head || log_rotate.busy))
+        pthread_cond_wait(&log_rotate.idle, &log_rotate.lock);
+    pthread_mutex_unlock(&log_rotate.lock);
+}
+
+void log_internal_rotate_stop()
+{
+    pthread_mutex_lock(&log_rotate.lock);
+    if (!log_rotate.running)
+    {
+        pthread_mutex_unlock(&log_rotate.lock);
+        return;
+    }
+
+    // the thread runs every pending job before exiting
+    log_rotate.stop_requested = true;
+    pthread_cond_signal(&log_rotate.wakeup);
+    pthread_mutex_unlock(&log_rotate.lock);
+
+    pthread_join(log_rotate.worker, NULL);
+
+    pthread_mutex_lock(&log_rotate.lock);
+    log_rotate.running = false;
+    pthread_mutex_unlock(&log_rotate.lock);
+}
@@ -0,0 +1,553 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <syslog.h>
+
+// syslog.h defines LOG_CRIT, LOG_ERR, LOG_INFO and LOG_DEBUG as priorities, which log4embedded.h uses as call-site macros:
+// keep the priorities under other names before including it
+enum {
+    SYSLOG_PRIORITY_CRIT = LOG_CRIT,
+    SYSLOG_PRIORITY_ERR = LOG_ERR,
+    SYSLOG_PRIORITY_WARNING = LOG_WARNING,
+    SYSLOG_PRIORITY_INFO = LOG_INFO,
+    SYSLOG_PRIORITY_DEBUG = LOG_DEBUG
+};
+#undef LOG_CRIT
+#undef LOG_ERR
+#undef LOG_INFO
+#undef LOG_DEBUG
+
+#include "log4embedded.h"
+#include "log4embedded_internal.h"
+
+// Define the escape sequence closing a colored log message
+#define ANSI_COLOR_RESET    "\x1b[0m"
+
+// one sink added via log_add_sink
+typedef struct {
+    bool used;
+    log_sink_ops_t ops;
+    void* context;
+    LOG_MSG_CATEGORY level;             // read atomically on every print call
+    bool colors;
+    LOG_SINK_FORMAT format;
+    pthread_mutex_t lock;               // serializes the operations of the sink
+} log_sink_t;
+
+// sinks added via log_add_sink, besides the default one
+typedef struct {
+    log_sink_t sinks[LOG_MAX_SINKS];
+    LOG_MSG_CATEGORY max_level;         // most verbose level of the sinks, read atomically on every print call
+    pthread_rwlock_t lock;              // print calls read the table, adding and removing sinks writes it
+} log_sinks_t;
+
+static log_sinks_t log_sinks = {.max_level = LOG_MSG_NONE,
+                                .lock = PTHREAD_RWLOCK_INITIALIZER};
+
+// context of the sinks writing into a file descriptor
+typedef struct {
+    int fd;
+    bool owned;                         // the file descriptor is closed along with the sink
+} log_fd_sink_t;
+
+// context of the syslog sink. The connection and ident of syslog are process-wide, so there is one sink at most
+typedef struct {
+    bool in_use;                        // a syslog sink is added
+    bool opened;                        // openlog() was called by the sink: closelog() is its own to call
+    const char* ident;
+} log_syslog_t;
+
+static log_syslog_t log_syslog = {.in_use = false, .opened = false, .ident = NULL};
+
+
+/**
+ * @brief Recompute the most verbose level of the sinks, and the level print calls are checked against.
+ *        'log_sinks.lock' must be held for writing.
+ *
+ */
+static void update_max_level()
+{
+    LOG_MSG_CATEGORY max_level = LOG_MSG_NONE;
+
+    for (int i = 0; i < LOG_MAX_SINKS; ++i)
+    {
+        if (log_sinks.sinks[i].used && log_sinks.sinks[i].level > max_level)
+            max_level = log_sinks.sinks[i].level;
+    }
+
+    __atomic_store_n(&log_sinks.max_level, max_level, __ATOMIC_RELAXED);
+    log_internal_update_level();
+}
+
+/**
+ * @brief Whether a sink configuration is valid
+ *
+ * @param config
+ * @return true
+ * @return false
+ */
+static bool valid_config(const log_sink_config_t* config)
+{
+    return config && config->level >= LOG_MSG_NONE && config->level <= LOG_MSG_DBG &&
+           config->format >= LOG_SINK_FORMAT_FULL && config->format <= LOG_SINK_FORMAT_MESSAGE;
+}
+
+/**
+ * @brief Get an added sink from its ID. 'log_sinks.lock' must be held.
+ *
+ * @param sink
+ * @return log_sink_t* NULL if there is no such sink
+ */
+static log_sink_t* find_sink(int sink)
+{
+    if (sink <= LOG_SINK_DEFAULT || sink > LOG_MAX_SINKS || !log_sinks.sinks[sink - 1].used)
+        return NULL;
+
+    return &log_sinks.sinks[sink - 1];
+}
+
+/**
+ * @brief Write the pieces of a log message into 'fd' with a single writev() call, finishing partial writes
+ *        piece by piece
+ *
+ * @param fd
+ * @param parts
+ * @param count
+ */
+static void write_parts(int fd, struct iovec* parts, int count)
+{
+    while (count > 0)
+    {
+        ssize_t ret = writev(fd, parts, count);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+
+        while (count > 0 && (size_t)ret >= parts->iov_len)
+        {
+            ret -= (ssize_t)parts->iov_len;
+            parts++;
+            count--;
+        }
+
+        if (count > 0)
+        {
+            parts->iov_base = (char*)parts->iov_base + ret;
+            parts->iov_len -= (size_t)ret;
+        }
+    }
+}
+
+/**
+ * @brief Write operation of the file descriptor sinks
+ *
+ * @param context
+ * @param message
+ */
+static void fd_sink_write(void* context, const log_sink_message_t* message)
+{
+    log_fd_sink_t* sink = context;
+    struct iovec parts[3] = {{.iov_base = (void*)message->color, .iov_len = strlen(message->color)},
+                             {.iov_base = (void*)message->text, .iov_len = message->length},
+                             {.iov_base = (void*)message->color_reset, .iov_len = strlen(message->color_reset)}};
+
+    write_parts(sink->fd, parts, 3);
+}
+
+/**
+ * @brief Close operation of the file descriptor sinks
+ *
+ * @param context
+ */
+static void fd_sink_close(void* context)
+{
+    log_fd_sink_t* sink = context;
+
+    if (sink->owned)
+        close(sink->fd);
+    free(sink);
+}
+
+/**
+ * @brief Write operation of the UDP sinks: one datagram per log message, never blocking
+ *
+ * @param context
+ * @param message
+ */
+static void udp_sink_write(void* context, const log_sink_message_t* message)
+{
+    log_fd_sink_t* sink = context;
+    struct iovec parts[3] = {{.iov_base = (void*)message->color, .iov_len = strlen(message->color)},
+                             {.iov_base = (void*)message->text, .iov_len = message->length},
+                             {.iov_base = (void*)message->color_reset, .iov_len = strlen(message->color_reset)}};
+    struct msghdr datagram = {.msg_iov = parts, .msg_iovlen = 3};
+
+    // a full socket buffer just loses this log message
+    sendmsg(sink->fd, &datagram, MSG_DONTWAIT | MSG_NOSIGNAL);
+}
+
+/**
+ * @brief Connect to syslog with the ident of the sink, unless already done. The lock of the sink must be held
+ *
+ * @param syslog_sink
+ */
+static void open_syslog(log_syslog_t* syslog_sink)
+{
+    if (syslog_sink->opened)
+        return;
+
+    openlog(syslog_sink->ident, LOG_PID | LOG_NDELAY, LOG_USER);
+    syslog_sink->opened = true;
+}
+
+/**
+ * @brief Write operation of the syslog sinks
+ *
+ * @param context
+ * @param message
+ */
+static void syslog_sink_write(void* context, const log_sink_message_t* message)
+{
+    log_syslog_t* syslog_sink = context;
+    int priority;
+    size_t length = message->length;
+
+    open_syslog(syslog_sink);
+
+    switch(message->category)
+    {
+        case LOG_MSG_CRIT:
+            priority = SYSLOG_PRIORITY_CRIT;
+        break;
+
+        case LOG_MSG_ERR:
+            priority = SYSLOG_PRIORITY_ERR;
+        break;
+
+        case LOG_MSG_WARN:
+            priority = SYSLOG_PRIORITY_WARNING;
+        break;
+
+        case LOG_MSG_INFO:
+            priority = SYSLOG_PRIORITY_INFO;
+        break;
+
+        case LOG_MSG_DBG:
+        default:
+            priority = SYSLOG_PRIORITY_DEBUG;
+        break;
+    }
+
+    // syslog ends every message itself
+    if (length > 0 && message->text[length - 1] == '\n')
+        length--;
+
+    syslog(priority, "%.*s", (int)length, message->text);
+}
+
+/**
+ * @brief Close operation of the syslog sinks
+ *
+ * @param context
+ */
+static void syslog_sink_close(void* context)
+{
+    log_syslog_t* syslog_sink = context;
+
+    // never close a connection opened by the application itself
+    if (syslog_sink->opened)
+        closelog();
+    syslog_sink->opened = false;
+    __atomic_store_n(&syslog_sink->in_use, false, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Add a sink writing into 'fd', closing it along with the sink if 'owned'. On failure, an owned 'fd' is closed.
+ *
+ * @param fd
+ * @param owned
+ * @param ops
+ * @param config
+ * @return int ID of the sink, -1 on failure
+ */
+static int add_fd_sink(int fd, bool owned, const log_sink_ops_t* ops, const log_sink_config_t* config)
+{
+    log_fd_sink_t* sink = malloc(sizeof(log_fd_sink_t));
+    int id;
+
+    if (!sink)
+    {
+        if (owned)
+            close(fd);
+        return -1;
+    }
+
+    sink->fd = fd;
+    sink->owned = owned;
+
+    id = log_add_sink(ops, sink, config);
+    if (id < 0)
+        fd_sink_close(sink);
+
+    return id;
+}
+
+
+LOG_MSG_CATEGORY log_internal_sinks_level()
+{
+    return __atomic_load_n(&log_sinks.max_level, __ATOMIC_RELAXED);
+}
+
+bool log_internal_sinks_accept(LOG_MSG_CATEGORY category)
+{
+    return (int)category <= (int)__atomic_load_n(&log_sinks.max_level, __ATOMIC_RELAXED);
+}
+
+void log_internal_sinks_write(LOG_MSG_CATEGORY category, const char* line, size_t length, size_t message_offset, bool plain)
+{
+    // no sink, or none that verbose: no lock at all
+    if (!log_internal_sinks_accept(category))
+        return;
+
+    pthread_rwlock_rdlock(&log_sinks.lock);
+    for (int i = 0; i < LOG_MAX_SINKS; ++i)
+    {
+        log_sink_t* sink = &log_sinks.sinks[i];
+        log_sink_message_t message = {.category = category, .text = line, .length = length};
+        uint64_t start;
+
+        if (!sink->used || (int)category > (int)__atomic_load_n(&sink->level, __ATOMIC_RELAXED))
+            continue;
+
+        if (sink->format == LOG_SINK_FORMAT_MESSAGE && message_offset <= length)
+        {
+            message.text = line + message_offset;
+            message.length = length - message_offset;
+        }
+
+        message.color = sink->colors && !plain ? log_internal_console_color(category) : "";
+        message.color_reset = sink->colors && !plain ? ANSI_COLOR_RESET : "";
+
+        pthread_mutex_lock(&sink->lock);
+        start = log_internal_stats_clock();
+        sink->ops.write(sink->context, &message);
+        log_internal_stats_latency(i + 1, start);
+        pthread_mutex_unlock(&sink->lock);
+    }
+    pthread_rwlock_unlock(&log_sinks.lock);
+}
+
+void log_internal_sinks_flush()
+{
+    pthread_rwlock_rdlock(&log_sinks.lock);
+    for (int i = 0; i < LOG_MAX_SINKS; ++i)
+    {
+        log_sink_t* sink = &log_sinks.sinks[i];
+
+        if (sink->used && sink->ops.flush)
+        {
+            pthread_mutex_lock(&sink->lock);
+            sink->ops.flush(sink->context);
+            pthread_mutex_unlock(&sink->lock);
+        }
+    }
+    pthread_rwlock_unlock(&log_sinks.lock);
+}
+
+void log_internal_sinks_close()
+{
+    for (int i = 1; i <= LOG_MAX_SINKS; ++i)
+        log_remove_sink(i);
+}
+
+
+int log_add_sink(const log_sink_ops_t* ops, void* context, const log_sink_config_t* config)
+{
+    int id = -1;
+
+    if (!ops || !ops->write || !valid_config(config))
+        return -1;
+
+    pthread_rwlock_wrlock(&log_sinks.lock);
+    for (int i = 0; i < LOG_MAX_SINKS; ++i)
+    {
+        log_sink_t* sink = &log_sinks.sinks[i];
+
+        if (sink->used)
+            continue;
+
+        sink->ops = *ops;
+        sink->context = context;
+        sink->level = config->level;
+        sink->colors = config->colors;
+        sink->format = config->format;
+        pthread_mutex_init(&sink->lock, NULL);
+        sink->used = true;
+
+        update_max_level();
+        id = i + 1;
+        break;
+    }
+    pthread_rwlock_unlock(&log_sinks.lock);
+
+    return id;
+}
+
+int log_add_fd_sink(int fd, const log_sink_config_t* config)
+{
+    static const log_sink_ops_t ops = {.write = fd_sink_write, .flush = NULL, .close = fd_sink_close};
+
+    if (fd < 0)
+        return -1;
+
+    return add_fd_sink(fd, false, &ops, config);
+}
+
+int log_add_file_sink(const char* filepath, size_t filepath_size, const log_sink_config_t* config)
+{
+    static const log_sink_ops_t ops = {.write = fd_sink_write, .flush = NULL, .close = fd_sink_close};
+    char file_name[LOG4EMBEDDED_MAX_PATH_SIZE];
+    int fd;
+
+    if (!filepath || filepath_size == 0 || filepath_size > LOG4EMBEDDED_MAX_PATH_SIZE)
+        return -1;
+
+    snprintf(file_name, filepath_size, "%s", filepath);
+
+    fd = open(file_name, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return -1;
+
+    return add_fd_sink(fd, true, &ops, config);
+}
+
+int log_add_syslog_sink(const char* ident, const log_sink_config_t* config)
+{
+    static const log_sink_ops_t ops = {.write = syslog_sink_write, .flush = NULL, .close = syslog_sink_close};
+    bool in_use = false;
+    log_sink_t* sink;
+    int id;
+
+    // nothing process-wide is touched before the sink is known to be added
+    if (!valid_config(config) ||
+        !__atomic_compare_exchange_n(&log_syslog.in_use, &in_use, true, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        return -1;
+
+    log_syslog.ident = ident;
+    log_syslog.opened = false;
+    if ((id = log_add_sink(&ops, &log_syslog, config)) < 0)
+    {
+        __atomic_store_n(&log_syslog.in_use, false, __ATOMIC_RELEASE);
+        return -1;
+    }
+
+    // connect right away, as LOG_NDELAY means, unless a log message got there first
+    pthread_rwlock_rdlock(&log_sinks.lock);
+    if ((sink = find_sink(id)) && sink->context == &log_syslog)
+    {
+        pthread_mutex_lock(&sink->lock);
+        open_syslog(&log_syslog);
+        pthread_mutex_unlock(&sink->lock);
+    }
+    pthread_rwlock_unlock(&log_sinks.lock);
+
+    return id;
+}
+
+int log_add_udp_sink(const char* host, unsigned short port, const log_sink_config_t* config)
+{
+    static const log_sink_ops_t ops = {.write = udp_sink_write, .flush = NULL, .close = fd_sink_close};
+    struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_DGRAM};
+    struct addrinfo* addresses;
+    char service[8];
+    int fd = -1;
+
+    if (!host)
+        return -1;
+
+    snprintf(service, sizeof(service), "%u", port);
+    if (getaddrinfo(host, service, &hints, &addresses) != 0)
+        return -1;
+
+    // the first address a socket can be connected to
+    for (struct addrinfo* address = addresses; address && fd < 0; address = address->ai_next)
+    {
+        fd = socket(address->ai_family, address->ai_socktype | SOCK_CLOEXEC, address->ai_protocol);
+        if (fd >= 0 && connect(fd, address->ai_addr, address->ai_addrlen) != 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(addresses);
+
+    if (fd < 0)
+        return -1;
+
+    return add_fd_sink(fd, true, &ops, config);
+}
+
+int log_set_sink_level(int sink, LOG_MSG_CATEGORY log_level)
+{
+    log_sink_t* found;
+
+    if (log_level < LOG_MSG_NONE || log_level > LOG_MSG_DBG)
+        return -1;
+
+    if (sink == LOG_SINK_DEFAULT)
+    {
+        log_set_level(log_level);
+        return 0;
+    }
+
+    pthread_rwlock_wrlock(&log_sinks.lock);
+    found = find_sink(sink);
+    if (found)
+    {
+        __atomic_store_n(&found->level, log_level, __ATOMIC_RELAXED);
+        update_max_level();
+    }
+    pthread_rwlock_unlock(&log_sinks.lock);
+
+    return found ? 0 : -1;
+}
+
+int log_remove_sink(int sink)
+{
+    log_sink_t* found;
+    log_sink_ops_t ops;
+    void* context = NULL;
+
+    // taking the lock for writing waits for the print calls still using the sink
+    pthread_rwlock_wrlock(&log_sinks.lock);
+    found = find_sink(sink);
+    if (found)
+    {
+        ops = found->ops;
+        context = found->context;
+        found->used = false;
+        pthread_mutex_destroy(&found->lock);
+        update_max_level();
+    }
+    pthread_rwlock_unlock(&log_sinks.lock);
+
+    if (!found)
+        return -1;
+
+    if (ops.flush)
+        ops.flush(context);
+    if (ops.close)
+        ops.close(context);
+    return 0;
+}
@@ -0,0 +1,220 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "log4embedded.h"
+#include "log4embedded_internal.h"
+
+// Define the cache line size, so that threads counting into different stripes do not share cache lines
+#define CACHE_LINE_SIZE     64
+
+// Define the number of stripes of counters. Threads are spread over them, so they seldom count into the same one
+#define STATS_STRIPES       16
+
+// counters of a group of threads
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) uint64_t messages[LOG_MSG_DBG + 1];
+    uint64_t counters[LOG_STAT_COUNT];
+} log_stats_stripe_t;
+
+// attributes of the statistics of the logging pipeline
+typedef struct {
+    log_stats_stripe_t stripes[STATS_STRIPES];
+    unsigned int next_stripe;                   // stripe of the next thread counting for the first time
+
+    bool timing;                                // whether writes are timed into the latency histograms
+    uint64_t report_interval_ns;                // how often the statistics are printed, 0 if never
+    uint64_t next_report_ns;
+
+    // updated while the lock of each sink is held, so they are not contended
+    _Alignas(CACHE_LINE_SIZE) uint64_t write_latency[LOG_MAX_SINKS + 1][LOG_STATS_LATENCY_BUCKETS];
+    size_t queue_high_water;
+} log_stats_state_t;
+
+static log_stats_state_t log_stats = {.next_stripe = 0,
+                                      .timing = false,
+                                      .report_interval_ns = 0,
+                                      .next_report_ns = 0,
+                                      .queue_high_water = 0};
+
+// stripe of the calling thread, chosen on its first count
+static __thread log_stats_stripe_t* thread_stripe = NULL;
+
+
+/**
+ * @brief Stripe of counters of the calling thread
+ *
+ * @return log_stats_stripe_t*
+ */
+static log_stats_stripe_t* get_stripe()
+{
+    if (__builtin_expect(!thread_stripe, 0))
+        thread_stripe = &log_stats.stripes[__atomic_fetch_add(&log_stats.next_stripe, 1, __ATOMIC_RELAXED) % STATS_STRIPES];
+
+    return thread_stripe;
+}
+
+/**
+ * @brief Monotonic time, from the coarse clock where available, for the periodic report
+ *
+ * @return uint64_t nanoseconds
+ */
+static uint64_t coarse_now_ns()
+{
+    struct timespec now;
+
+#ifdef CLOCK_MONOTONIC_COARSE
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &now);
+#endif
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * @brief Print the statistics as a single log message
+ *
+ */
+static void report_stats()
+{
+    log_stats_t stats;
+
+    log_get_stats(&stats);
+    log_internal_print(LOG_MSG_INFO, log_get_level(), NULL,
+                       "Stats: %llu crit, %llu err, %llu warn, %llu info, %llu debug; %llu filtered, %llu rate limited, "
+                       "%llu duplicates, %llu dropped; %llu bytes, %llu flushes, queue high water %zu\n",
+                       (unsigned long long)stats.messages[LOG_MSG_CRIT], (unsigned long long)stats.messages[LOG_MSG_ERR],
+                       (unsigned long long)stats.messages[LOG_MSG_WARN], (unsigned long long)stats.messages[LOG_MSG_INFO],
+                       (unsigned long long)stats.messages[LOG_MSG_DBG], (unsigned long long)stats.filtered,
+                       (unsigned long long)stats.rate_limited, (unsigned long long)stats.duplicates,
+                       (unsigned long long)stats.dropped, (unsigned long long)stats.bytes_written,
+                       (unsigned long long)stats.flushes, stats.queue_high_water);
+}
+
+
+void log_internal_stats_add(LOG_STAT_COUNTER counter, uint64_t value)
+{
+    __atomic_add_fetch(&get_stripe()->counters[counter], value, __ATOMIC_RELAXED);
+}
+
+void log_internal_stats_message(LOG_MSG_CATEGORY category)
+{
+    uint64_t interval = __atomic_load_n(&log_stats.report_interval_ns, __ATOMIC_RELAXED);
+
+    __atomic_add_fetch(&get_stripe()->messages[category], 1, __ATOMIC_RELAXED);
+
+    // the print call which finds the report due, and wins the CAS, prints it. Its own log message does not report again
+    if (interval > 0)
+    {
+        uint64_t now = coarse_now_ns();
+        uint64_t next = __atomic_load_n(&log_stats.next_report_ns, __ATOMIC_RELAXED);
+
+        if (now >= next &&
+            __atomic_compare_exchange_n(&log_stats.next_report_ns, &next, now + interval, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            report_stats();
+    }
+}
+
+void log_internal_stats_queue_depth(size_t depth)
+{
+    size_t high_water = __atomic_load_n(&log_stats.queue_high_water, __ATOMIC_RELAXED);
+
+    while (depth > high_water &&
+           !__atomic_compare_exchange_n(&log_stats.queue_high_water, &high_water, depth, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+uint64_t log_internal_stats_clock()
+{
+    struct timespec now;
+
+    if (!__atomic_load_n(&log_stats.timing, __ATOMIC_RELAXED))
+        return 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+void log_internal_stats_latency(int sink, uint64_t start_ns)
+{
+    uint64_t end_ns;
+    uint64_t elapsed_us;
+    size_t bucket = 0;
+
+    // timing may have been disabled meanwhile
+    if (start_ns == 0 || sink < LOG_SINK_DEFAULT || sink > LOG_MAX_SINKS || (end_ns = log_internal_stats_clock()) < start_ns)
+        return;
+
+    elapsed_us = (end_ns - start_ns) / 1000;
+    while (bucket < LOG_STATS_LATENCY_BUCKETS - 1 && elapsed_us >= (1ULL << bucket))
+        bucket++;
+
+    __atomic_add_fetch(&log_stats.write_latency[sink][bucket], 1, __ATOMIC_RELAXED);
+}
+
+
+int log_get_stats(log_stats_t* stats)
+{
+    if (!stats)
+        return -1;
+
+    memset(stats, 0, sizeof(log_stats_t));
+
+    for (size_t i = 0; i < STATS_STRIPES; ++i)
+    {
+        const log_stats_stripe_t* stripe = &log_stats.stripes[i];
+
+        for (int category = LOG_MSG_CRIT; category <= LOG_MSG_DBG; ++category)
+            stats->messages[category] += __atomic_load_n(&stripe->messages[category], __ATOMIC_RELAXED);
+
+        stats->filtered += __atomic_load_n(&stripe->counters[LOG_STAT_FILTERED], __ATOMIC_RELAXED);
+        stats->rate_limited += __atomic_load_n(&stripe->counters[LOG_STAT_RATE_LIMITED], __ATOMIC_RELAXED);
+        stats->duplicates += __atomic_load_n(&stripe->counters[LOG_STAT_DUPLICATES], __ATOMIC_RELAXED);
+        stats->dropped += __atomic_load_n(&stripe->counters[LOG_STAT_DROPPED], __ATOMIC_RELAXED);
+        stats->bytes_written += __atomic_load_n(&stripe->counters[LOG_STAT_BYTES], __ATOMIC_RELAXED);
+        stats->flushes += __atomic_load_n(&stripe->counters[LOG_STAT_FLUSHES], __ATOMIC_RELAXED);
+    }
+
+    stats->queue_high_water = __atomic_load_n(&log_stats.queue_high_water, __ATOMIC_RELAXED);
+
+    for (int sink = LOG_SINK_DEFAULT; sink <= LOG_MAX_SINKS; ++sink)
+        for (size_t bucket = 0; bucket < LOG_STATS_LATENCY_BUCKETS; ++bucket)
+            stats->write_latency[sink][bucket] = __atomic_load_n(&log_stats.write_latency[sink][bucket], __ATOMIC_RELAXED);
+
+    return 0;
+}
+
+void log_reset_stats()
+{
+    for (size_t i = 0; i < STATS_STRIPES; ++i)
+    {
+        log_stats_stripe_t* stripe = &log_stats.stripes[i];
+
+        for (int category = LOG_MSG_NONE; category <= LOG_MSG_DBG; ++category)
+            __atomic_store_n(&stripe->messages[category], 0, __ATOMIC_RELAXED);
+        for (int counter = 0; counter < LOG_STAT_COUNT; ++counter)
+            __atomic_store_n(&stripe->counters[counter], 0, __ATOMIC_RELAXED);
+    }
+
+    __atomic_store_n(&log_stats.queue_high_water, 0, __ATOMIC_RELAXED);
+
+    for (int sink = LOG_SINK_DEFAULT; sink <= LOG_MAX_SINKS; ++sink)
+        for (size_t bucket = 0; bucket < LOG_STATS_LATENCY_BUCKETS; ++bucket)
+            __atomic_store_n(&log_stats.write_latency[sink][bucket], 0, __ATOMIC_RELAXED);
+}
+
+void log_enable_stats(unsigned int report_interval_ms)
+{
+    uint64_t interval = (uint64_t)report_interval_ms * 1000000ULL;
+
+    __atomic_store_n(&log_stats.next_report_ns, coarse_now_ns() + interval, __ATOMIC_RELAXED);
+    __atomic_store_n(&log_stats.report_interval_ns, interval, __ATOMIC_RELAXED);
+    __atomic_store_n(&log_stats.timing, true, __ATOMIC_RELAXED);
+}
+
+void log_disable_stats()
+{
+    __atomic_store_n(&log_stats.timing, false, __ATOMIC_RELAXED);
+    __atomic_store_n(&log_stats.report_interval_ns, 0, __ATOMIC_RELAXED);
+}
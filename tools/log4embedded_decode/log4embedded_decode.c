@@ -0,0 +1,314 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "log4embedded.h"
+#include "log4embedded_internal.h"
+
+/*  log4embedded-decode: turn binary log files, written after calling "log_set_binary_file", back into the text log messages
+    log4embedded prints: "[label] [date] message".
+
+    Usage: log4embedded-decode [-u] [-p sec|msec|usec] <binary log file>...
+        -u  print dates as UTC, rather than local time
+        -p  fraction of a second printed after the time (none by default)
+
+    Log messages are printed to the stdout. It returns a non-zero value if any file cannot be read, or is corrupt.
+*/
+
+// Define the labels of the log messages, as printed by log4embedded
+#define CRIT_ABBREV     "[Crit]"
+#define ERR_ABBREV      "[Err]"
+#define WARN_ABBREV     "[Warn]"
+#define INFO_ABBREV     "[Info]"
+#define DBG_ABBREV      "[Debug]"
+
+// Define the maximum size of a rendered log message
+#define MAX_MESSAGE_SIZE    (64 * 1024)
+
+// format strings of the file being decoded, by ID
+typedef struct {
+    char** strings;
+    size_t size;
+} log_formats_t;
+
+static bool utc_dates = false;
+static LOG_TIMESTAMP_PRECISION precision = LOG_TIMESTAMP_SEC;
+
+
+/**
+ * @brief Read a whole file into memory
+ *
+ * @param file_name
+ * @param size
+ * @return uint8_t* the file content, to be freed by the caller, or NULL on failure
+ */
+static uint8_t* read_file(const char* file_name, size_t* size)
+{
+    FILE* file = fopen(file_name, "rb");
+    uint8_t* data = NULL;
+    size_t capacity = 0;
+
+    *size = 0;
+    if (!file)
+        return NULL;
+
+    for (;;)
+    {
+        if (*size == capacity)
+        {
+            uint8_t* bigger = realloc(data, capacity ? capacity * 2 : 64 * 1024);
+            if (!bigger)
+            {
+                free(data);
+                fclose(file);
+                return NULL;
+            }
+            data = bigger;
+            capacity = capacity ? capacity * 2 : 64 * 1024;
+        }
+
+        size_t len = fread(data + *size, 1, capacity - *size, file);
+        if (len == 0)
+            break;
+        *size += len;
+    }
+
+    fclose(file);
+    return data;
+}
+
+/**
+ * @brief Forget every format string, as a new file header starts a new table
+ *
+ * @param formats
+ */
+static void clear_formats(log_formats_t* formats)
+{
+    for (size_t i = 0; i < formats->size; ++i)
+    {
+        free(formats->strings[i]);
+        formats->strings[i] = NULL;
+    }
+}
+
+/**
+ * @brief Store format string number 'id'
+ *
+ * @return true on success
+ */
+static bool set_format(log_formats_t* formats, uint64_t id, const uint8_t* fmt, size_t fmt_len)
+{
+    if (id >= formats->size)
+    {
+        size_t new_size = formats->size ? formats->size : 64;
+        while (new_size <= id)
+            new_size *= 2;
+
+        char** bigger = realloc(formats->strings, new_size * sizeof(char*));
+        if (!bigger)
+            return false;
+        memset(bigger + formats->size, 0, (new_size - formats->size) * sizeof(char*));
+        formats->strings = bigger;
+        formats->size = new_size;
+    }
+
+    free(formats->strings[id]);
+    formats->strings[id] = malloc(fmt_len + 1);
+    if (!formats->strings[id])
+        return false;
+    memcpy(formats->strings[id], fmt, fmt_len);
+    formats->strings[id][fmt_len] = '\0';
+    return true;
+}
+
+/**
+ * @brief Print the label and date of a log message, the same way log4embedded does with no colors
+ *
+ * @param category
+ * @param timestamp
+ */
+static void print_header(LOG_MSG_CATEGORY category, const struct timespec* timestamp)
+{
+    const char* label;
+    char date[64];
+    struct tm tm_info;
+
+    switch(category)
+    {
+        case LOG_MSG_CRIT:  label = CRIT_ABBREV;    break;
+        case LOG_MSG_ERR:   label = ERR_ABBREV;     break;
+        case LOG_MSG_WARN:  label = WARN_ABBREV;    break;
+        case LOG_MSG_INFO:  label = INFO_ABBREV;    break;
+        default:            label = DBG_ABBREV;     break;
+    }
+
+    if (utc_dates)
+        gmtime_r(&timestamp->tv_sec, &tm_info);
+    else
+        localtime_r(&timestamp->tv_sec, &tm_info);
+
+    size_t len = strftime(date, sizeof(date), "%Y/%m/%d - %H:%M:%S", &tm_info);
+    if (precision == LOG_TIMESTAMP_MSEC)
+        snprintf(date + len, sizeof(date) - len, ".%03ld", timestamp->tv_nsec / 1000000L);
+    else if (precision == LOG_TIMESTAMP_USEC)
+        snprintf(date + len, sizeof(date) - len, ".%06ld", timestamp->tv_nsec / 1000L);
+
+    printf("%s [%s] ", label, date);
+}
+
+/**
+ * @brief Decode a whole binary log file to the stdout
+ *
+ * @param file_name
+ * @return int 0 on success, -1 if the file cannot be read or is corrupt
+ */
+static int decode_file(const char* file_name)
+{
+    const size_t magic_len = sizeof(LOG4EMBEDDED_BINARY_MAGIC) - 1;
+    log_formats_t formats = {.strings = NULL, .size = 0};
+    struct timespec timestamp = {0, 0};
+    bool header_found = false;
+    size_t size;
+    size_t pos = 0;
+    int ret = 0;
+    uint8_t* data = read_file(file_name, &size);
+    uint8_t* args = malloc(3 * size + 16);
+    char* message = malloc(MAX_MESSAGE_SIZE);
+
+    if (!data || !args || !message)
+    {
+        fprintf(stderr, "%s: cannot be read\n", file_name);
+        free(data);
+        free(args);
+        free(message);
+        return -1;
+    }
+
+    while (pos < size)
+    {
+        size_t record_start = pos;
+        uint64_t id, len;
+        bool ok = true;
+
+        // file header: binary log files may be concatenated, or appended to
+        if (size - pos >= magic_len && memcmp(data + pos, LOG4EMBEDDED_BINARY_MAGIC, magic_len) == 0)
+        {
+            uint64_t seconds, microseconds;
+            pos += magic_len;
+            ok = pos < size && data[pos++] == LOG4EMBEDDED_BINARY_VERSION &&
+                 log_internal_get_varint(data, size, &pos, &seconds) &&
+                 log_internal_get_varint(data, size, &pos, &microseconds);
+            if (ok)
+            {
+                clear_formats(&formats);
+                timestamp.tv_sec = (time_t)seconds;
+                timestamp.tv_nsec = (long)(microseconds * 1000);
+                header_found = true;
+            }
+        }
+        else if (!header_found)
+            ok = false;
+        else if (data[pos] == LOG4EMBEDDED_BINARY_FORMAT)
+        {
+            pos++;
+            ok = log_internal_get_varint(data, size, &pos, &id) && log_internal_get_varint(data, size, &pos, &len) &&
+                 len <= size - pos && set_format(&formats, id, data + pos, (size_t)len);
+            pos += ok ? (size_t)len : 0;
+        }
+        else if (data[pos] >= LOG_MSG_CRIT && data[pos] <= LOG_MSG_DBG)
+        {
+            LOG_MSG_CATEGORY category = (LOG_MSG_CATEGORY)data[pos++];
+            uint64_t zigzag_delta;
+
+            ok = log_internal_get_varint(data, size, &pos, &zigzag_delta) && log_internal_get_varint(data, size, &pos, &id) &&
+                 log_internal_get_varint(data, size, &pos, &len) && len <= size - pos && 
+                 id < formats.size && formats.strings[id];
+            if (ok)
+            {
+                int64_t delta_us = (int64_t)(zigzag_delta >> 1) ^ -(int64_t)(zigzag_delta & 1);
+                int64_t nanoseconds = timestamp.tv_nsec + (delta_us % 1000000) * 1000;
+
+                timestamp.tv_sec += delta_us / 1000000 + (nanoseconds >= 1000000000 ? 1 : nanoseconds < 0 ? -1 : 0);
+                timestamp.tv_nsec = (long)(nanoseconds >= 1000000000 ? nanoseconds - 1000000000 :
+                                           nanoseconds < 0 ? nanoseconds + 1000000000 : nanoseconds);
+
+                size_t args_size = log_internal_unpack_args(args, 3 * size + 16, data + pos, (size_t)len);
+                ok = len == 0 || args_size > 0;
+                if (ok)
+                {
+                    log_internal_render_args(message, MAX_MESSAGE_SIZE, formats.strings[id], args, args_size);
+                    print_header(category, &timestamp);
+                    fputs(message, stdout);
+                }
+                pos += (size_t)len;
+            }
+        }
+        else
+            ok = false;
+
+        if (!ok)
+        {
+            // a process killed while writing leaves a partial record at the end: nothing else to do
+            fprintf(stderr, "%s: corrupt or truncated record at offset %zu\n", file_name, record_start);
+            ret = -1;
+            break;
+        }
+    }
+
+    clear_formats(&formats);
+    free(formats.strings);
+    free(data);
+    free(args);
+    free(message);
+    return ret;
+}
+
+int main(int argc, char** argv) {
+
+    int opt;
+    int ret = 0;
+
+    while ((opt = getopt(argc, argv, "up:")) != -1)
+    {
+        switch(opt)
+        {
+            case 'u':
+                utc_dates = true;
+            break;
+
+            case 'p':
+                if (strcmp(optarg, "sec") == 0)
+                    precision = LOG_TIMESTAMP_SEC;
+                else if (strcmp(optarg, "msec") == 0)
+                    precision = LOG_TIMESTAMP_MSEC;
+                else if (strcmp(optarg, "usec") == 0)
+                    precision = LOG_TIMESTAMP_USEC;
+                else
+                {
+                    fprintf(stderr, "Unknown precision: %s\n", optarg);
+                    return 2;
+                }
+            break;
+
+            default:
+                fprintf(stderr, "Usage: %s [-u] [-p sec|msec|usec] <binary log file>...\n", argv[0]);
+                return 2;
+        }
+    }
+
+    if (optind >= argc)
+    {
+        fprintf(stderr, "Usage: %s [-u] [-p sec|msec|usec] <binary log file>...\n", argv[0]);
+        return 2;
+    }
+
+    for (int i = optind; i < argc; ++i)
+        if (decode_file(argv[i]) != 0)
+            ret = 1;
+
+    return ret;
+}